@@ -0,0 +1,64 @@
+#ifndef AABB_TREE_H
+#define AABB_TREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AABB_TREE_NULL 0           // No node; node 0 is never handed out
+#define AABB_TREE_DEFAULT_MARGIN 0.5f   // Leaf fattening, in world units
+#define AABB_TREE_STACK_SIZE 128   // Query depth limit (balanced trees stay far below)
+
+typedef struct {
+  float min_x;
+  float min_y;
+  float max_x;
+  float max_y;
+} Aabb;
+
+typedef struct {
+  Aabb box;        // Fattened by the tree margin for leaves
+  uint32_t parent; // Next free node while on the free list
+  uint32_t left;   // AABB_TREE_NULL for leaves
+  uint32_t right;
+  int32_t height;  // 0 for leaves, -1 for free nodes
+  uint32_t user;   // Leaf payload
+} AabbTreeNode;
+
+// Dynamic AABB tree - supports ZII (a zeroed tree is empty, margin 0)
+// Leaves hold fattened boxes, so a body can move by up to the margin without
+// touching the tree; moving further reinserts its leaf. Inserts and removals
+// refit the boxes on the way back to the root and rotate unbalanced nodes, so
+// the height stays logarithmic. No world bounds: boxes may be anywhere.
+typedef struct {
+  AabbTreeNode *nodes;
+  uint32_t capacity;
+  uint32_t root;
+  uint32_t free_list;
+  uint32_t leaf_count;
+  float margin; // Added on every side of a leaf's box
+} AabbTree;
+
+void aabb_tree_init(AabbTree *tree, float margin);
+void aabb_tree_cleanup(AabbTree *tree);
+
+// Returns the leaf's proxy, AABB_TREE_NULL if the node pool can't grow
+uint32_t aabb_tree_insert(AabbTree *tree, Aabb box, uint32_t user);
+void aabb_tree_remove(AabbTree *tree, uint32_t proxy);
+// Updates a leaf for its new tight box; returns true if it was reinserted
+// (the box left the fattened one)
+bool aabb_tree_move(AabbTree *tree, uint32_t proxy, Aabb box);
+bool aabb_tree_is_leaf(const AabbTree *tree, uint32_t proxy);
+
+// User values of leaves whose fattened box overlaps box; returns the total
+// match count, writing at most max_users. Reentrant.
+size_t aabb_tree_query(const AabbTree *tree, Aabb box, uint32_t *out_users,
+                       size_t max_users);
+int aabb_tree_height(const AabbTree *tree);
+
+static inline bool aabb_overlaps(Aabb a, Aabb b) {
+  return a.min_x <= b.max_x && b.min_x <= a.max_x && a.min_y <= b.max_y &&
+         b.min_y <= a.max_y;
+}
+
+#endif
@@ -5,43 +5,194 @@
 #include <stddef.h>
 #include <stdint.h>
 #include "memory.h"
+#include "thread_pool.h"
 
-#define MAX_ENTITIES 8192  // Supports 5000+ active entities for scaling test
 #define MAX_COMPONENTS 32
 #define MAX_SYSTEMS 32
 
+// Entity and component storage grow at runtime in fixed-size chunks/pages that
+// are never moved, so pointers into them stay valid as the ECS grows
+#define ECS_DEFAULT_ENTITY_CAPACITY 8192 // Initial reservation used by ecs_init
+#define ECS_ENTITY_CHUNK_SIZE 1024       // EntityInfo slots per chunk
+#define ECS_COMPONENT_PAGE_SIZE 256      // Components per dense data page
+#define ECS_SPARSE_PAGE_SIZE 4096        // Entity slots per sparse index page
+
+#define ECS_MAX_QUERIES 64 // Cached queries, one per distinct component mask
+#define ECS_MAX_GROUPS 8   // Owning groups; each component joins at most one
+
 typedef uint32_t Entity;
 typedef uint32_t ComponentType;
 typedef uint64_t ComponentMask;
 
+// Entity handles: slot index in the low bits, generation in the high bits
+// Destroying an entity bumps its slot's generation, so stale handles fail
+// ecs_entity_active() even after the slot is recycled. Handle 0 is null.
+#define ECS_ENTITY_INDEX_BITS 20
+#define ECS_ENTITY_INDEX_MASK ((1u << ECS_ENTITY_INDEX_BITS) - 1)
+#define ECS_ENTITY_GENERATION_MASK ((1u << (32 - ECS_ENTITY_INDEX_BITS)) - 1)
+#define MAX_ENTITIES (1u << ECS_ENTITY_INDEX_BITS) // Hard limit (~1M slots)
+
+// Live entities never reach the top generation: it marks handles returned by
+// ecs_defer_create_entity(), whose index is a per-thread creation ordinal
+#define ECS_ENTITY_DEFERRED_GENERATION ECS_ENTITY_GENERATION_MASK
+
+static inline uint32_t ecs_entity_index(Entity entity) {
+  return entity & ECS_ENTITY_INDEX_MASK;
+}
+static inline uint32_t ecs_entity_generation(Entity entity) {
+  return entity >> ECS_ENTITY_INDEX_BITS;
+}
+static inline Entity ecs_entity_make(uint32_t index, uint32_t generation) {
+  return (generation << ECS_ENTITY_INDEX_BITS) |
+         (index & ECS_ENTITY_INDEX_MASK);
+}
+
+static inline bool ecs_entity_deferred(Entity entity) {
+  return ecs_entity_generation(entity) == ECS_ENTITY_DEFERRED_GENERATION;
+}
+
 typedef struct {
   ComponentMask mask;
   bool active;
+  uint32_t generation;    // Matches the high bits of the live handle
+  uint32_t next_free;     // Next slot in the free list while destroyed
+  uint32_t archetype;     // Index of the archetype holding this entity
+  uint32_t archetype_row; // Position within that archetype's entity list
 } EntityInfo;
 
+// Archetype: every entity whose component mask is exactly `mask`
+// Component data stays in the sparse sets; archetypes only track membership so
+// queries can skip non-matching entities wholesale. Edges cache the archetype
+// reached by adding/removing one component (index + 1, 0 = not yet known).
 typedef struct {
-  void *data;
-  size_t component_size;
+  ComponentMask mask;
+  Entity *entities;
   size_t count;
   size_t capacity;
+  uint32_t add_edges[MAX_COMPONENTS];
+  uint32_t remove_edges[MAX_COMPONENTS];
+} Archetype;
+
+// Cached query: archetypes whose mask contains all required components
+// Kept up to date by the ECS as new archetypes appear.
+typedef struct {
+  ComponentMask mask;
+  uint32_t *archetypes;
+  size_t archetype_count;
+  size_t archetype_capacity;
+} EcsQuery;
+
+// Owning group: every entity that has all `owned` components is packed into
+// dense slots [0, count) of each owned array, in the same order, so index i
+// names the same entity in all of them. Membership updates on add/remove swap
+// component data, so an add or remove of an owned type may move the owned
+// components of one other entity as well.
+typedef struct {
+  ComponentMask owned;
+  size_t count;
+  uint32_t version; // Bumped on every enter and leave (slots may have moved)
+} EcsGroup;
+
+// Change detection stamps, kept per dense slot next to the component data
+// Ticks come from ECS.change_tick, which ecs_update_systems() advances after
+// every batch of systems (uint32_t: years at any realistic batch rate). Each
+// page also keeps one stamp at least as late as any of its slots' `changed`,
+// so a pass looking for changes can skip untouched pages.
+typedef struct {
+  uint32_t added;   // Tick the component was added
+  uint32_t changed; // Tick of the last mutable access (or the add)
+} EcsComponentTicks;
+
+// Packed component storage - supports ZII
+// dense[i] owns the component stored at dense index i, and the paged sparse
+// index maps an entity's slot index to its dense index + 1 (0 = none).
+// Removal swaps the last component into the hole, so the first `count` slots
+// are always live and can be iterated without gaps.
+typedef struct {
+  void **pages;             // ECS_COMPONENT_PAGE_SIZE components, ticks, page stamp
+  Entity *dense;            // Entity owning each dense slot
+  uint32_t **sparse;        // Sparse index pages, allocated on first use
+  size_t sparse_page_count; // Length of the sparse page table
+  size_t component_size;
+  size_t count;    // Live components (packed at the front)
+  size_t capacity; // Slots backed by allocated pages
 } ComponentArray;
 
+typedef enum {
+  ECS_COMMAND_CREATE,
+  ECS_COMMAND_DESTROY,
+  ECS_COMMAND_ADD,
+  ECS_COMMAND_REMOVE,
+} EcsCommandType;
+
+typedef struct {
+  EcsCommandType type;
+  Entity entity; // Target, possibly a deferred handle
+  ComponentType component;
+  size_t data_offset; // ADD: staged component value in the buffer's data
+} EcsCommand;
+
+// Structural changes recorded by one thread - supports ZII
+// Commands and staged component values grow by realloc and are kept (with
+// their capacity) until the next flush.
+typedef struct {
+  EcsCommand *commands;
+  size_t count;
+  size_t capacity;
+
+  unsigned char *data; // Staged component values for ADD commands
+  size_t data_size;
+  size_t data_capacity;
+
+  Entity *created; // Deferred ordinal -> real entity, filled during replay
+  size_t created_count;
+  size_t created_capacity;
+} EcsCommandBuffer;
+
+#define ECS_MAX_COMMAND_BUFFERS (THREAD_POOL_MAX_THREADS + 1) // Per worker
+
 typedef void (*SystemFunc)(float delta_time);
 
+// Systems declaring read/write sets may run concurrently with any system they
+// don't conflict with (write vs. read/write overlap). Systems registered
+// without access declarations are exclusive and run alone on the calling
+// thread, which keeps GL and other thread-bound work safe.
 typedef struct {
   SystemFunc update;
   ComponentMask required_components;
+  ComponentMask read_components;
+  ComponentMask write_components;
+  bool exclusive;
   bool active;
 } System;
 
 typedef struct {
-  EntityInfo entities[MAX_ENTITIES];
+  EntityInfo **entity_chunks; // ECS_ENTITY_CHUNK_SIZE slots per chunk
+  size_t entity_chunk_count;
+  size_t entity_chunk_capacity; // Length of the chunk pointer table
   ComponentArray components[MAX_COMPONENTS];
   System systems[MAX_SYSTEMS];
 
-  Entity next_entity_id;
+  Archetype *archetypes; // archetypes[0] is the empty archetype
+  size_t archetype_count;
+  size_t archetype_capacity;
+
+  EcsQuery queries[ECS_MAX_QUERIES];
+  size_t query_count;
+
+  EcsGroup groups[ECS_MAX_GROUPS];
+  size_t group_count;
+
+  uint32_t change_tick; // Stamped into EcsComponentTicks by writes
+
+  Entity next_entity_id; // Next never-used slot index
+  uint32_t free_head;    // Most recently destroyed slot (valid if free_count)
+  size_t free_count;
   size_t component_count;
   size_t system_count;
+
+  ThreadPool *thread_pool; // Optional: NULL runs all systems serially
+  EcsCommandBuffer command_buffers[ECS_MAX_COMMAND_BUFFERS]; // By worker
   
   ArenaPool component_arena_pool;  // Arena pool for component allocations
 } ECS;
@@ -53,19 +204,144 @@ bool ecs_entity_active(ECS *ecs, Entity entity);
 ComponentType ecs_register_component(ECS *ecs, size_t component_size);
 void *ecs_add_component(ECS *ecs, Entity entity, ComponentType type);
 void *ecs_get_component(ECS *ecs, Entity entity, ComponentType type);
+// Same as ecs_get_component, but stamps the component as changed this tick.
+// Change filters only see writes made through this or ecs_mark_changed().
+void *ecs_get_component_mut(ECS *ecs, Entity entity, ComponentType type);
+void ecs_mark_changed(ECS *ecs, Entity entity, ComponentType type);
+uint32_t ecs_change_tick(const ECS *ecs);
+// Manual sync point for loops that don't go through ecs_update_systems()
+void ecs_advance_tick(ECS *ecs);
 void ecs_remove_component(ECS *ecs, Entity entity, ComponentType type);
 bool ecs_has_component(ECS *ecs, Entity entity, ComponentType type);
 
+// Pre-allocate pages for `capacity` components (e.g. before a particle burst)
+bool ecs_reserve_components(ECS *ecs, ComponentType type, size_t capacity);
+
+// Dense access: index must be < ecs_component_count(). Pointers stay valid
+// until a component of the same type is removed (swap-remove may move it), or
+// for group-owned types, until one is added.
+size_t ecs_component_count(ECS *ecs, ComponentType type);
+void *ecs_component_at(ECS *ecs, ComponentType type, size_t index);
+Entity ecs_component_entity_at(ECS *ecs, ComponentType type, size_t index);
+
 void ecs_register_system(ECS *ecs, SystemFunc system_func,
                          ComponentMask required_components);
+void ecs_register_system_with_access(ECS *ecs, SystemFunc system_func,
+                                     ComponentMask read_components,
+                                     ComponentMask write_components);
+void ecs_set_thread_pool(ECS *ecs, ThreadPool *pool);
 void ecs_update_systems(ECS *ecs, float delta_time);
 
+// Query API: iterate only the archetypes that match a component mask
+// Structural changes (create/destroy, add/remove) during iteration may skip or
+// repeat entities - collect first, then modify.
+typedef enum {
+  ECS_QUERY_FILTER_NONE,
+  ECS_QUERY_FILTER_CHANGED,
+  ECS_QUERY_FILTER_ADDED,
+} EcsQueryFilter;
+
+typedef struct {
+  ECS *ecs;
+  const EcsQuery *query;
+  size_t archetype_index; // Position in query->archetypes
+  size_t row;             // Next row in the current archetype
+
+  EcsQueryFilter filter; // Optional tick filter on filter_type
+  ComponentType filter_type;
+  uint32_t filter_since;
+} EcsQueryIter;
+
+EcsQuery *ecs_query(ECS *ecs, ComponentMask component_mask);
+EcsQueryIter ecs_query_iter(ECS *ecs, ComponentMask component_mask);
+
+// Only yield entities whose `type` component was changed/added at or after
+// tick `since`. An incremental system keeps `since = ecs_change_tick(ecs)`
+// from its previous run: a write in that same tick may be seen twice, but
+// none is missed.
+EcsQueryIter ecs_query_iter_changed(ECS *ecs, ComponentMask component_mask,
+                                    ComponentType type, uint32_t since);
+EcsQueryIter ecs_query_iter_added(ECS *ecs, ComponentMask component_mask,
+                                  ComponentType type, uint32_t since);
+bool ecs_query_next(EcsQueryIter *iter, Entity *out_entity);
+size_t ecs_query_count(ECS *ecs, ComponentMask component_mask);
+
+// Deferred structural changes: safe to call from systems and chunk kernels
+// while other threads iterate. Each thread records into its own buffer
+// (selected by thread_pool_current_worker()) and nothing touches the ECS until
+// ecs_flush_commands(), which ecs_update_systems() calls after every batch of
+// systems. Buffers replay in worker order, commands in recording order.
+//
+// ecs_defer_create_entity() returns a deferred handle that later commands
+// from the same thread may target before the flush. ecs_defer_add_component()
+// returns a zeroed staging copy to fill in; it is valid until the thread's
+// next deferred call, and replay adds the component (if missing) and sets it
+// to the staged value. Consecutive adds to one entity move it between
+// archetypes once. Commands on entities that are no longer alive are dropped.
+Entity ecs_defer_create_entity(ECS *ecs);
+void ecs_defer_destroy_entity(ECS *ecs, Entity entity);
+void *ecs_defer_add_component(ECS *ecs, Entity entity, ComponentType type);
+void ecs_defer_remove_component(ECS *ecs, Entity entity, ComponentType type);
+void ecs_flush_commands(ECS *ecs);
+
+// Chunked group iteration: a chunk is at most ECS_COMPONENT_PAGE_SIZE group
+// members whose owned components are contiguous arrays, e.g.
+//   Transform *t = (Transform *)chunk->components[transform_type];
+//   for (size_t i = 0; i < chunk->count; i++) t[i].position = ...;
+typedef struct {
+  void *components[MAX_COMPONENTS];        // Base pointer per owned type
+  EcsComponentTicks *ticks[MAX_COMPONENTS]; // Row-aligned change stamps
+  uint32_t *chunk_changed[MAX_COMPONENTS];  // Page stamp: latest row `changed`
+  const Entity *entities;                   // Entity of each row
+  size_t count;
+  size_t index;          // Chunk index in [0, ecs_group_chunk_count())
+  uint32_t tick;         // Current change tick (ecs_chunk_mark_changed)
+  uint32_t worker_index; // Executing thread (see ThreadPoolTaskFunc)
+} EcsChunk;
+
+// Chunk kernels write through base pointers, so they stamp changes directly
+static inline void ecs_chunk_mark_changed(const EcsChunk *chunk,
+                                          ComponentType type, size_t row) {
+  chunk->ticks[type][row].changed = chunk->tick;
+  *chunk->chunk_changed[type] = chunk->tick;
+}
+
+// False if no row's `type` component was stamped at or after `since`, so a
+// change-filtered pass can skip the whole chunk
+static inline bool ecs_chunk_changed_since(const EcsChunk *chunk,
+                                           ComponentType type, uint32_t since) {
+  return *chunk->chunk_changed[type] >= since;
+}
+
+// chunk_context points at this chunk's element of the caller's context array
+// (NULL if none was given); writing partial results there and combining them
+// afterwards gives lock-free reductions.
+typedef void (*EcsChunkFunc)(const EcsChunk *chunk, void *user_data,
+                             void *chunk_context);
+
+// Find or create the group owning `owned` (NULL if another group owns any of
+// those components). Existing entities are packed on creation.
+EcsGroup *ecs_group(ECS *ecs, ComponentMask owned);
+size_t ecs_group_chunk_count(const EcsGroup *group);
+bool ecs_group_chunk(ECS *ecs, const EcsGroup *group, size_t index,
+                     EcsChunk *out_chunk);
+
+// Run func once per chunk on the ECS thread pool (serially without one) and
+// wait. chunk_contexts is NULL or an array of ecs_group_chunk_count() elements
+// of context_size bytes. Chunks may write their own rows only; structural
+// changes are not allowed until this returns.
+void ecs_group_parallel_for(ECS *ecs, const EcsGroup *group, EcsChunkFunc func,
+                            void *user_data, void *chunk_contexts,
+                            size_t context_size);
+
 // Component iteration API
 typedef void (*EntityIteratorFunc)(ECS *ecs, Entity entity, void *user_data);
 void ecs_iterate_entities(ECS *ecs, ComponentMask component_mask, EntityIteratorFunc func, void *user_data);
 size_t ecs_get_entities_with_components(ECS *ecs, ComponentMask component_mask, Entity *out_entities, size_t max_entities);
 
+// ecs_init reserves ECS_DEFAULT_ENTITY_CAPACITY; both grow on demand
 void ecs_init(ECS *ecs);
+void ecs_init_with_capacity(ECS *ecs, size_t entity_capacity);
 void ecs_cleanup(ECS *ecs);
 
 #endif
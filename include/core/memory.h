@@ -1,6 +1,7 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -9,21 +10,78 @@
 #define ARENA_DEFAULT_SIZE (16 * 1024 * 1024)  // 16MB: supports 2048 entities with 4 components (~370KB) + spatial grid overhead
 #define ARENA_ALIGNMENT 8                  // 8-byte alignment for most platforms
 #define ARENA_MAX_ARENAS 16               // Maximum number of arenas per pool
-#define ARENA_EXPANSION_THRESHOLD 0.8f     // Expand when 80% full
+#define ARENA_SCRATCH_SIZE (256 * 1024)   // First block of each per-thread frame arena
+#define ARENA_VIRTUAL_COMMIT_STEP (2 * 1024 * 1024)  // Commit granularity (one huge page)
+#define ARENA_POOL_RESERVE_SIZE ((size_t)1024 * 1024 * 1024)  // Address space per pool arena (64-bit)
+#define OBJECT_POOL_DEFAULT_SLAB 256      // Objects per slab when 0 is passed
+#define OBJECT_POOL_CACHE_BATCH 32        // Objects moved between a thread cache and the pool at once
+#define OBJECT_POOL_MAX_CACHES 65         // Thread caches: caller + THREAD_POOL_MAX_THREADS workers
+#define MEMORY_MAX_CALLSITES 512          // Call sites recorded with MEMORY_TRACK_CALLSITES
+
+// Debug builds record where allocations come from (see memory_telemetry_dump)
+#if defined(DEBUG) && !defined(MEMORY_TRACK_CALLSITES)
+#define MEMORY_TRACK_CALLSITES
+#endif
+
+// System an allocation is charged to. Arenas, arena pools and object pools
+// are untagged until given one (arena_set_tag and friends).
+typedef enum {
+    MEMORY_TAG_UNTAGGED,
+    MEMORY_TAG_ECS,
+    MEMORY_TAG_PHYSICS,
+    MEMORY_TAG_SCRATCH,
+    MEMORY_TAG_GAME,
+    MEMORY_TAG_COUNT
+} MemoryTag;
+
+// Block chained on when an arena's current block is full (see arena_alloc)
+typedef struct ArenaChunk ArenaChunk;
 
 // Memory arena structure - supports ZII
+// Allocations bump through the current block. When it is full, an arena
+// that owns its memory moves on to a chunk chained after it rather than
+// reallocating, so pointers already handed out stay valid and nothing is
+// copied. Chunks are kept across resets and reused by the next spike.
 typedef struct {
-    char* memory;           // Pointer to allocated memory block
-    size_t size;           // Total size of the arena
-    size_t used;           // Current offset/used bytes
+    char* memory;           // Current block (the first block or a chunk)
+    size_t size;           // Size of the current block
+    size_t used;           // Offset into the current block
     bool owns_memory;      // Whether this arena owns its memory block
+    char* base_memory;     // First block
+    size_t base_size;
+    ArenaChunk* chunk;     // Current chunk, NULL while in the first block
+    ArenaChunk* chunks;    // Chunks chained after the first block, in order
+    char* last_alloc;      // Start of the current block's last allocation (for arena_trim_last)
+    size_t reserved;       // Virtual first block: address space reserved (0 = malloc'd)
+    uint32_t flags;        // ARENA_VIRTUAL_* it was created with, plus results
+
+    // Telemetry: bytes requested since the last reset, charged to the tag
+    MemoryTag tag;
+    size_t tracked;
+    size_t peak;           // High-water mark of tracked
+    uint64_t alloc_count;
 } Arena;
 
+// arena_init_virtual flags
+#define ARENA_VIRTUAL_HUGE_PAGES (1u << 0)     // madvise(MADV_HUGEPAGE): transparent huge pages
+#define ARENA_VIRTUAL_HUGETLB (1u << 1)        // MAP_HUGETLB; takes the whole reservation from the
+                                               // system's reserved huge pages, else falls back
+#define ARENA_VIRTUAL_PREFAULT (1u << 2)       // Touch pages as they are committed
+#define ARENA_VIRTUAL_HUGETLB_BACKED (1u << 8) // Result: the range got MAP_HUGETLB pages
+
+// Position in an arena to reset back to; valid across chunks
+typedef struct {
+    ArenaChunk* chunk;
+    size_t used;
+    size_t tracked;        // Bytes to hand back to the tag on reset
+} ArenaMark;
+
 // Arena pool for managing multiple arenas - supports ZII
 typedef struct {
     Arena arenas[ARENA_MAX_ARENAS];
     size_t arena_count;
     size_t current_arena;  // Index of current arena for allocation
+    MemoryTag tag;         // Given to every arena in the pool
 } ArenaPool;
 
 // ZII-compatible arena initialization (use static memory block)
@@ -32,19 +90,38 @@ void arena_init_with_buffer(Arena* arena, void* buffer, size_t size);
 // Traditional arena initialization (allocates memory)
 bool arena_init(Arena* arena, size_t size);
 
+// Reserves reserve_size of address space and commits commit_size of it up
+// front; the first block then commits ARENA_VIRTUAL_COMMIT_STEP at a time
+// in place as it fills (no chunks until the reservation runs out). With
+// ARENA_VIRTUAL_PREFAULT the committed pages are touched here rather than
+// on first use in the frame loop. Falls back to arena_init(commit_size)
+// where mmap isn't available or fails.
+bool arena_init_virtual(Arena* arena, size_t reserve_size, size_t commit_size, uint32_t flags);
+
 // Cleanup arena (only frees if owns_memory is true)
 void arena_cleanup(Arena* arena);
 
 // Reset arena to beginning (keeps memory allocated)
 void arena_reset(Arena* arena);
 
-// Expand arena if approaching capacity threshold (doubles size)
+// Makes sure the next upcoming_alloc_size bytes fit the current block,
+// moving on to a chunk if they don't (never moves memory already handed out)
 bool arena_expand_if_needed(Arena* arena, size_t upcoming_alloc_size);
 
+// Reset to a position taken with arena_mark; later chunks stay for reuse
+ArenaMark arena_mark(const Arena* arena);
+void arena_reset_to_mark(Arena* arena, ArenaMark mark);
+
 // Allocate from arena with alignment
 void* arena_alloc(Arena* arena, size_t size);
 void* arena_alloc_aligned(Arena* arena, size_t size, size_t alignment);
 
+// Shrinks the arena's last allocation to new_size, handing the tail back
+// (and releasing it from the tag); false (and nothing changes) if ptr isn't
+// the last allocation (resets, marks and chunk switches forget it) or would
+// grow
+bool arena_trim_last(Arena* arena, void* ptr, size_t new_size);
+
 // Arena pool functions - ZII compatible
 bool arena_pool_init(ArenaPool* pool);
 void arena_pool_cleanup(ArenaPool* pool);
@@ -58,7 +135,9 @@ typedef struct {
     size_t total_size;
     size_t used_bytes;
     size_t free_bytes;
-    size_t arena_count;
+    size_t arena_count;    // For one arena: its blocks (first block + chunks)
+    size_t peak_bytes;     // Most bytes requested between resets
+    uint64_t alloc_count;
 } ArenaStats;
 
 void arena_get_stats(const Arena* arena, ArenaStats* stats);
@@ -67,10 +146,137 @@ void arena_pool_get_stats(const ArenaPool* pool, ArenaStats* stats);
 // Temporary arena scope helpers (for scoped allocations)
 typedef struct {
     Arena* arena;
-    size_t saved_used;
+    ArenaMark mark;
 } ArenaScope;
 
 ArenaScope arena_scope_begin(Arena* arena);
 void arena_scope_end(ArenaScope scope);
 
+// Per-thread scratch arenas. Every thread has two, this frame's and last
+// frame's, created on first use; arena_scratch_next_frame() (once per frame,
+// from the main loop) makes each thread swap them and reset the new current
+// one the next time it asks for scratch. Memory taken in a frame stays valid
+// through the next, so a frame can read what the previous one built. No
+// locks and no malloc after the first frames (chunks are kept).
+// Scopes must begin and end within one frame.
+Arena* arena_scratch(void);             // This frame's arena, this thread
+Arena* arena_scratch_last_frame(void);  // Last frame's, still intact
+ArenaScope arena_scratch_begin(void);   // Scope over arena_scratch()
+void arena_scratch_next_frame(void);
+uint64_t arena_scratch_frame(void);
+// Frees the calling thread's scratch arenas (thread pool workers call this
+// on exit; the main thread at shutdown)
+void arena_scratch_thread_cleanup(void);
+
+// Fixed-size object pool - supports ZII (a zeroed pool must be initialized)
+// For objects with their own lifetimes (projectiles, path requests, ...).
+// Objects are carved from slabs of objects_per_slab; freed objects go on an
+// intrusive free list (the link lives in the object) and are handed out
+// first, so alloc and free are O(1) and slabs are never returned to the
+// system until cleanup. Objects never move.
+// With thread caches, each thread keeps a small free list of its own and
+// only locks the pool to move OBJECT_POOL_CACHE_BATCH objects at a time.
+// Caches are picked by thread_pool_current_worker(), so only the thread
+// pool's workers and the thread that submits its jobs may use such a pool.
+typedef struct ObjectPoolSlab ObjectPoolSlab;
+
+typedef struct {
+    void* head;      // Intrusive free list
+    size_t count;
+} ObjectPoolCache;
+
+typedef struct {
+    size_t object_size;       // Rounded up to ARENA_ALIGNMENT, at least a pointer
+    size_t objects_per_slab;
+    ObjectPoolSlab* slabs;    // Every slab, in allocation order
+    ObjectPoolSlab* carving;  // Slab new objects are carved from
+    size_t carved;            // Objects carved from it so far
+    void* free_list;
+    size_t slab_count;
+
+    // Counters (updated atomically when thread caches are on)
+    size_t live_count;
+    size_t peak_count;
+    uint64_t alloc_count;
+    uint64_t free_count;
+
+    bool thread_caches;
+    MemoryTag tag;
+    pthread_mutex_t mutex;    // Guards the shared lists when thread caches are on
+    ObjectPoolCache caches[OBJECT_POOL_MAX_CACHES];
+} ObjectPool;
+
+bool object_pool_init(ObjectPool* pool, size_t object_size, size_t objects_per_slab,
+                      bool thread_caches);
+void object_pool_cleanup(ObjectPool* pool);
+
+// NULL only if a new slab can't be allocated; contents are not cleared
+void* object_pool_alloc(ObjectPool* pool);
+void object_pool_free(ObjectPool* pool, void* object);
+// Frees every object at once, keeping the slabs (no other thread may be
+// using the pool)
+void object_pool_free_all(ObjectPool* pool);
+
+// total_size/used_bytes cover slab bytes and live objects; arena_count is
+// the slab count
+void object_pool_get_stats(const ObjectPool* pool, ArenaStats* stats);
+
+#define OBJECT_POOL_INIT(pool, Type, per_slab, thread_caches) \
+    object_pool_init((pool), sizeof(Type), (per_slab), (thread_caches))
+#define OBJECT_POOL_NEW(pool, Type) ((Type*)object_pool_alloc(pool))
+
+// Allocation telemetry. Counters are global per tag and updated with relaxed
+// atomics, so they stay on in release builds. Arena bytes are live from the
+// allocation until the arena is reset (or unwound past it); object pool
+// bytes until the object is freed.
+typedef struct {
+    size_t live_bytes;
+    size_t peak_bytes;
+    uint64_t alloc_count;        // Since startup
+    uint64_t alloc_bytes;
+    uint64_t frame_allocs;       // During the last completed frame
+    uint64_t frame_bytes;
+} MemoryTagStats;
+
+// Moves anything already charged over to the new tag
+void arena_set_tag(Arena* arena, MemoryTag tag);
+void arena_pool_set_tag(ArenaPool* pool, MemoryTag tag);
+void object_pool_set_tag(ObjectPool* pool, MemoryTag tag);
+
+void memory_tag_get_stats(MemoryTag tag, MemoryTagStats* stats);
+const char* memory_tag_name(MemoryTag tag);
+
+// Closes the telemetry frame (arena_scratch_next_frame calls this)
+void memory_telemetry_next_frame(void);
+
+// Allocations per call site, biggest first. Empty unless callers are built
+// with MEMORY_TRACK_CALLSITES (or note sites themselves).
+typedef struct {
+    const char* file;
+    int line;
+    MemoryTag tag;
+    uint64_t alloc_count;
+    uint64_t alloc_bytes;
+} MemoryCallsite;
+
+size_t memory_telemetry_callsites(MemoryCallsite* sites, size_t max_sites);
+
+// Writes the tag table (and call sites, if recorded) as text; NULL path
+// writes to stdout
+bool memory_telemetry_dump(const char* path);
+
+// Notes the caller's site for the allocation that follows on this thread
+void memory_track_callsite(const char* file, int line);
+
+#ifdef MEMORY_TRACK_CALLSITES
+#define arena_alloc(arena, size) \
+    (memory_track_callsite(__FILE__, __LINE__), arena_alloc((arena), (size)))
+#define arena_alloc_aligned(arena, size, alignment) \
+    (memory_track_callsite(__FILE__, __LINE__), arena_alloc_aligned((arena), (size), (alignment)))
+#define arena_pool_alloc(pool, size) \
+    (memory_track_callsite(__FILE__, __LINE__), arena_pool_alloc((pool), (size)))
+#define object_pool_alloc(pool) \
+    (memory_track_callsite(__FILE__, __LINE__), object_pool_alloc(pool))
+#endif
+
 #endif
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "components.h"
 #include "ecs.h"
 #include "memory.h"
+#include "physics_bodies.h"
+#include "aabb_tree.h"
 #include "coordinate_system.h"
 #include <stdbool.h>
 
@@ -12,7 +14,9 @@
 #define PHYSICS_DEFAULT_DAMPING 0.98f           // Light damping to preserve gravity behavior
 #define PHYSICS_DEFAULT_BOUNDARY_RADIUS WORLD_BOUNDARY_RADIUS  // Use shared coordinate system
 #define PHYSICS_SPATIAL_CELL_SIZE 20.0f
-#define PHYSICS_SPATIAL_BUFFER_SIZE 16384  // Larger buffer for 5K+ entities
+#define PHYSICS_QUERY_ARENA_SIZE (1024 * 1024)  // Query grid arena, grows with the world
+#define PHYSICS_SPATIAL_ARENA_SIZE (16 * 1024 * 1024)  // Committed up front, prefaulted
+#define PHYSICS_SPATIAL_ARENA_RESERVE ((size_t)1024 * 1024 * 1024)  // Address space to grow into
 #define PHYSICS_MAX_PENETRATION_RATIO 0.8f
 #define PHYSICS_CORRECTION_FACTOR 0.7f         // Balanced correction factor
 #define PHYSICS_OVERLAP_THRESHOLD 0.001f
@@ -20,6 +24,11 @@
 #define PHYSICS_SLEEP_VELOCITY_THRESHOLD 1.0f    // Lower threshold for better settling
 #define PHYSICS_SLEEP_TIME_THRESHOLD 30          // Faster sleep for stability
 #define PHYSICS_WAKE_VELOCITY_THRESHOLD 5.0f     // Lower wake threshold
+#define PHYSICS_BODY_BATCH_SIZE 1024             // Body rows per SIMD kernel task
+#define PHYSICS_DEFAULT_MAX_SUBSTEPS 4           // Fixed steps per update before dropping time
+#define PHYSICS_DEFAULT_WARM_START 1.0f          // Share of a resting contact's rebound removed
+#define PHYSICS_WARM_START_MIN_ALIGNMENT 0.9f    // Cosine between last and current normal to count as resting
+#define PHYSICS_BOUNDARY_CONTACT_SLOP 0.01f      // Distance from the boundary still counted as touching it
 
 typedef struct {
     Vec3 velocity;
@@ -27,6 +36,8 @@ typedef struct {
     Vec3 old_position;
     bool is_sleeping;          // Whether object is in sleep mode
     int sleep_timer;           // Frames the object has been below sleep threshold
+    uint32_t island;           // Shared by bodies that fell asleep together (0 = awake)
+    uint32_t tree_proxy;       // Leaf in PhysicsWorld.body_tree (0 = none)
 } VerletBody;
 
 typedef struct {
@@ -35,38 +46,302 @@ typedef struct {
     float restitution;
 } CircleCollider;
 
-typedef struct EntityNode {
-    Entity entity;
-    struct EntityNode* next;
-} EntityNode;
-
-typedef struct {
-    EntityNode* entities;
-} SpatialCell;
-
+// Uniform grid built by counting sort - supports ZII
+// Each body goes in the one cell holding its center (clamped to the grid), so
+// cell c's bodies are cell_entities[cell_start[c] .. cell_end[c]) and
+// overlaps are found by sweeping the cells within `reach` of a body's cell.
+// The arrays live in the arena passed to spatial_grid_build and stay valid
+// until that arena is reset.
 typedef struct {
-    SpatialCell* cells;
     int grid_width;
     int grid_height;
     float cell_size;
     Vec3 grid_origin;
+
+    uint32_t* cell_start;     // grid_width * grid_height + 1 prefix sums
+    uint32_t* cell_end;       // cell_start + 1, or SpatialGridCells.end
+    const uint32_t* occupied; // Non-empty cells, ascending
+    size_t occupied_count;
+    uint32_t* cell_entities;  // Body rows sorted by cell
+    uint32_t* body_cell;      // Cell of each row, SPATIAL_GRID_NO_CELL if excluded
+    size_t body_count;        // Rows (or list entries) passed to the last build
+    float max_radius;         // Largest radius among the inserted rows
+    int reach;                // Neighbour cells to sweep (covers the largest pair)
 } SpatialGrid;
 
+#define SPATIAL_GRID_NO_CELL UINT32_MAX
+
+// Cell ranges kept between spatial_grid_build_rows calls - supports ZII.
+// Empty cells read as [0, 0); a build resets only the cells the previous one
+// filled, so it costs O(rows) however many cells the grid has.
+typedef struct {
+    uint32_t* start;
+    uint32_t* end;
+    uint32_t* occupied;     // Cells the last build filled, ascending
+    size_t occupied_count;
+    size_t occupied_capacity;
+    size_t cell_count;      // Cells start and end cover
+} SpatialGridCells;
+
+// Collision pass ordering. Both are deterministic; they just visit pairs in
+// a different order, so their results differ slightly.
+typedef enum {
+    // Cells are split into (2 * reach + 1)^2 colour classes. Cells of one
+    // colour are far enough apart that their pairs share no body, so each
+    // class runs across the thread pool without locks, and the result does
+    // not depend on the thread count.
+    PHYSICS_SOLVER_COLORED = 0,
+    // Every cell in row-major order on the calling thread (reference order)
+    PHYSICS_SOLVER_SERIAL
+} PhysicsSolverMode;
+
+// How a collision pass finds candidate pairs
+typedef enum {
+    // Uniform grid rebuilt each pass (see SpatialGrid); best when radii are
+    // similar. One large body widens the neighbour sweep of every cell.
+    PHYSICS_BROADPHASE_GRID = 0,
+    // Rows kept sorted by left edge across steps and swept along x; cost
+    // doesn't depend on the spread of radii. Runs on the calling thread.
+    PHYSICS_BROADPHASE_SWEEP,
+    // Dynamic AABB tree with one persistent leaf per body; no world bounds,
+    // so sparse or very large worlds cost nothing for empty space, and the
+    // tree answers region queries too. Runs on the calling thread.
+    PHYSICS_BROADPHASE_TREE
+} PhysicsBroadphase;
+
+// Step phases timed when PhysicsWorld.profile is set
+typedef enum {
+    PHYSICS_PHASE_INTEGRATE = 0,  // Integration
+    PHYSICS_PHASE_BROADPHASE,     // Grid build, sweep sort or tree sync and pairs
+    PHYSICS_PHASE_NARROWPHASE,    // Pair tests and resolution (with the grid's cell walk)
+    PHYSICS_PHASE_CONSTRAINTS,    // Boundary constraint
+    PHYSICS_PHASE_ISLANDS,        // Waking, contact cache and island sleeping
+    PHYSICS_PHASE_COUNT
+} PhysicsPhase;
+
+// Sort-and-sweep state - supports ZII. The order persists between steps;
+// bodies barely move per step, so re-sorting it is a nearly linear
+// insertion sort.
+typedef struct {
+    uint32_t* order;  // Awake body rows by left edge (x - radius)
+    float* min_x;     // Left edge of order[i] when last sorted
+    uint8_t* listed;  // Per row: in order
+    size_t count;     // Rows in order
+    size_t capacity;  // Rows order and listed hold
+} PhysicsSweep;
+
+#define PHYSICS_NO_ROW UINT32_MAX
+
+// Sleeping bodies binned by the step grid's cells, kept between steps and
+// updated as islands fall asleep and wake rather than rebuilt. Each cell is
+// a doubly linked list of rows and each island's rows form a ring, so
+// waking an island costs its size - supports ZII
+typedef struct {
+    uint32_t* cell_head;    // First row per cell, PHYSICS_NO_ROW if empty
+    size_t cell_count;
+    uint32_t* cell;         // Per row: cell, PHYSICS_NO_ROW when not binned
+    uint32_t* next;         // Per row: neighbours in the cell's list
+    uint32_t* prev;
+    uint32_t* island_next;  // Per row: next member of its island (itself when alone)
+    size_t count;           // Rows binned
+    float max_radius;       // Largest radius binned since the last rebuild
+} PhysicsSleepers;
+
+// Touching body rows recorded by one worker during a collision pass
+typedef struct {
+    uint32_t* pairs;  // Row pairs, a then b
+    size_t count;     // Pairs recorded
+    size_t capacity;  // Pairs allocated
+} PhysicsContactList;
+
+// A pair still overlapping at the end of a step
+typedef struct {
+    uint64_t key;     // Lower entity << 32 | higher entity, 0 = empty slot
+    float normal_x;   // From the lower entity towards the higher one
+    float normal_y;
+} PhysicsContactEntry;
+
+// Contact pairs keyed by entity, so they persist across steps even though
+// body rows don't. Open addressing, at most half full - supports ZII
+typedef struct {
+    PhysicsContactEntry* entries;
+    size_t capacity;  // Power of two
+    size_t count;
+} PhysicsContactCache;
+
+// Batched spatial queries (physics_query_*). Query i's entities are
+// entities[offsets[i] .. offsets[i + 1]); both arrays share one block in the
+// caller's arena.
+typedef struct {
+    Entity* entities;
+    uint32_t* offsets;   // query_count + 1 entries
+    size_t query_count;
+} PhysicsQueryResults;
+
+typedef struct {
+    Vec3 center;
+    float radius;
+} PhysicsCircleQuery;
+
+typedef struct {
+    Vec3 point;
+    uint32_t k;          // Bodies wanted
+    float max_distance;  // From the point to a body's edge; 0 = unlimited
+} PhysicsNearestQuery;
+
+typedef struct {
+    Vec3 origin;
+    Vec3 direction;      // Needn't be normalised
+    float max_distance;  // 0 = unlimited
+} PhysicsRaycastQuery;
+
+typedef struct {
+    bool hit;
+    Entity entity;
+    float distance;      // Along the ray; 0 when it starts inside the body
+    Vec3 point;
+    Vec3 normal;         // Out of the body at point
+} PhysicsRayHit;
+
+// Rows gathered while a query batch runs, copied out at the end
+typedef struct {
+    uint32_t* rows;
+    float* distances;    // Per row, for nearest queries
+    size_t count;
+    size_t capacity;
+    uint32_t* offsets;
+    size_t offset_capacity;
+} PhysicsQueryScratch;
+
+// One body's components as a snapshot stores them, compared word by word
+typedef struct {
+    Entity entity;
+    Transform transform;
+    VerletBody verlet;
+    CircleCollider collider;
+} PhysicsSnapshotRow;
+
+#define PHYSICS_SNAPSHOT_ROW_WORDS (sizeof(PhysicsSnapshotRow) / sizeof(uint32_t))
+
+// Physics state after one step (see physics_snapshot). The struct belongs to
+// the caller and its data to the caller's arena; a delta snapshot needs its
+// base (and the base's bases) kept alive until it is no longer restored.
+typedef struct PhysicsSnapshot {
+    const struct PhysicsSnapshot* base;  // NULL for a full snapshot
+    uint64_t id;                         // Unique per world
+    size_t body_count;
+    size_t changed_rows;                 // Rows stored (all of them when full)
+    size_t contact_count;
+
+    uint64_t step_count;
+    uint64_t random_seed;
+    float accumulator;
+    float interpolation_alpha;
+    uint32_t next_island;
+
+    // Contact cache entries, then either every row (full) or a bit per row
+    // followed by each changed row's word mask and changed words (delta)
+    void* data;
+    size_t data_size;
+} PhysicsSnapshot;
+
 typedef struct {
     ECS* ecs;
     ComponentType transform_type;
     ComponentType verlet_type;
     ComponentType collider_type;
+    EcsGroup* body_group;  // Owns transform/verlet/collider for chunked loops
     
     Vec3 gravity;
     float damping;
     int collision_iterations;
+    PhysicsSolverMode collision_solver;  // Grid broadphase only
+    PhysicsBroadphase broadphase;
+
+    // Fixed-step mode (see physics_set_fixed_timestep); 0 = step with the
+    // frame's delta_time
+    float fixed_timestep;
+    int max_substeps;
+    float accumulator;          // Unsimulated time carried to the next update
+    float interpolation_alpha;  // accumulator / fixed_timestep, 1 in variable mode
     
     Vec3 boundary_center;
     float boundary_radius;
     
-    SpatialGrid spatial_grid;
-    Arena spatial_arena;  // Arena for spatial grid allocations
+    SpatialGrid spatial_grid;  // Holds body rows during a step
+    SpatialGridCells awake_cells;  // spatial_grid's ranges, kept across builds
+    Arena spatial_arena;  // Per-step grid arrays, reset before each build
+    PhysicsSweep sweep;   // Sort-and-sweep order (PHYSICS_BROADPHASE_SWEEP)
+    AabbTree body_tree;   // Leaf per body, user = row (PHYSICS_BROADPHASE_TREE)
+    PhysicsContactList tree_pairs;  // Awake rows whose fattened leaves overlap
+    bool tree_pairs_stale;          // Rebuild before the next pass
+    bool tree_full_sync;            // Rows were regathered: move (or claim) every leaf
+    uint8_t* tree_moved;            // Per row: leaf reinserted this pass (zero between passes)
+
+    // Batched queries: a grid over every body (the step's grid leaves
+    // sleepers out) rebuilt per batch, and the rows found so far
+    SpatialGrid query_grid;
+    Arena query_arena;
+    PhysicsQueryScratch query_scratch;
+
+    // SoA copy of the body group (row i = group row i). It persists between
+    // steps: a step reads back the awake rows plus the sleepers stamped since
+    // the last write-back, steps the awake rows only, and writes back the
+    // rows it touched. Adding or removing bodies (or restoring a snapshot)
+    // regathers every row. Game code changing a sleeping body must stamp it
+    // (ecs_get_component_mut, ecs_mark_changed or ecs_chunk_mark_changed),
+    // and advancing the ECS tick between steps keeps bodies that fell asleep
+    // from being read back again.
+    PhysicsBodies bodies;
+    float* held_acceleration;  // Frame accelerations replayed on each substep
+    size_t held_capacity;
+    uint32_t* awake_rows;      // Rows being stepped, ascending
+    size_t awake_count;
+    uint32_t* written_rows;    // Rows to write back, each once
+    uint8_t* written;          // Per row: in written_rows
+    size_t written_count;
+    size_t row_capacity;       // Rows the lists above (and sleepers) hold
+    PhysicsSleepers sleepers;
+    bool synced;               // Store matches the group as of synced_tick
+    bool scatter_all;          // Write back every row at the end of the step
+    uint32_t synced_version;   // body_group->version at the last write-back
+    uint32_t synced_tick;      // ECS change tick at the last write-back
+
+    // Island sleeping: contacts from the last collision pass of a step, one
+    // list per worker, joined with union-find at the end of the step
+    PhysicsContactList contacts[THREAD_POOL_MAX_THREADS + 1];
+    uint32_t next_island;  // Last island id handed out
+
+    // Contact cache: the pairs still overlapping after the last step, and
+    // the table this step's pairs go into (the two swap every step)
+    PhysicsContactCache contact_cache[2];
+    int contact_cache_read;  // Index of last step's table
+    float warm_start;        // Share of a resting contact's rebound removed each step (0 = off)
+
+    // Determinism. Contacts whose centres coincide take a direction from a
+    // counter-based generator keyed by seed, step and entity pair, so it
+    // doesn't depend on thread or pass order. Deterministic mode also makes
+    // the tree broadphase's pair order independent of its history, and
+    // hashes the state after every step.
+    uint64_t random_seed;    // See physics_set_seed
+    uint64_t step_count;     // Steps since init or the last reseed
+    bool deterministic;
+    uint64_t state_hash;     // physics_state_hash after the last step (deterministic mode)
+    bool determinism_lost;   // Set (never cleared) when a deterministic step ran out of
+                             // memory and fell back to thread-order results; replays may diverge
+
+    // Profiling: seconds per phase over the last physics_world_step or
+    // physics_world_update call (every substep), when profile is set
+    bool profile;
+    double phase_seconds[PHYSICS_PHASE_COUNT];
+    double profile_mark;  // Clock at the last phase boundary
+
+    // Snapshots: the rows of the last snapshot taken or restored, which
+    // deltas are taken against and applied to
+    uint32_t* snapshot_words;  // PHYSICS_SNAPSHOT_ROW_WORDS per row
+    size_t snapshot_capacity;  // Rows
+    uint64_t snapshot_rows_id; // Snapshot the rows hold, 0 = none
+    uint64_t last_snapshot_id;
 } PhysicsWorld;
 
 void physics_world_init(PhysicsWorld* world, ECS* ecs, ComponentType transform_type);
@@ -76,6 +351,63 @@ Entity physics_create_circle(PhysicsWorld* world, Vec3 position, float radius, f
 void physics_set_boundary(PhysicsWorld* world, Vec3 center, float radius);
 
 void physics_system_update(float delta_time);
+void physics_world_step(PhysicsWorld* world, float delta_time);
+
+// Reseeds the contact direction generator and restarts the step count
+void physics_set_seed(PhysicsWorld* world, uint64_t seed);
+// FNV-1a over the bit patterns of every body's entity, position, previous
+// position and sleep state as of the last step, in row order. Equal hashes
+// mean bit-identical states (barring collisions), for replay and build
+// comparisons; builds must agree on floating-point contraction (the default
+// -std=c99 keeps it off).
+uint64_t physics_state_hash(const PhysicsWorld* world);
+// "integrate", "broadphase", ... for reports
+const char* physics_phase_name(PhysicsPhase phase);
+
+// Captures the body group's components, the sleep state, the contact cache
+// and the stepping state into out, with its data in arena. With a base the
+// snapshot stores only the words that differ from it (a full snapshot is
+// taken instead if the body count changed).
+bool physics_snapshot(PhysicsWorld* world, const PhysicsSnapshot* base, Arena* arena,
+                      PhysicsSnapshot* out);
+// Writes a snapshot back into the ECS and the world; restoring a delta
+// replays its chain back to the last full snapshot (or to the rows held).
+// The body group must hold the same entities in the same order as when the
+// snapshot was taken; fails without changing anything otherwise.
+bool physics_restore(PhysicsWorld* world, const PhysicsSnapshot* snapshot);
+
+// timestep 0 returns to variable stepping; max_substeps <= 0 uses the default
+void physics_set_fixed_timestep(PhysicsWorld* world, float timestep, int max_substeps);
+// Advances by frame_time: one variable step, or in fixed-step mode as many
+// fixed steps as the accumulator holds (capped at max_substeps, dropping the
+// excess). Accelerations set since the last update act on every substep.
+// Returns the number of steps taken.
+int physics_world_update(PhysicsWorld* world, float frame_time);
+// old_position blended towards position by interpolation_alpha, for rendering
+// between the last two fixed steps
+Vec3 physics_interpolated_position(const PhysicsWorld* world, Entity entity);
+// Entities whose circle overlaps box, as of the last step; writes and
+// returns at most max_entities. Uses the body tree when it is the
+// broadphase, else scans every body.
+size_t physics_query_region(const PhysicsWorld* world, Aabb box, Entity* out_entities,
+                            size_t max_entities);
+
+// Batched queries against the bodies as of the last step. Each call builds a
+// grid over every body (O(bodies)), so issue queries in batches rather than
+// one at a time. Results go in one block from the caller's arena; false if
+// it (or the world's scratch) can't hold them. Not reentrant per world.
+// Bodies overlapping each circle
+bool physics_query_circles(PhysicsWorld* world, const PhysicsCircleQuery* queries, size_t count,
+                           Arena* arena, PhysicsQueryResults* results);
+// Bodies overlapping each box
+bool physics_query_boxes(PhysicsWorld* world, const Aabb* boxes, size_t count,
+                         Arena* arena, PhysicsQueryResults* results);
+// Up to k bodies per query, nearest edge first
+bool physics_query_nearest(PhysicsWorld* world, const PhysicsNearestQuery* queries, size_t count,
+                           Arena* arena, PhysicsQueryResults* results);
+// First body along each ray; returns count hits from the arena, NULL on failure
+PhysicsRayHit* physics_raycast(PhysicsWorld* world, const PhysicsRaycastQuery* queries, size_t count,
+                               Arena* arena);
 void physics_verlet_integration(PhysicsWorld* world, float delta_time);
 void physics_solve_collisions(PhysicsWorld* world);
 void physics_apply_constraints(PhysicsWorld* world);
@@ -89,8 +421,22 @@ void resolve_circle_collision(Transform* t1, VerletBody* v1, CircleCollider* c1,
 void spatial_grid_init(SpatialGrid* grid, Arena* arena, Vec3 origin, float width, float height, float cell_size);
 void spatial_grid_cleanup(SpatialGrid* grid);
 void spatial_grid_clear(SpatialGrid* grid);
-void spatial_grid_insert(SpatialGrid* grid, Arena* arena, Entity entity, Vec3 position, float radius);
-void spatial_grid_get_potential_collisions(SpatialGrid* grid, Entity entity, Vec3 position, float radius, Entity** out_entities, int* out_count);
+// Two-pass counting sort of rows [0, count) into cells; rows with a non-zero
+// exclude entry (e.g. sleeping bodies) are left out. exclude may be NULL.
+bool spatial_grid_build(SpatialGrid* grid, Arena* arena, const float* x, const float* y,
+                        const float* radius, const int32_t* exclude, size_t count);
+// Same, over just the listed rows, with the ranges in cells instead of a
+// prefix sum (cell_start[c + 1] is not the end); body_cell is indexed by list
+// position
+bool spatial_grid_build_rows(SpatialGrid* grid, Arena* arena, SpatialGridCells* cells,
+                             const float* x, const float* y, const float* radius,
+                             const uint32_t* rows, size_t row_count);
+void spatial_grid_cells_cleanup(SpatialGridCells* cells);
+void spatial_grid_cell_coords(const SpatialGrid* grid, float x, float y, int* cell_x, int* cell_y);
+// Rows in cells overlapping the circle's bounds (plus the largest body radius);
+// returns the total match count, writing at most max_rows. Reentrant.
+size_t spatial_grid_query(const SpatialGrid* grid, float x, float y, float radius,
+                          uint32_t* out_rows, size_t max_rows);
 
 extern PhysicsWorld* g_physics_world;
 
@@ -0,0 +1,61 @@
+#ifndef PHYSICS_BODIES_H
+#define PHYSICS_BODIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PHYSICS_BODY_ALIGNMENT 32 // Array alignment (one AVX2 register)
+#define PHYSICS_BODY_ARRAY_STAGGER 64 // Extra bytes between arrays (one cache line)
+#define PHYSICS_NO_ISLAND 0
+
+// Structure-of-arrays body store - supports ZII
+// Physics is 2D, so only x/y are kept. Every array is PHYSICS_BODY_ALIGNMENT
+// aligned and carved from one block; growing drops the contents, since it
+// only happens when the body count changes and every row is regathered.
+typedef struct {
+  float *x;
+  float *y;
+  float *old_x;
+  float *old_y;
+  float *ax;
+  float *ay;
+  float *vx; // Velocity from the last integration, nudged by collisions
+  float *vy;
+  float *radius;
+  float *inv_mass;      // 0 = immovable
+  int32_t *sleeping;    // 0 or 1 (int32 so SIMD masks line up with floats)
+  int32_t *sleep_timer; // Steps spent below the sleep threshold
+  uint32_t *island;     // Sleeping island id, PHYSICS_NO_ISLAND while awake
+  uint32_t *entity;     // ECS entity of the row (keys the contact cache)
+  uint32_t *tree_proxy; // Broadphase tree leaf, 0 = none
+
+  size_t count;
+  size_t capacity;
+  void *block;
+} PhysicsBodies;
+
+typedef struct {
+  float gravity_x;
+  float gravity_y;
+  float damping;
+  float delta_time;
+  int32_t sleep_steps; // Slow steps before a body sleeps by itself; 0 = default,
+                       // INT32_MAX leaves falling asleep to the caller
+} PhysicsIntegrateParams;
+
+bool physics_bodies_reserve(PhysicsBodies *bodies, size_t capacity);
+void physics_bodies_cleanup(PhysicsBodies *bodies);
+
+// Kernels work on rows [begin, end) so callers can split them across threads.
+// The SIMD width is chosen at compile time (AVX2 with -mavx2, else SSE2 on
+// x86-64, else scalar); every variant gives the scalar results.
+void physics_bodies_integrate(PhysicsBodies *bodies, size_t begin, size_t end,
+                              const PhysicsIntegrateParams *params);
+void physics_bodies_constrain(PhysicsBodies *bodies, size_t begin, size_t end,
+                              float center_x, float center_y, float radius);
+
+// "avx2", "sse2" or "scalar"
+const char *physics_bodies_simd_name(void);
+
+#endif
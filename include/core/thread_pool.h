@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define THREAD_POOL_MAX_THREADS 64 // Worker threads, not counting the caller
+
+// Task callback: task_index is in [0, task_count), worker_index identifies the
+// executing thread (0 = the thread that called thread_pool_run, 1..N workers)
+// so tasks can use per-thread scratch data without locking.
+typedef void (*ThreadPoolTaskFunc)(void *context, size_t task_index,
+                                   uint32_t worker_index);
+
+struct ThreadPool;
+
+typedef struct {
+  pthread_t thread;
+  struct ThreadPool *pool;
+  uint32_t index; // worker_index passed to tasks (1..thread_count)
+} ThreadPoolWorker;
+
+// Fixed pool of worker threads - supports ZII
+// A zero-initialized (or failed) pool runs every job serially on the caller.
+// Jobs are submitted from one thread at a time (normally the main loop).
+typedef struct ThreadPool {
+  ThreadPoolWorker workers[THREAD_POOL_MAX_THREADS];
+  uint32_t thread_count; // Worker threads actually started
+
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cond; // Signalled when a job is posted or on shutdown
+  pthread_cond_t done_cond; // Signalled when the last busy worker leaves
+
+  // Current job (written under mutex, tasks claimed with an atomic counter)
+  ThreadPoolTaskFunc func;
+  void *context;
+  size_t task_count;
+  size_t next_task;
+  uint64_t job_id;          // Incremented per job so workers join each once
+  uint32_t busy_workers;    // Workers still inside the current job
+  bool job_running;         // Nested thread_pool_run calls execute serially
+  bool shutting_down;
+  bool initialized;
+} ThreadPool;
+
+// thread_count 0 = one worker per online CPU minus the calling thread
+bool thread_pool_init(ThreadPool *pool, uint32_t thread_count);
+void thread_pool_cleanup(ThreadPool *pool);
+
+// Run task_count tasks and block until all have finished. The calling thread
+// executes tasks too. Calls made from inside a task run serially.
+void thread_pool_run(ThreadPool *pool, size_t task_count,
+                     ThreadPoolTaskFunc func, void *context);
+
+// Number of distinct worker_index values tasks may see (workers + caller)
+uint32_t thread_pool_worker_count(const ThreadPool *pool);
+
+// worker_index of the calling thread (0 outside pool workers), for code that
+// isn't handed one, e.g. systems recording deferred ECS commands
+uint32_t thread_pool_current_worker(void);
+
+#endif
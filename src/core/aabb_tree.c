@@ -0,0 +1,309 @@
+#include "aabb_tree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static Aabb aabb_union(Aabb a, Aabb b) {
+  Aabb result;
+  result.min_x = a.min_x < b.min_x ? a.min_x : b.min_x;
+  result.min_y = a.min_y < b.min_y ? a.min_y : b.min_y;
+  result.max_x = a.max_x > b.max_x ? a.max_x : b.max_x;
+  result.max_y = a.max_y > b.max_y ? a.max_y : b.max_y;
+  return result;
+}
+
+// Insertion cost metric (the 2D analogue of surface area)
+static float aabb_perimeter(Aabb a) {
+  return 2.0f * ((a.max_x - a.min_x) + (a.max_y - a.min_y));
+}
+
+static bool aabb_contains(Aabb outer, Aabb inner) {
+  return outer.min_x <= inner.min_x && outer.min_y <= inner.min_y &&
+         inner.max_x <= outer.max_x && inner.max_y <= outer.max_y;
+}
+
+void aabb_tree_init(AabbTree *tree, float margin) {
+  *tree = (AabbTree){0}; // ZII
+  tree->margin = margin;
+}
+
+void aabb_tree_cleanup(AabbTree *tree) {
+  free(tree->nodes);
+  float margin = tree->margin;
+  *tree = (AabbTree){0};
+  tree->margin = margin;
+}
+
+static uint32_t aabb_tree_allocate_node(AabbTree *tree) {
+  if (tree->free_list == AABB_TREE_NULL) {
+    uint32_t capacity = tree->capacity ? tree->capacity * 2 : 64;
+    AabbTreeNode *nodes = (AabbTreeNode *)realloc(
+        tree->nodes, capacity * sizeof(AabbTreeNode));
+    if (!nodes) {
+      fprintf(stderr, "Failed to grow AABB tree (%u nodes)\n", capacity);
+      return AABB_TREE_NULL;
+    }
+    // Node 0 is the null sentinel and never joins the free list
+    uint32_t first = tree->capacity ? tree->capacity : 1;
+    memset(nodes + tree->capacity, 0,
+           (capacity - tree->capacity) * sizeof(AabbTreeNode));
+    for (uint32_t i = first; i < capacity; i++) {
+      nodes[i].height = -1;
+      nodes[i].parent = i + 1 < capacity ? i + 1 : AABB_TREE_NULL;
+    }
+    nodes[0].height = -1;
+    tree->nodes = nodes;
+    tree->free_list = first;
+    tree->capacity = capacity;
+  }
+
+  uint32_t node = tree->free_list;
+  tree->free_list = tree->nodes[node].parent;
+  tree->nodes[node] = (AabbTreeNode){0};
+  return node;
+}
+
+static void aabb_tree_free_node(AabbTree *tree, uint32_t node) {
+  tree->nodes[node].height = -1;
+  tree->nodes[node].parent = tree->free_list;
+  tree->free_list = node;
+}
+
+static void aabb_tree_fit(AabbTree *tree, uint32_t node) {
+  AabbTreeNode *n = &tree->nodes[node];
+  const AabbTreeNode *left = &tree->nodes[n->left];
+  const AabbTreeNode *right = &tree->nodes[n->right];
+  n->box = aabb_union(left->box, right->box);
+  n->height = 1 + (left->height > right->height ? left->height : right->height);
+}
+
+// Rotates the taller grandchild up when a's children differ in height by
+// more than one; returns the node now at a's place
+static uint32_t aabb_tree_balance(AabbTree *tree, uint32_t a) {
+  AabbTreeNode *nodes = tree->nodes;
+  if (nodes[a].height < 2) {
+    return a;
+  }
+
+  uint32_t b = nodes[a].left;
+  uint32_t c = nodes[a].right;
+  int32_t balance = nodes[c].height - nodes[b].height;
+  if (balance >= -1 && balance <= 1) {
+    return a;
+  }
+
+  // The taller child (up) replaces a, and a takes up's shorter child
+  uint32_t up = balance > 1 ? c : b;
+  uint32_t f = nodes[up].left;
+  uint32_t g = nodes[up].right;
+
+  nodes[up].left = a;
+  nodes[up].parent = nodes[a].parent;
+  nodes[a].parent = up;
+  if (nodes[up].parent != AABB_TREE_NULL) {
+    AabbTreeNode *parent = &nodes[nodes[up].parent];
+    if (parent->left == a) {
+      parent->left = up;
+    } else {
+      parent->right = up;
+    }
+  } else {
+    tree->root = up;
+  }
+
+  // up keeps its taller child; the shorter one goes under a
+  uint32_t tall = nodes[f].height > nodes[g].height ? f : g;
+  uint32_t short_ = tall == f ? g : f;
+  nodes[up].right = tall;
+  if (balance > 1) {
+    nodes[a].right = short_;
+  } else {
+    nodes[a].left = short_;
+  }
+  nodes[short_].parent = a;
+  aabb_tree_fit(tree, a);
+  aabb_tree_fit(tree, up);
+  return up;
+}
+
+// Refits and rebalances every ancestor of node, bottom-up
+static void aabb_tree_refit(AabbTree *tree, uint32_t node) {
+  while (node != AABB_TREE_NULL) {
+    node = aabb_tree_balance(tree, node);
+    aabb_tree_fit(tree, node);
+    node = tree->nodes[node].parent;
+  }
+}
+
+// Fails only if the pool can't grow for the new parent node
+static bool aabb_tree_insert_leaf(AabbTree *tree, uint32_t leaf) {
+  AabbTreeNode *nodes = tree->nodes;
+  nodes[leaf].parent = AABB_TREE_NULL;
+  if (tree->root == AABB_TREE_NULL) {
+    tree->root = leaf;
+    return true;
+  }
+
+  // Descend towards the cheapest sibling: the cost of pairing with a node is
+  // the perimeter of the new parent, and every ancestor on the way grows
+  Aabb box = nodes[leaf].box;
+  uint32_t index = tree->root;
+  while (nodes[index].height > 0) {
+    uint32_t left = nodes[index].left;
+    uint32_t right = nodes[index].right;
+    float perimeter = aabb_perimeter(nodes[index].box);
+    float combined = aabb_perimeter(aabb_union(nodes[index].box, box));
+    float cost = 2.0f * combined;                   // New parent here
+    float inherited = 2.0f * (combined - perimeter); // Growth pushed down
+
+    float cost_left = aabb_perimeter(aabb_union(nodes[left].box, box)) + inherited;
+    if (nodes[left].height > 0) {
+      cost_left -= aabb_perimeter(nodes[left].box);
+    }
+    float cost_right = aabb_perimeter(aabb_union(nodes[right].box, box)) + inherited;
+    if (nodes[right].height > 0) {
+      cost_right -= aabb_perimeter(nodes[right].box);
+    }
+
+    if (cost < cost_left && cost < cost_right) {
+      break;
+    }
+    index = cost_left < cost_right ? left : right;
+  }
+
+  uint32_t sibling = index;
+  uint32_t old_parent = nodes[sibling].parent;
+  uint32_t new_parent = aabb_tree_allocate_node(tree);
+  nodes = tree->nodes; // The pool may have moved
+  if (new_parent == AABB_TREE_NULL) {
+    return false;
+  }
+  nodes[new_parent].parent = old_parent;
+  nodes[new_parent].left = sibling;
+  nodes[new_parent].right = leaf;
+  nodes[sibling].parent = new_parent;
+  nodes[leaf].parent = new_parent;
+  if (old_parent != AABB_TREE_NULL) {
+    if (nodes[old_parent].left == sibling) {
+      nodes[old_parent].left = new_parent;
+    } else {
+      nodes[old_parent].right = new_parent;
+    }
+  } else {
+    tree->root = new_parent;
+  }
+  aabb_tree_refit(tree, new_parent);
+  return true;
+}
+
+static void aabb_tree_remove_leaf(AabbTree *tree, uint32_t leaf) {
+  AabbTreeNode *nodes = tree->nodes;
+  if (leaf == tree->root) {
+    tree->root = AABB_TREE_NULL;
+    return;
+  }
+
+  // The sibling takes the parent's place
+  uint32_t parent = nodes[leaf].parent;
+  uint32_t grandparent = nodes[parent].parent;
+  uint32_t sibling =
+      nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+  nodes[sibling].parent = grandparent;
+  if (grandparent != AABB_TREE_NULL) {
+    if (nodes[grandparent].left == parent) {
+      nodes[grandparent].left = sibling;
+    } else {
+      nodes[grandparent].right = sibling;
+    }
+    aabb_tree_refit(tree, grandparent);
+  } else {
+    tree->root = sibling;
+  }
+  aabb_tree_free_node(tree, parent);
+}
+
+static Aabb aabb_tree_fatten(const AabbTree *tree, Aabb box) {
+  box.min_x -= tree->margin;
+  box.min_y -= tree->margin;
+  box.max_x += tree->margin;
+  box.max_y += tree->margin;
+  return box;
+}
+
+uint32_t aabb_tree_insert(AabbTree *tree, Aabb box, uint32_t user) {
+  uint32_t leaf = aabb_tree_allocate_node(tree);
+  if (leaf == AABB_TREE_NULL) {
+    return AABB_TREE_NULL;
+  }
+  tree->nodes[leaf].box = aabb_tree_fatten(tree, box);
+  tree->nodes[leaf].user = user;
+  tree->nodes[leaf].left = AABB_TREE_NULL;
+  tree->nodes[leaf].right = AABB_TREE_NULL;
+  tree->nodes[leaf].height = 0;
+
+  if (!aabb_tree_insert_leaf(tree, leaf)) {
+    aabb_tree_free_node(tree, leaf);
+    return AABB_TREE_NULL;
+  }
+  tree->leaf_count++;
+  return leaf;
+}
+
+bool aabb_tree_is_leaf(const AabbTree *tree, uint32_t proxy) {
+  return proxy != AABB_TREE_NULL && proxy < tree->capacity &&
+         tree->nodes[proxy].height == 0;
+}
+
+void aabb_tree_remove(AabbTree *tree, uint32_t proxy) {
+  if (!aabb_tree_is_leaf(tree, proxy)) {
+    return;
+  }
+  aabb_tree_remove_leaf(tree, proxy);
+  aabb_tree_free_node(tree, proxy);
+  tree->leaf_count--;
+}
+
+bool aabb_tree_move(AabbTree *tree, uint32_t proxy, Aabb box) {
+  if (aabb_contains(tree->nodes[proxy].box, box)) {
+    return false;
+  }
+  // Removing frees a node, so reinserting can always take it back
+  aabb_tree_remove_leaf(tree, proxy);
+  tree->nodes[proxy].box = aabb_tree_fatten(tree, box);
+  aabb_tree_insert_leaf(tree, proxy);
+  return true;
+}
+
+size_t aabb_tree_query(const AabbTree *tree, Aabb box, uint32_t *out_users,
+                       size_t max_users) {
+  if (tree->root == AABB_TREE_NULL) {
+    return 0;
+  }
+
+  uint32_t stack[AABB_TREE_STACK_SIZE];
+  int top = 0;
+  stack[top++] = tree->root;
+  size_t count = 0;
+  while (top > 0) {
+    const AabbTreeNode *node = &tree->nodes[stack[--top]];
+    if (!aabb_overlaps(node->box, box)) {
+      continue;
+    }
+    if (node->height == 0) {
+      if (count < max_users) {
+        out_users[count] = node->user;
+      }
+      count++;
+    } else if (top + 2 <= AABB_TREE_STACK_SIZE) {
+      stack[top++] = node->left;
+      stack[top++] = node->right;
+    } else {
+      fprintf(stderr, "AABB tree query too deep, results truncated\n");
+    }
+  }
+  return count;
+}
+
+int aabb_tree_height(const AabbTree *tree) {
+  return tree->root == AABB_TREE_NULL ? 0 : tree->nodes[tree->root].height;
+}
@@ -3,48 +3,290 @@
 #include <stdlib.h>
 #include <string.h>
 
+static uint32_t archetype_find_or_create(ECS *ecs, ComponentMask mask);
+static void component_array_erase(ComponentArray *array, Entity entity);
+static void group_enter(ECS *ecs, EcsGroup *group, Entity entity);
+static void group_leave(ECS *ecs, EcsGroup *group, Entity entity);
+static EcsGroup *group_owning(ECS *ecs, ComponentType type);
+static bool entity_reserve(ECS *ecs, size_t slot_count);
+
 void ecs_init(ECS *ecs) {
+  ecs_init_with_capacity(ecs, ECS_DEFAULT_ENTITY_CAPACITY);
+}
+
+void ecs_init_with_capacity(ECS *ecs, size_t entity_capacity) {
   // ZII: ecs should already be zero-initialized, don't memset over it
   ecs->next_entity_id = 1;
-  
+  ecs->change_tick = 1; // Tick 0 means "never" in since-filters
+
   // Initialize arena pool for component allocations
   if (!arena_pool_init(&ecs->component_arena_pool)) {
     fprintf(stderr, "Failed to initialize ECS component arena pool\n");
   }
+  arena_pool_set_tag(&ecs->component_arena_pool, MEMORY_TAG_ECS);
+
+  // Capacity is only a hint: storage keeps growing in chunks past it
+  if (entity_capacity > 0) {
+    entity_reserve(ecs, entity_capacity + 1); // Slot 0 is the null entity
+  }
+
+  // Archetype 0 holds entities without components
+  archetype_find_or_create(ecs, 0);
 }
 
 void ecs_cleanup(ECS *ecs) {
   // Component data is allocated in arena pool, so we just clean up the pool
   arena_pool_cleanup(&ecs->component_arena_pool);
+
+  // Pointer tables and index lists grow by realloc, so they live on the heap
+  // (the chunks and pages they point to are in the arena pool)
+  free(ecs->entity_chunks);
+  for (size_t i = 0; i < ecs->component_count; i++) {
+    free(ecs->components[i].pages);
+    free(ecs->components[i].dense);
+    free(ecs->components[i].sparse);
+  }
+  for (size_t i = 0; i < ecs->archetype_count; i++) {
+    free(ecs->archetypes[i].entities);
+  }
+  free(ecs->archetypes);
+  for (size_t i = 0; i < ecs->query_count; i++) {
+    free(ecs->queries[i].archetypes);
+  }
+  for (size_t i = 0; i < ECS_MAX_COMMAND_BUFFERS; i++) {
+    free(ecs->command_buffers[i].commands);
+    free(ecs->command_buffers[i].data);
+    free(ecs->command_buffers[i].created);
+  }
   
   // Reset to ZII state
   memset(ecs, 0, sizeof(ECS));
 }
 
+// Entity slots are addressed by the index bits of a handle
+static EntityInfo *entity_slot(ECS *ecs, uint32_t index) {
+  return &ecs->entity_chunks[index / ECS_ENTITY_CHUNK_SIZE]
+                            [index % ECS_ENTITY_CHUNK_SIZE];
+}
+
+static EntityInfo *entity_info(ECS *ecs, Entity entity) {
+  return entity_slot(ecs, ecs_entity_index(entity));
+}
+
+// Ensure slots [0, slot_count) are backed by chunks. Chunks come from the
+// arena pool and never move; only the small pointer table is reallocated.
+static bool entity_reserve(ECS *ecs, size_t slot_count) {
+  while (ecs->entity_chunk_count * ECS_ENTITY_CHUNK_SIZE < slot_count) {
+    if (ecs->entity_chunk_count >= ecs->entity_chunk_capacity) {
+      size_t new_capacity =
+          ecs->entity_chunk_capacity ? ecs->entity_chunk_capacity * 2 : 8;
+      EntityInfo **grown = (EntityInfo **)realloc(
+          ecs->entity_chunks, new_capacity * sizeof(EntityInfo *));
+      if (!grown) {
+        fprintf(stderr, "Failed to grow entity chunk table\n");
+        return false;
+      }
+      ecs->entity_chunks = grown;
+      ecs->entity_chunk_capacity = new_capacity;
+    }
+
+    size_t chunk_size = ECS_ENTITY_CHUNK_SIZE * sizeof(EntityInfo);
+    EntityInfo *chunk = (EntityInfo *)arena_pool_alloc(
+        &ecs->component_arena_pool, chunk_size);
+    if (!chunk) {
+      fprintf(stderr, "Failed to allocate entity chunk from arena pool\n");
+      return false;
+    }
+    memset(chunk, 0, chunk_size);
+    ecs->entity_chunks[ecs->entity_chunk_count++] = chunk;
+  }
+  return true;
+}
+
+// Archetype bookkeeping
+
+static bool query_add_archetype(EcsQuery *query, uint32_t archetype) {
+  if (query->archetype_count >= query->archetype_capacity) {
+    size_t new_capacity =
+        query->archetype_capacity ? query->archetype_capacity * 2 : 8;
+    uint32_t *grown = (uint32_t *)realloc(query->archetypes,
+                                          new_capacity * sizeof(uint32_t));
+    if (!grown) {
+      fprintf(stderr, "Failed to grow query archetype list\n");
+      return false;
+    }
+    query->archetypes = grown;
+    query->archetype_capacity = new_capacity;
+  }
+
+  query->archetypes[query->archetype_count++] = archetype;
+  return true;
+}
+
+static uint32_t archetype_find_or_create(ECS *ecs, ComponentMask mask) {
+  for (uint32_t i = 0; i < ecs->archetype_count; i++) {
+    if (ecs->archetypes[i].mask == mask) {
+      return i;
+    }
+  }
+
+  if (ecs->archetype_count >= ecs->archetype_capacity) {
+    size_t new_capacity =
+        ecs->archetype_capacity ? ecs->archetype_capacity * 2 : 16;
+    Archetype *grown = (Archetype *)realloc(ecs->archetypes,
+                                            new_capacity * sizeof(Archetype));
+    if (!grown) {
+      fprintf(stderr, "Failed to grow archetype table\n");
+      return 0;
+    }
+    ecs->archetypes = grown;
+    ecs->archetype_capacity = new_capacity;
+  }
+
+  uint32_t index = (uint32_t)ecs->archetype_count++;
+  ecs->archetypes[index] = (Archetype){0};
+  ecs->archetypes[index].mask = mask;
+
+  // Keep cached queries current so iteration never rescans the table
+  for (size_t i = 0; i < ecs->query_count; i++) {
+    EcsQuery *query = &ecs->queries[i];
+    if ((mask & query->mask) == query->mask) {
+      query_add_archetype(query, index);
+    }
+  }
+
+  return index;
+}
+
+static uint32_t archetype_neighbor(ECS *ecs, uint32_t from, ComponentType type,
+                                   bool adding) {
+  uint32_t *edge = adding ? &ecs->archetypes[from].add_edges[type]
+                          : &ecs->archetypes[from].remove_edges[type];
+  if (*edge == 0) {
+    ComponentMask mask = ecs->archetypes[from].mask;
+    mask = adding ? (mask | (1ULL << type)) : (mask & ~(1ULL << type));
+    uint32_t to = archetype_find_or_create(ecs, mask);
+    // Table may have been reallocated by the create above
+    edge = adding ? &ecs->archetypes[from].add_edges[type]
+                  : &ecs->archetypes[from].remove_edges[type];
+    *edge = to + 1;
+  }
+  return *edge - 1;
+}
+
+static bool archetype_insert(ECS *ecs, uint32_t archetype, Entity entity) {
+  Archetype *arch = &ecs->archetypes[archetype];
+  if (arch->count >= arch->capacity) {
+    size_t new_capacity = arch->capacity ? arch->capacity * 2 : 64;
+    Entity *grown =
+        (Entity *)realloc(arch->entities, new_capacity * sizeof(Entity));
+    if (!grown) {
+      fprintf(stderr, "Failed to grow archetype entity list\n");
+      return false;
+    }
+    arch->entities = grown;
+    arch->capacity = new_capacity;
+  }
+
+  EntityInfo *info = entity_info(ecs, entity);
+  info->archetype = archetype;
+  info->archetype_row = (uint32_t)arch->count;
+  arch->entities[arch->count++] = entity;
+  return true;
+}
+
+static void archetype_erase(ECS *ecs, Entity entity) {
+  EntityInfo *info = entity_info(ecs, entity);
+  Archetype *arch = &ecs->archetypes[info->archetype];
+  uint32_t row = info->archetype_row;
+  uint32_t last = (uint32_t)arch->count - 1;
+
+  // Swap-remove, same as component storage
+  if (row != last) {
+    Entity moved = arch->entities[last];
+    arch->entities[row] = moved;
+    entity_info(ecs, moved)->archetype_row = row;
+  }
+  arch->count--;
+}
+
+static void archetype_move(ECS *ecs, Entity entity, uint32_t target) {
+  if (entity_info(ecs, entity)->archetype == target) {
+    return;
+  }
+  archetype_erase(ecs, entity);
+  archetype_insert(ecs, target, entity);
+}
+
 Entity ecs_create_entity(ECS *ecs) {
-  if (ecs->next_entity_id >= MAX_ENTITIES) {
-    fprintf(stderr, "Maximum entities exceeded\n");
-    return 0;
+  uint32_t index;
+  if (ecs->free_count > 0) {
+    // Recycle the most recently freed slot to keep the live range compact
+    index = ecs->free_head;
+    ecs->free_head = entity_slot(ecs, index)->next_free;
+    ecs->free_count--;
+  } else {
+    if (ecs->next_entity_id >= MAX_ENTITIES) {
+      fprintf(stderr, "Maximum entities exceeded\n");
+      return 0;
+    }
+    if (!entity_reserve(ecs, ecs->next_entity_id + 1)) {
+      return 0;
+    }
+    index = ecs->next_entity_id++;
   }
 
-  Entity entity = ecs->next_entity_id++;
-  ecs->entities[entity].mask = 0;
-  ecs->entities[entity].active = true;
+  EntityInfo *info = entity_slot(ecs, index);
+  Entity entity = ecs_entity_make(index, info->generation);
+  info->mask = 0;
+  info->active = true;
+  info->next_free = 0;
+  archetype_insert(ecs, 0, entity);
 
   return entity;
 }
 
 void ecs_destroy_entity(ECS *ecs, Entity entity) {
-  if (entity >= MAX_ENTITIES || !ecs->entities[entity].active) {
+  if (!ecs_entity_active(ecs, entity)) {
     return;
   }
 
-  ecs->entities[entity].active = false;
-  ecs->entities[entity].mask = 0;
+  archetype_erase(ecs, entity);
+
+  // Leave groups first so the swap-removes below keep group prefixes intact
+  EntityInfo *info = entity_info(ecs, entity);
+  for (size_t i = 0; i < ecs->group_count; i++) {
+    EcsGroup *group = &ecs->groups[i];
+    if ((info->mask & group->owned) == group->owned) {
+      group_leave(ecs, group, entity);
+    }
+  }
+
+  // Release component slots so the packed arrays stay dense
+  for (ComponentType type = 0; type < ecs->component_count; type++) {
+    if (info->mask & (1ULL << type)) {
+      component_array_erase(&ecs->components[type], entity);
+    }
+  }
+
+  // Bump the generation so outstanding handles to this slot go stale,
+  // skipping the generation reserved for deferred handles
+  info->active = false;
+  info->mask = 0;
+  info->generation = (info->generation + 1) % ECS_ENTITY_DEFERRED_GENERATION;
+  info->next_free = ecs->free_head;
+  ecs->free_head = ecs_entity_index(entity);
+  ecs->free_count++;
 }
 
 bool ecs_entity_active(ECS *ecs, Entity entity) {
-  return entity < MAX_ENTITIES && ecs->entities[entity].active;
+  uint32_t index = ecs_entity_index(entity);
+  if (index == 0 || index >= ecs->next_entity_id) {
+    return false;
+  }
+
+  const EntityInfo *info = entity_slot(ecs, index);
+  return info->active && info->generation == ecs_entity_generation(entity);
 }
 
 ComponentType ecs_register_component(ECS *ecs, size_t component_size) {
@@ -56,24 +298,176 @@ ComponentType ecs_register_component(ECS *ecs, size_t component_size) {
   ComponentType type = ecs->component_count++;
   ComponentArray *array = &ecs->components[type];
 
+  // ZII: no storage until the first component is added. Data pages, the
+  // dense entity list and sparse index pages all grow on demand, so a
+  // component used by 50 entities costs one data page and one index page.
   array->component_size = component_size;
-  array->capacity = MAX_ENTITIES;
-  
-  // Allocate component array from arena pool
-  // Each component type gets MAX_ENTITIES slots (e.g., Transform: 2048 * 36 bytes = 72KB)
-  size_t total_size = MAX_ENTITIES * component_size;
-  array->data = arena_pool_alloc(&ecs->component_arena_pool, total_size);
   array->count = 0;
+  array->capacity = 0;
 
-  if (!array->data) {
-    fprintf(stderr, "Failed to allocate component array from arena pool\n");
-    return MAX_COMPONENTS;
+  return type;
+}
+
+static void *component_array_slot(ComponentArray *array, size_t index) {
+  return (char *)array->pages[index / ECS_COMPONENT_PAGE_SIZE] +
+         (index % ECS_COMPONENT_PAGE_SIZE) * array->component_size;
+}
+
+// Each page's tick stamps follow its component data in the same allocation,
+// then the page stamp
+static EcsComponentTicks *component_array_ticks(ComponentArray *array,
+                                                size_t index) {
+  EcsComponentTicks *ticks =
+      (EcsComponentTicks *)((char *)array->pages[index / ECS_COMPONENT_PAGE_SIZE] +
+                            ECS_COMPONENT_PAGE_SIZE * array->component_size);
+  return &ticks[index % ECS_COMPONENT_PAGE_SIZE];
+}
+
+static uint32_t *component_array_page_tick(ComponentArray *array, size_t index) {
+  return (uint32_t *)((char *)array->pages[index / ECS_COMPONENT_PAGE_SIZE] +
+                      ECS_COMPONENT_PAGE_SIZE *
+                          (array->component_size + sizeof(EcsComponentTicks)));
+}
+
+// Raises the page stamp to the slot's `changed`, after a write or after a
+// component moved in from another slot
+static void component_array_touch(ComponentArray *array, size_t index) {
+  uint32_t changed = component_array_ticks(array, index)->changed;
+  uint32_t *page_tick = component_array_page_tick(array, index);
+  if (*page_tick < changed) {
+    *page_tick = changed;
   }
-  
-  // Zero-initialize the component array
-  memset(array->data, 0, total_size);
+}
 
-  return type;
+// Ensure dense slots [0, count) are backed by pages
+static bool component_array_reserve(ECS *ecs, ComponentArray *array,
+                                    size_t count) {
+  while (array->capacity < count) {
+    size_t page = array->capacity / ECS_COMPONENT_PAGE_SIZE;
+    size_t new_capacity = array->capacity + ECS_COMPONENT_PAGE_SIZE;
+
+    // Page table and dense entity list are only touched through the ECS, so
+    // they may move; the data pages themselves never do
+    void **pages = (void **)realloc(array->pages, (page + 1) * sizeof(void *));
+    if (!pages) {
+      fprintf(stderr, "Failed to grow component page table\n");
+      return false;
+    }
+    array->pages = pages;
+
+    Entity *dense =
+        (Entity *)realloc(array->dense, new_capacity * sizeof(Entity));
+    if (!dense) {
+      fprintf(stderr, "Failed to grow component entity list\n");
+      return false;
+    }
+    array->dense = dense;
+
+    array->pages[page] = arena_pool_alloc(
+        &ecs->component_arena_pool,
+        ECS_COMPONENT_PAGE_SIZE *
+                (array->component_size + sizeof(EcsComponentTicks)) +
+            sizeof(uint32_t));
+    if (!array->pages[page]) {
+      fprintf(stderr, "Failed to allocate component page from arena pool\n");
+      return false;
+    }
+    *component_array_page_tick(array, array->capacity) = 0;
+
+    array->capacity = new_capacity;
+  }
+  return true;
+}
+
+static uint32_t sparse_get(const ComponentArray *array, uint32_t slot) {
+  size_t page = slot / ECS_SPARSE_PAGE_SIZE;
+  if (page >= array->sparse_page_count || !array->sparse[page]) {
+    return 0;
+  }
+  return array->sparse[page][slot % ECS_SPARSE_PAGE_SIZE];
+}
+
+// Caller guarantees the page exists (via sparse_ensure or a live component)
+static void sparse_set(ComponentArray *array, uint32_t slot, uint32_t value) {
+  array->sparse[slot / ECS_SPARSE_PAGE_SIZE][slot % ECS_SPARSE_PAGE_SIZE] =
+      value;
+}
+
+static bool sparse_ensure(ECS *ecs, ComponentArray *array, uint32_t slot) {
+  size_t page = slot / ECS_SPARSE_PAGE_SIZE;
+  if (page >= array->sparse_page_count) {
+    size_t new_count = array->sparse_page_count ? array->sparse_page_count : 1;
+    while (new_count <= page) {
+      new_count *= 2;
+    }
+    uint32_t **grown =
+        (uint32_t **)realloc(array->sparse, new_count * sizeof(uint32_t *));
+    if (!grown) {
+      fprintf(stderr, "Failed to grow sparse page table\n");
+      return false;
+    }
+    memset(grown + array->sparse_page_count, 0,
+           (new_count - array->sparse_page_count) * sizeof(uint32_t *));
+    array->sparse = grown;
+    array->sparse_page_count = new_count;
+  }
+
+  if (!array->sparse[page]) {
+    size_t page_size = ECS_SPARSE_PAGE_SIZE * sizeof(uint32_t);
+    array->sparse[page] =
+        (uint32_t *)arena_pool_alloc(&ecs->component_arena_pool, page_size);
+    if (!array->sparse[page]) {
+      fprintf(stderr, "Failed to allocate sparse page from arena pool\n");
+      return false;
+    }
+    memset(array->sparse[page], 0, page_size); // 0 = no component
+  }
+  return true;
+}
+
+bool ecs_reserve_components(ECS *ecs, ComponentType type, size_t capacity) {
+  if (type >= ecs->component_count) {
+    return false;
+  }
+  return component_array_reserve(ecs, &ecs->components[type], capacity);
+}
+
+// Append a zeroed component and set the mask bit; the caller updates the
+// archetype and groups (so batched adds can do that once)
+static bool component_insert(ECS *ecs, Entity entity, ComponentType type) {
+  ComponentArray *array = &ecs->components[type];
+  uint32_t slot = ecs_entity_index(entity);
+  size_t index = array->count;
+  if (!component_array_reserve(ecs, array, index + 1) ||
+      !sparse_ensure(ecs, array, slot)) {
+    return false;
+  }
+
+  array->dense[index] = entity;
+  sparse_set(array, slot, (uint32_t)index + 1);
+  array->count++;
+
+  // ZII: every new component starts zeroed, even in a recycled slot
+  memset(component_array_slot(array, index), 0, array->component_size);
+  EcsComponentTicks *ticks = component_array_ticks(array, index);
+  ticks->added = ecs->change_tick;
+  ticks->changed = ecs->change_tick;
+  component_array_touch(array, index);
+  entity_info(ecs, entity)->mask |= (1ULL << type);
+  return true;
+}
+
+// Enter every group that the mask change from old_mask completed
+static void groups_enter_completed(ECS *ecs, Entity entity,
+                                   ComponentMask old_mask) {
+  ComponentMask mask = entity_info(ecs, entity)->mask;
+  for (size_t i = 0; i < ecs->group_count; i++) {
+    EcsGroup *group = &ecs->groups[i];
+    if ((mask & group->owned) == group->owned &&
+        (old_mask & group->owned) != group->owned) {
+      group_enter(ecs, group, entity);
+    }
+  }
 }
 
 void *ecs_add_component(ECS *ecs, Entity entity, ComponentType type) {
@@ -81,10 +475,25 @@ void *ecs_add_component(ECS *ecs, Entity entity, ComponentType type) {
     return NULL;
   }
 
-  ecs->entities[entity].mask |= (1ULL << type);
-
   ComponentArray *array = &ecs->components[type];
-  return (char *)array->data + (entity * array->component_size);
+  uint32_t slot = ecs_entity_index(entity);
+  uint32_t existing = sparse_get(array, slot);
+  if (existing != 0) {
+    // Already present: return the existing data untouched
+    return component_array_slot(array, existing - 1);
+  }
+
+  EntityInfo *info = entity_info(ecs, entity);
+  ComponentMask old_mask = info->mask;
+  if (!component_insert(ecs, entity, type)) {
+    return NULL;
+  }
+  archetype_move(ecs, entity,
+                 archetype_neighbor(ecs, info->archetype, type, true));
+
+  // Completing a group's component set moves the entity into its prefix
+  groups_enter_completed(ecs, entity, old_mask);
+  return component_array_slot(array, sparse_get(array, slot) - 1);
 }
 
 void *ecs_get_component(ECS *ecs, Entity entity, ComponentType type) {
@@ -93,15 +502,130 @@ void *ecs_get_component(ECS *ecs, Entity entity, ComponentType type) {
   }
 
   ComponentArray *array = &ecs->components[type];
-  return (char *)array->data + (entity * array->component_size);
+  return component_array_slot(
+      array, sparse_get(array, ecs_entity_index(entity)) - 1);
+}
+
+void *ecs_get_component_mut(ECS *ecs, Entity entity, ComponentType type) {
+  if (!ecs_has_component(ecs, entity, type)) {
+    return NULL;
+  }
+
+  ComponentArray *array = &ecs->components[type];
+  size_t index = sparse_get(array, ecs_entity_index(entity)) - 1;
+  component_array_ticks(array, index)->changed = ecs->change_tick;
+  component_array_touch(array, index);
+  return component_array_slot(array, index);
+}
+
+void ecs_mark_changed(ECS *ecs, Entity entity, ComponentType type) {
+  ecs_get_component_mut(ecs, entity, type);
+}
+
+uint32_t ecs_change_tick(const ECS *ecs) { return ecs->change_tick; }
+
+void ecs_advance_tick(ECS *ecs) { ecs->change_tick++; }
+
+static void component_array_erase(ComponentArray *array, Entity entity) {
+  size_t index = sparse_get(array, ecs_entity_index(entity)) - 1;
+  size_t last = array->count - 1;
+
+  // Swap-remove: move the last component into the hole to stay packed
+  if (index != last) {
+    Entity moved = array->dense[last];
+    memcpy(component_array_slot(array, index),
+           component_array_slot(array, last), array->component_size);
+    *component_array_ticks(array, index) = *component_array_ticks(array, last);
+    component_array_touch(array, index);
+    array->dense[index] = moved;
+    sparse_set(array, ecs_entity_index(moved), (uint32_t)index + 1);
+  }
+
+  sparse_set(array, ecs_entity_index(entity), 0);
+  array->count--;
+}
+
+// Exchange two dense slots (data, owner and sparse entries)
+static void component_array_swap(ComponentArray *array, size_t a, size_t b) {
+  if (a == b) {
+    return;
+  }
+
+  unsigned char *data_a = (unsigned char *)component_array_slot(array, a);
+  unsigned char *data_b = (unsigned char *)component_array_slot(array, b);
+  for (size_t i = 0; i < array->component_size; i++) {
+    unsigned char byte = data_a[i];
+    data_a[i] = data_b[i];
+    data_b[i] = byte;
+  }
+  EcsComponentTicks *ticks_a = component_array_ticks(array, a);
+  EcsComponentTicks *ticks_b = component_array_ticks(array, b);
+  EcsComponentTicks ticks = *ticks_a;
+  *ticks_a = *ticks_b;
+  *ticks_b = ticks;
+  component_array_touch(array, a);
+  component_array_touch(array, b);
+
+  Entity entity_a = array->dense[a];
+  Entity entity_b = array->dense[b];
+  array->dense[a] = entity_b;
+  array->dense[b] = entity_a;
+  sparse_set(array, ecs_entity_index(entity_b), (uint32_t)a + 1);
+  sparse_set(array, ecs_entity_index(entity_a), (uint32_t)b + 1);
+}
+
+// Owning groups
+
+static EcsGroup *group_owning(ECS *ecs, ComponentType type) {
+  for (size_t i = 0; i < ecs->group_count; i++) {
+    if (ecs->groups[i].owned & (1ULL << type)) {
+      return &ecs->groups[i];
+    }
+  }
+  return NULL;
+}
+
+// Entity must have every owned component and sit outside the prefix
+static void group_enter(ECS *ecs, EcsGroup *group, Entity entity) {
+  uint32_t slot = ecs_entity_index(entity);
+  for (ComponentType type = 0; type < ecs->component_count; type++) {
+    if (group->owned & (1ULL << type)) {
+      ComponentArray *array = &ecs->components[type];
+      component_array_swap(array, sparse_get(array, slot) - 1, group->count);
+    }
+  }
+  group->count++;
+  group->version++;
+}
+
+// Entity must currently be inside the prefix
+static void group_leave(ECS *ecs, EcsGroup *group, Entity entity) {
+  uint32_t slot = ecs_entity_index(entity);
+  group->count--;
+  group->version++;
+  for (ComponentType type = 0; type < ecs->component_count; type++) {
+    if (group->owned & (1ULL << type)) {
+      ComponentArray *array = &ecs->components[type];
+      component_array_swap(array, sparse_get(array, slot) - 1, group->count);
+    }
+  }
 }
 
 void ecs_remove_component(ECS *ecs, Entity entity, ComponentType type) {
-  if (!ecs_entity_active(ecs, entity) || type >= ecs->component_count) {
+  if (!ecs_has_component(ecs, entity, type)) {
     return;
   }
 
-  ecs->entities[entity].mask &= ~(1ULL << type);
+  EntityInfo *info = entity_info(ecs, entity);
+  EcsGroup *group = group_owning(ecs, type);
+  if (group && (info->mask & group->owned) == group->owned) {
+    group_leave(ecs, group, entity);
+  }
+
+  component_array_erase(&ecs->components[type], entity);
+  info->mask &= ~(1ULL << type);
+  archetype_move(ecs, entity,
+                 archetype_neighbor(ecs, info->archetype, type, false));
 }
 
 bool ecs_has_component(ECS *ecs, Entity entity, ComponentType type) {
@@ -109,20 +633,92 @@ bool ecs_has_component(ECS *ecs, Entity entity, ComponentType type) {
     return false;
   }
 
-  return (ecs->entities[entity].mask & (1ULL << type)) != 0;
+  return (entity_info(ecs, entity)->mask & (1ULL << type)) != 0;
 }
 
-void ecs_register_system(ECS *ecs, SystemFunc system_func,
-                         ComponentMask required_components) {
+size_t ecs_component_count(ECS *ecs, ComponentType type) {
+  if (type >= ecs->component_count) {
+    return 0;
+  }
+  return ecs->components[type].count;
+}
+
+void *ecs_component_at(ECS *ecs, ComponentType type, size_t index) {
+  if (type >= ecs->component_count || index >= ecs->components[type].count) {
+    return NULL;
+  }
+  return component_array_slot(&ecs->components[type], index);
+}
+
+Entity ecs_component_entity_at(ECS *ecs, ComponentType type, size_t index) {
+  if (type >= ecs->component_count || index >= ecs->components[type].count) {
+    return 0;
+  }
+  return ecs->components[type].dense[index];
+}
+
+static System *system_add(ECS *ecs, SystemFunc system_func) {
   if (ecs->system_count >= MAX_SYSTEMS) {
     fprintf(stderr, "Maximum systems exceeded\n");
-    return;
+    return NULL;
   }
 
   System *system = &ecs->systems[ecs->system_count++];
+  *system = (System){0};
   system->update = system_func;
-  system->required_components = required_components;
   system->active = true;
+  return system;
+}
+
+void ecs_register_system(ECS *ecs, SystemFunc system_func,
+                         ComponentMask required_components) {
+  System *system = system_add(ecs, system_func);
+  if (!system) {
+    return;
+  }
+
+  // No declared access: may touch anything (or GL state), so never overlap
+  system->required_components = required_components;
+  system->exclusive = true;
+}
+
+void ecs_register_system_with_access(ECS *ecs, SystemFunc system_func,
+                                     ComponentMask read_components,
+                                     ComponentMask write_components) {
+  System *system = system_add(ecs, system_func);
+  if (!system) {
+    return;
+  }
+
+  system->required_components = read_components | write_components;
+  system->read_components = read_components;
+  system->write_components = write_components;
+}
+
+void ecs_set_thread_pool(ECS *ecs, ThreadPool *pool) {
+  ecs->thread_pool = pool;
+}
+
+static bool systems_conflict(const System *a, const System *b) {
+  if (a->exclusive || b->exclusive) {
+    return true;
+  }
+  return (a->write_components &
+          (b->read_components | b->write_components)) != 0 ||
+         (b->write_components & a->read_components) != 0;
+}
+
+typedef struct {
+  System *systems[MAX_SYSTEMS];
+  size_t count;
+  float delta_time;
+} SystemBatch;
+
+static void system_batch_task(void *context, size_t task_index,
+                              uint32_t worker_index) {
+  (void)worker_index;
+  SystemBatch *batch = (SystemBatch *)context;
+  batch->systems[task_index]->update(batch->delta_time);
 }
 
 void ecs_update_systems(ECS *ecs, float delta_time) {
@@ -131,33 +727,168 @@ void ecs_update_systems(ECS *ecs, float delta_time) {
     printf("ecs_update_systems: Running %zu systems\n", ecs->system_count);
   }
 
-  for (uint32_t i = 0; i < ecs->system_count; i++) {
-    System *system = &ecs->systems[i];
-    if (system->active && system->update) {
-      // if (debug_frame % 120 == 0) {
-      //   printf("  Calling system %d (mask: %llu)\n", i,
-      //   system->required_components);
-      // }
-      system->update(delta_time);
+  // Dependency graph: each system depends on every earlier active system it
+  // conflicts with, so its level is one past the deepest such system.
+  // Systems sharing a level never conflict and may run concurrently, while
+  // conflicting systems keep their registration order.
+  uint32_t level[MAX_SYSTEMS] = {0};
+  uint32_t level_count = 0;
+  for (uint32_t j = 0; j < ecs->system_count; j++) {
+    System *system = &ecs->systems[j];
+    if (!system->active || !system->update) {
+      continue;
+    }
+    for (uint32_t i = 0; i < j; i++) {
+      System *earlier = &ecs->systems[i];
+      if (earlier->active && earlier->update &&
+          systems_conflict(earlier, system) && level[i] + 1 > level[j]) {
+        level[j] = level[i] + 1;
+      }
+    }
+    if (level[j] + 1 > level_count) {
+      level_count = level[j] + 1;
+    }
+  }
+
+  for (uint32_t l = 0; l < level_count; l++) {
+    SystemBatch batch = {0}; // ZII
+    batch.delta_time = delta_time;
+    for (uint32_t i = 0; i < ecs->system_count; i++) {
+      System *system = &ecs->systems[i];
+      if (system->active && system->update && level[i] == l) {
+        batch.systems[batch.count++] = system;
+      }
+    }
+
+    // Exclusive systems always form a batch of one and run on this thread
+    if (batch.count == 1) {
+      batch.systems[0]->update(delta_time);
+    } else {
+      thread_pool_run(ecs->thread_pool, batch.count, system_batch_task,
+                      &batch);
     }
+
+    // Sync point: the next batch sees this batch's structural changes, and
+    // its writes get a later tick than anything this batch observed
+    ecs_flush_commands(ecs);
+    ecs_advance_tick(ecs);
   }
   debug_frame++;
 }
 
+EcsQuery *ecs_query(ECS *ecs, ComponentMask component_mask) {
+  for (size_t i = 0; i < ecs->query_count; i++) {
+    if (ecs->queries[i].mask == component_mask) {
+      return &ecs->queries[i];
+    }
+  }
+
+  if (ecs->query_count >= ECS_MAX_QUERIES) {
+    fprintf(stderr, "Maximum queries exceeded\n");
+    return NULL;
+  }
+
+  EcsQuery *query = &ecs->queries[ecs->query_count++];
+  *query = (EcsQuery){0};
+  query->mask = component_mask;
+
+  // Later archetypes are added by archetype_find_or_create
+  for (uint32_t i = 0; i < ecs->archetype_count; i++) {
+    if ((ecs->archetypes[i].mask & component_mask) == component_mask) {
+      query_add_archetype(query, i);
+    }
+  }
+
+  return query;
+}
+
+EcsQueryIter ecs_query_iter(ECS *ecs, ComponentMask component_mask) {
+  EcsQueryIter iter = {0}; // ZII
+  iter.ecs = ecs;
+  iter.query = ecs_query(ecs, component_mask);
+  return iter;
+}
+
+static EcsQueryIter query_iter_filtered(ECS *ecs, ComponentMask component_mask,
+                                        EcsQueryFilter filter,
+                                        ComponentType type, uint32_t since) {
+  // The filtered component must be part of the match
+  EcsQueryIter iter = ecs_query_iter(ecs, component_mask | (1ULL << type));
+  iter.filter = filter;
+  iter.filter_type = type;
+  iter.filter_since = since;
+  return iter;
+}
+
+EcsQueryIter ecs_query_iter_changed(ECS *ecs, ComponentMask component_mask,
+                                    ComponentType type, uint32_t since) {
+  return query_iter_filtered(ecs, component_mask, ECS_QUERY_FILTER_CHANGED,
+                             type, since);
+}
+
+EcsQueryIter ecs_query_iter_added(ECS *ecs, ComponentMask component_mask,
+                                  ComponentType type, uint32_t since) {
+  return query_iter_filtered(ecs, component_mask, ECS_QUERY_FILTER_ADDED, type,
+                             since);
+}
+
+static bool query_filter_pass(const EcsQueryIter *iter, Entity entity) {
+  if (iter->filter == ECS_QUERY_FILTER_NONE) {
+    return true;
+  }
+
+  ComponentArray *array = &iter->ecs->components[iter->filter_type];
+  const EcsComponentTicks *ticks = component_array_ticks(
+      array, sparse_get(array, ecs_entity_index(entity)) - 1);
+  uint32_t tick =
+      iter->filter == ECS_QUERY_FILTER_ADDED ? ticks->added : ticks->changed;
+  return tick >= iter->filter_since;
+}
+
+bool ecs_query_next(EcsQueryIter *iter, Entity *out_entity) {
+  if (!iter->query) {
+    return false;
+  }
+
+  while (iter->archetype_index < iter->query->archetype_count) {
+    const Archetype *arch =
+        &iter->ecs->archetypes[iter->query->archetypes[iter->archetype_index]];
+    while (iter->row < arch->count) {
+      Entity entity = arch->entities[iter->row++];
+      if (query_filter_pass(iter, entity)) {
+        *out_entity = entity;
+        return true;
+      }
+    }
+    iter->archetype_index++;
+    iter->row = 0;
+  }
+
+  return false;
+}
+
+size_t ecs_query_count(ECS *ecs, ComponentMask component_mask) {
+  EcsQuery *query = ecs_query(ecs, component_mask);
+  if (!query) {
+    return 0;
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i < query->archetype_count; i++) {
+    count += ecs->archetypes[query->archetypes[i]].count;
+  }
+  return count;
+}
+
 void ecs_iterate_entities(ECS *ecs, ComponentMask component_mask, EntityIteratorFunc func, void *user_data) {
   if (!func) {
     return;
   }
   
-  for (Entity entity = 1; entity < ecs->next_entity_id; entity++) {
-    if (!ecs_entity_active(ecs, entity)) {
-      continue;
-    }
-    
-    // Check if entity has all required components
-    if ((ecs->entities[entity].mask & component_mask) == component_mask) {
-      func(ecs, entity, user_data);
-    }
+  EcsQueryIter iter = ecs_query_iter(ecs, component_mask);
+  Entity entity;
+  while (ecs_query_next(&iter, &entity)) {
+    func(ecs, entity, user_data);
   }
 }
 
@@ -167,16 +898,318 @@ size_t ecs_get_entities_with_components(ECS *ecs, ComponentMask component_mask,
   }
   
   size_t count = 0;
-  for (Entity entity = 1; entity < ecs->next_entity_id && count < max_entities; entity++) {
-    if (!ecs_entity_active(ecs, entity)) {
+  EcsQueryIter iter = ecs_query_iter(ecs, component_mask);
+  Entity entity;
+  while (count < max_entities && ecs_query_next(&iter, &entity)) {
+    out_entities[count++] = entity;
+  }
+  
+  return count;
+}
+
+EcsGroup *ecs_group(ECS *ecs, ComponentMask owned) {
+  if (owned == 0) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < ecs->group_count; i++) {
+    EcsGroup *group = &ecs->groups[i];
+    if (group->owned == owned) {
+      return group;
+    }
+    if (group->owned & owned) {
+      // Two groups can't both decide the order of one component array
+      fprintf(stderr, "Group components already owned by another group\n");
+      return NULL;
+    }
+  }
+
+  if (ecs->group_count >= ECS_MAX_GROUPS) {
+    fprintf(stderr, "Maximum groups exceeded\n");
+    return NULL;
+  }
+
+  EcsGroup *group = &ecs->groups[ecs->group_count++];
+  *group = (EcsGroup){0};
+  group->owned = owned;
+
+  // Pack entities that already qualify; later ones join in ecs_add_component
+  EcsQueryIter iter = ecs_query_iter(ecs, owned);
+  Entity entity;
+  while (ecs_query_next(&iter, &entity)) {
+    group_enter(ecs, group, entity);
+  }
+
+  return group;
+}
+
+size_t ecs_group_chunk_count(const EcsGroup *group) {
+  if (!group) {
+    return 0;
+  }
+  return (group->count + ECS_COMPONENT_PAGE_SIZE - 1) / ECS_COMPONENT_PAGE_SIZE;
+}
+
+bool ecs_group_chunk(ECS *ecs, const EcsGroup *group, size_t index,
+                     EcsChunk *out_chunk) {
+  if (index >= ecs_group_chunk_count(group)) {
+    return false;
+  }
+
+  // Owned arrays share one order, so a dense page range is the same entities
+  // in every array and never straddles a page boundary
+  size_t start = index * ECS_COMPONENT_PAGE_SIZE;
+  size_t remaining = group->count - start;
+
+  *out_chunk = (EcsChunk){0}; // ZII
+  out_chunk->index = index;
+  out_chunk->tick = ecs->change_tick;
+  out_chunk->count = remaining < ECS_COMPONENT_PAGE_SIZE
+                         ? remaining
+                         : ECS_COMPONENT_PAGE_SIZE;
+  for (ComponentType type = 0; type < ecs->component_count; type++) {
+    if (group->owned & (1ULL << type)) {
+      ComponentArray *array = &ecs->components[type];
+      out_chunk->components[type] = component_array_slot(array, start);
+      out_chunk->ticks[type] = component_array_ticks(array, start);
+      out_chunk->chunk_changed[type] = component_array_page_tick(array, start);
+      out_chunk->entities = array->dense + start;
+    }
+  }
+  return true;
+}
+
+typedef struct {
+  ECS *ecs;
+  const EcsGroup *group;
+  EcsChunkFunc func;
+  void *user_data;
+  char *chunk_contexts;
+  size_t context_size;
+} GroupJob;
+
+static void group_chunk_task(void *context, size_t task_index,
+                             uint32_t worker_index) {
+  GroupJob *job = (GroupJob *)context;
+  EcsChunk chunk;
+  if (!ecs_group_chunk(job->ecs, job->group, task_index, &chunk)) {
+    return;
+  }
+  chunk.worker_index = worker_index;
+
+  void *chunk_context = job->chunk_contexts
+                            ? job->chunk_contexts + task_index * job->context_size
+                            : NULL;
+  job->func(&chunk, job->user_data, chunk_context);
+}
+
+void ecs_group_parallel_for(ECS *ecs, const EcsGroup *group, EcsChunkFunc func,
+                            void *user_data, void *chunk_contexts,
+                            size_t context_size) {
+  if (!group || !func) {
+    return;
+  }
+
+  GroupJob job = {0}; // ZII
+  job.ecs = ecs;
+  job.group = group;
+  job.func = func;
+  job.user_data = user_data;
+  job.chunk_contexts = (char *)chunk_contexts;
+  job.context_size = context_size;
+  thread_pool_run(ecs->thread_pool, ecs_group_chunk_count(group),
+                  group_chunk_task, &job);
+}
+
+// Deferred commands
+
+static EcsCommandBuffer *command_buffer_current(ECS *ecs) {
+  uint32_t worker = thread_pool_current_worker();
+  if (worker >= ECS_MAX_COMMAND_BUFFERS) {
+    worker = 0;
+  }
+  return &ecs->command_buffers[worker];
+}
+
+static EcsCommand *command_push(EcsCommandBuffer *buffer, EcsCommandType type,
+                                Entity entity, ComponentType component) {
+  if (buffer->count >= buffer->capacity) {
+    size_t new_capacity = buffer->capacity ? buffer->capacity * 2 : 64;
+    EcsCommand *grown = (EcsCommand *)realloc(
+        buffer->commands, new_capacity * sizeof(EcsCommand));
+    if (!grown) {
+      fprintf(stderr, "Failed to grow ECS command buffer\n");
+      return NULL;
+    }
+    buffer->commands = grown;
+    buffer->capacity = new_capacity;
+  }
+
+  EcsCommand *command = &buffer->commands[buffer->count++];
+  *command = (EcsCommand){0}; // ZII
+  command->type = type;
+  command->entity = entity;
+  command->component = component;
+  return command;
+}
+
+Entity ecs_defer_create_entity(ECS *ecs) {
+  EcsCommandBuffer *buffer = command_buffer_current(ecs);
+  if (buffer->created_count > ECS_ENTITY_INDEX_MASK) {
+    fprintf(stderr, "Maximum deferred entities exceeded\n");
+    return 0;
+  }
+
+  Entity entity = ecs_entity_make((uint32_t)buffer->created_count,
+                                  ECS_ENTITY_DEFERRED_GENERATION);
+  if (!command_push(buffer, ECS_COMMAND_CREATE, entity, 0)) {
+    return 0;
+  }
+  buffer->created_count++;
+  return entity;
+}
+
+void ecs_defer_destroy_entity(ECS *ecs, Entity entity) {
+  command_push(command_buffer_current(ecs), ECS_COMMAND_DESTROY, entity, 0);
+}
+
+void *ecs_defer_add_component(ECS *ecs, Entity entity, ComponentType type) {
+  if (type >= ecs->component_count) {
+    return NULL;
+  }
+
+  // Keep staged values aligned like a malloc'd block
+  EcsCommandBuffer *buffer = command_buffer_current(ecs);
+  size_t size = ecs->components[type].component_size;
+  size_t offset = (buffer->data_size + 15) & ~(size_t)15;
+  if (offset + size > buffer->data_capacity) {
+    size_t new_capacity = buffer->data_capacity ? buffer->data_capacity : 1024;
+    while (new_capacity < offset + size) {
+      new_capacity *= 2;
+    }
+    unsigned char *grown = (unsigned char *)realloc(buffer->data, new_capacity);
+    if (!grown) {
+      fprintf(stderr, "Failed to grow ECS command data\n");
+      return NULL;
+    }
+    buffer->data = grown;
+    buffer->data_capacity = new_capacity;
+  }
+
+  EcsCommand *command = command_push(buffer, ECS_COMMAND_ADD, entity, type);
+  if (!command) {
+    return NULL;
+  }
+  command->data_offset = offset;
+  buffer->data_size = offset + size;
+
+  void *staged = buffer->data + offset;
+  memset(staged, 0, size); // ZII, like ecs_add_component
+  return staged;
+}
+
+void ecs_defer_remove_component(ECS *ecs, Entity entity, ComponentType type) {
+  command_push(command_buffer_current(ecs), ECS_COMMAND_REMOVE, entity, type);
+}
+
+static Entity command_resolve(const EcsCommandBuffer *buffer, Entity entity) {
+  if (!ecs_entity_deferred(entity)) {
+    return entity;
+  }
+  uint32_t ordinal = ecs_entity_index(entity);
+  return ordinal < buffer->created_count ? buffer->created[ordinal] : 0;
+}
+
+// Replay a run of ADD commands for one entity with a single archetype move
+static void command_replay_adds(ECS *ecs, EcsCommandBuffer *buffer,
+                                Entity entity, const EcsCommand *commands,
+                                size_t count) {
+  if (!ecs_entity_active(ecs, entity)) {
+    return;
+  }
+
+  EntityInfo *info = entity_info(ecs, entity);
+  ComponentMask old_mask = info->mask;
+  for (size_t i = 0; i < count; i++) {
+    ComponentType type = commands[i].component;
+    if (!(info->mask & (1ULL << type)) && !component_insert(ecs, entity, type)) {
+      count = i; // Out of memory: keep what was added consistent
+      break;
+    }
+  }
+
+  if (info->mask != old_mask) {
+    uint32_t target = info->mask == (old_mask | (1ULL << commands[0].component))
+                          ? archetype_neighbor(ecs, info->archetype,
+                                               commands[0].component, true)
+                          : archetype_find_or_create(ecs, info->mask);
+    archetype_move(ecs, entity, target);
+    groups_enter_completed(ecs, entity, old_mask);
+  }
+
+  // Copy values last: entering groups may have moved the new slots
+  for (size_t i = 0; i < count; i++) {
+    ComponentType type = commands[i].component;
+    memcpy(ecs_get_component_mut(ecs, entity, type),
+           buffer->data + commands[i].data_offset,
+           ecs->components[type].component_size);
+  }
+}
+
+void ecs_flush_commands(ECS *ecs) {
+  for (size_t b = 0; b < ECS_MAX_COMMAND_BUFFERS; b++) {
+    EcsCommandBuffer *buffer = &ecs->command_buffers[b];
+    if (buffer->count == 0) {
       continue;
     }
-    
-    // Check if entity has all required components
-    if ((ecs->entities[entity].mask & component_mask) == component_mask) {
-      out_entities[count++] = entity;
+
+    if (buffer->created_count > buffer->created_capacity) {
+      Entity *grown = (Entity *)realloc(buffer->created,
+                                        buffer->created_count * sizeof(Entity));
+      if (!grown) {
+        fprintf(stderr, "Failed to grow deferred entity table\n");
+        buffer->count = buffer->data_size = buffer->created_count = 0;
+        continue;
+      }
+      buffer->created = grown;
+      buffer->created_capacity = buffer->created_count;
     }
+
+    size_t i = 0;
+    while (i < buffer->count) {
+      const EcsCommand *command = &buffer->commands[i];
+      Entity entity = command_resolve(buffer, command->entity);
+      switch (command->type) {
+      case ECS_COMMAND_CREATE:
+        buffer->created[ecs_entity_index(command->entity)] =
+            ecs_create_entity(ecs);
+        i++;
+        break;
+      case ECS_COMMAND_DESTROY:
+        ecs_destroy_entity(ecs, entity);
+        i++;
+        break;
+      case ECS_COMMAND_REMOVE:
+        ecs_remove_component(ecs, entity, command->component);
+        i++;
+        break;
+      case ECS_COMMAND_ADD: {
+        size_t run = 1;
+        while (i + run < buffer->count &&
+               buffer->commands[i + run].type == ECS_COMMAND_ADD &&
+               buffer->commands[i + run].entity == command->entity) {
+          run++;
+        }
+        command_replay_adds(ecs, buffer, entity, command, run);
+        i += run;
+        break;
+      }
+      }
+    }
+
+    // Keep capacity for the next frame
+    buffer->count = 0;
+    buffer->data_size = 0;
+    buffer->created_count = 0;
   }
-  
-  return count;
 }
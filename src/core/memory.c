@@ -1,18 +1,151 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, madvise
 #include "memory.h"
+#include "thread_pool.h"
 #include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// The call-site macros are for callers; these are the functions themselves
+#undef arena_alloc
+#undef arena_alloc_aligned
+#undef arena_pool_alloc
+#undef object_pool_alloc
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define ARENA_HAS_MMAP 1
+#endif
+
+// Chunk header and its block (allocations align by address, so the
+// block needs no particular alignment)
+struct ArenaChunk {
+  ArenaChunk *next;
+  size_t size;
+  char data[];
+};
+
 // Helper function to align a size to the given alignment
 static size_t align_size(size_t size, size_t alignment) {
   return (size + alignment - 1) & ~(alignment - 1);
 }
 
+static void atomic_max(size_t *target, size_t value) {
+  size_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+  while (value > current &&
+         !__atomic_compare_exchange_n(target, &current, value, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+// Allocation telemetry. Per-tag counters are shared by every thread; the
+// frame fields are only written by memory_telemetry_next_frame.
+typedef struct {
+  size_t live;
+  size_t peak;
+  uint64_t allocs;
+  uint64_t bytes;
+  uint64_t frame_start_allocs; // Counters when this frame began
+  uint64_t frame_start_bytes;
+  uint64_t frame_allocs;       // Last completed frame
+  uint64_t frame_bytes;
+} MemoryTagCounters;
+
+static MemoryTagCounters memory_tags[MEMORY_TAG_COUNT];
+static uint64_t memory_frame = 0;
+
+static const char *memory_tag_names[MEMORY_TAG_COUNT] = {
+    "untagged", "ecs", "physics", "scratch", "game",
+};
+
+// Call sites, open addressed by file pointer and line; only filled when
+// callers are built with MEMORY_TRACK_CALLSITES
+static MemoryCallsite memory_callsites[MEMORY_MAX_CALLSITES];
+static uint64_t memory_callsites_dropped = 0; // Allocations from sites that didn't fit
+static pthread_mutex_t memory_callsite_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread const char *tls_callsite_file;
+static __thread int tls_callsite_line;
+
+void memory_track_callsite(const char *file, int line) {
+  tls_callsite_file = file;
+  tls_callsite_line = line;
+}
+
+static void memory_record_callsite(MemoryTag tag, size_t bytes) {
+  const char *file = tls_callsite_file;
+  int line = tls_callsite_line;
+  tls_callsite_file = NULL;
+
+  uint32_t hash = (uint32_t)((uintptr_t)file >> 3) * 2654435761u ^ (uint32_t)line * 40503u;
+  pthread_mutex_lock(&memory_callsite_mutex);
+  for (size_t probe = 0; probe < MEMORY_MAX_CALLSITES; probe++) {
+    MemoryCallsite *site = &memory_callsites[(hash + probe) % MEMORY_MAX_CALLSITES];
+    if (!site->file) {
+      site->file = file;
+      site->line = line;
+      site->tag = tag;
+    }
+    if (site->file == file && site->line == line && site->tag == tag) {
+      site->alloc_count++;
+      site->alloc_bytes += bytes;
+      pthread_mutex_unlock(&memory_callsite_mutex);
+      return;
+    }
+  }
+  memory_callsites_dropped++;
+  pthread_mutex_unlock(&memory_callsite_mutex);
+}
+
+// Every allocation entry point calls this on its way out, so a site noted
+// for an allocation that failed isn't charged with the next one
+static void memory_forget_callsite(void) {
+  tls_callsite_file = NULL;
+}
+
+static void memory_charge(MemoryTag tag, size_t bytes) {
+  MemoryTagCounters *counters = &memory_tags[tag];
+  __atomic_add_fetch(&counters->allocs, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&counters->bytes, bytes, __ATOMIC_RELAXED);
+  atomic_max(&counters->peak,
+             __atomic_add_fetch(&counters->live, bytes, __ATOMIC_RELAXED));
+  if (tls_callsite_file) {
+    memory_record_callsite(tag, bytes);
+  }
+}
+
+static void memory_release(MemoryTag tag, size_t bytes) {
+  if (bytes) {
+    __atomic_sub_fetch(&memory_tags[tag].live, bytes, __ATOMIC_RELAXED);
+  }
+}
+
+// Moves live bytes between tags without counting allocations
+static MemoryTag memory_retag(MemoryTag from, MemoryTag to, size_t bytes) {
+  if ((unsigned)to >= MEMORY_TAG_COUNT) {
+    to = MEMORY_TAG_UNTAGGED;
+  }
+  if (bytes && to != from) {
+    memory_release(from, bytes);
+    atomic_max(&memory_tags[to].peak,
+               __atomic_add_fetch(&memory_tags[to].live, bytes, __ATOMIC_RELAXED));
+  }
+  return to;
+}
+
 void arena_init_with_buffer(Arena *arena, void *buffer, size_t size) {
   arena->memory = (char *)buffer;
   arena->size = size;
   arena->used = 0;
   arena->owns_memory = false; // External buffer, don't free
+  arena->base_memory = arena->memory;
+  arena->base_size = size;
+  arena->chunk = NULL;
+  arena->chunks = NULL;
+  arena->last_alloc = NULL;
+  arena->reserved = 0;
+  arena->flags = 0;
 }
 
 bool arena_init(Arena *arena, size_t size) {
@@ -28,45 +161,223 @@ bool arena_init(Arena *arena, size_t size) {
   arena->size = size;
   arena->used = 0;
   arena->owns_memory = true; // We allocated it, we free it
+  arena->base_memory = arena->memory;
+  arena->base_size = size;
+  arena->chunk = NULL;
+  arena->chunks = NULL;
+  arena->last_alloc = NULL;
+  arena->reserved = 0;
+  arena->flags = 0;
   return true;
 }
 
+// Virtual first blocks. The range is reserved inaccessible and committed
+// (made read/write) from the start as the block fills, so it grows in
+// place and never moves.
+
+#ifdef ARENA_HAS_MMAP
+static void arena_prefault(char *begin, size_t bytes) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  for (size_t offset = 0; offset < bytes; offset += page) {
+    ((volatile char *)begin)[offset] = 0;
+  }
+}
+#endif
+
+// Commits the first block up to `end` bytes; false if it isn't virtual or
+// the reservation is too small
+static bool arena_commit(Arena *arena, size_t end) {
+  if (!arena->reserved || arena->chunk) {
+    return false;
+  }
+  if (end <= arena->base_size) {
+    return true;
+  }
+  if (end > arena->reserved) {
+    return false;
+  }
+#ifdef ARENA_HAS_MMAP
+  size_t commit = align_size(end, ARENA_VIRTUAL_COMMIT_STEP);
+  commit = commit < arena->reserved ? commit : arena->reserved;
+  char *begin = arena->base_memory + arena->base_size;
+  size_t bytes = commit - arena->base_size;
+  if (mprotect(begin, bytes, PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+  if (arena->flags & ARENA_VIRTUAL_PREFAULT) {
+    arena_prefault(begin, bytes);
+  }
+  arena->base_size = commit;
+  arena->size = commit; // In the first block, checked above
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool arena_init_virtual(Arena *arena, size_t reserve_size, size_t commit_size,
+                        uint32_t flags) {
+#ifdef ARENA_HAS_MMAP
+  commit_size = align_size(commit_size, ARENA_VIRTUAL_COMMIT_STEP);
+  reserve_size = align_size(reserve_size > commit_size ? reserve_size : commit_size,
+                            ARENA_VIRTUAL_COMMIT_STEP);
+  if (reserve_size == 0) {
+    return arena_init(arena, commit_size);
+  }
+
+  void *base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (flags & ARENA_VIRTUAL_HUGETLB) {
+    // Without MAP_NORESERVE, so a short huge page pool fails here rather
+    // than with SIGBUS on some later fault
+    base = mmap(NULL, reserve_size, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED) {
+      flags |= ARENA_VIRTUAL_HUGETLB_BACKED;
+    }
+  }
+#endif
+  if (base == MAP_FAILED) {
+    int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    map_flags |= MAP_NORESERVE;
+#endif
+    base = mmap(NULL, reserve_size, PROT_NONE, map_flags, -1, 0);
+    if (base == MAP_FAILED) {
+      return arena_init(arena, commit_size);
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & ARENA_VIRTUAL_HUGE_PAGES) {
+      madvise(base, reserve_size, MADV_HUGEPAGE); // A hint; fine if ignored
+    }
+#endif
+  }
+
+  MemoryTag tag = arena->tag; // May be set before init
+  memset(arena, 0, sizeof(Arena));
+  arena->tag = tag;
+  arena->memory = (char *)base;
+  arena->base_memory = arena->memory;
+  arena->owns_memory = true;
+  arena->reserved = reserve_size;
+  arena->flags = flags;
+  if (!arena_commit(arena, commit_size)) {
+    munmap(base, reserve_size);
+    memset(arena, 0, sizeof(Arena));
+    return false;
+  }
+  return true;
+#else
+  (void)reserve_size;
+  (void)flags;
+  return arena_init(arena, commit_size);
+#endif
+}
+
 void arena_cleanup(Arena *arena) {
-  if (arena->owns_memory && arena->memory) {
-    free(arena->memory);
+#ifdef ARENA_HAS_MMAP
+  if (arena->reserved) {
+    munmap(arena->base_memory, arena->reserved);
+    arena->base_memory = NULL;
+  }
+#endif
+  if (arena->owns_memory && arena->base_memory) {
+    free(arena->base_memory);
   }
+  ArenaChunk *chunk = arena->chunks;
+  while (chunk) {
+    ArenaChunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  memory_release(arena->tag, arena->tracked);
   memset(arena, 0, sizeof(Arena));
 }
 
+static void arena_enter(Arena *arena, ArenaChunk *chunk, size_t used) {
+  arena->last_alloc = NULL;
+  arena->chunk = chunk;
+  arena->memory = chunk ? chunk->data : arena->base_memory;
+  arena->size = chunk ? chunk->size : arena->base_size;
+  arena->used = used;
+}
+
 void arena_reset(Arena *arena) {
-  arena->used = 0;
-  // Keep memory allocated and ownership status
+  // Keep memory allocated (chunks included) and ownership status
+  arena_enter(arena, NULL, 0);
+  memory_release(arena->tag, arena->tracked);
+  arena->tracked = 0;
 }
 
-bool arena_expand_if_needed(Arena *arena, size_t upcoming_alloc_size) {
-  if (!arena || !arena->memory || !arena->owns_memory) {
-    return false; // Can't expand external buffers
+ArenaMark arena_mark(const Arena *arena) {
+  ArenaMark mark = {0}; // ZII
+  mark.chunk = arena->chunk;
+  mark.used = arena->used;
+  mark.tracked = arena->tracked;
+  return mark;
+}
+
+void arena_reset_to_mark(Arena *arena, ArenaMark mark) {
+  arena_enter(arena, mark.chunk, mark.used);
+  if (arena->tracked > mark.tracked) {
+    memory_release(arena->tag, arena->tracked - mark.tracked);
+    arena->tracked = mark.tracked;
   }
+}
+
+static void arena_track(Arena *arena, size_t size) {
+  arena->tracked += size;
+  if (arena->tracked > arena->peak) {
+    arena->peak = arena->tracked;
+  }
+  arena->alloc_count++;
+  memory_charge(arena->tag, size);
+}
 
-  // Calculate usage after the upcoming allocation
-  size_t aligned_used = align_size(arena->used, ARENA_ALIGNMENT);
-  size_t projected_usage = aligned_used + upcoming_alloc_size;
+void arena_set_tag(Arena *arena, MemoryTag tag) {
+  arena->tag = memory_retag(arena->tag, tag, arena->tracked);
+}
+
+// Offset in the current block where an aligned allocation would start
+static size_t arena_aligned_offset(const Arena *arena, size_t alignment) {
+  uintptr_t base = (uintptr_t)arena->memory;
+  return align_size(base + arena->used, alignment) - base;
+}
 
-  // Check if we'll exceed the threshold
-  float usage_ratio = (float)projected_usage / (float)arena->size;
-  if (usage_ratio <= ARENA_EXPANSION_THRESHOLD) {
+bool arena_expand_if_needed(Arena *arena, size_t upcoming_alloc_size) {
+  if (!arena || !arena->memory) {
+    return false;
+  }
+  size_t needed = align_size(upcoming_alloc_size, ARENA_ALIGNMENT);
+  if (arena_aligned_offset(arena, ARENA_ALIGNMENT) + needed <= arena->size) {
     return true; // No expansion needed
   }
-
-  // Double the arena size
-  size_t new_size = arena->size * 2;
-  char *new_memory = (char *)realloc(arena->memory, new_size);
-  if (!new_memory) {
-    return false; // Expansion failed
+  if (!arena->owns_memory) {
+    return false; // Can't chain onto external buffers
+  }
+  if (arena_commit(arena, arena_aligned_offset(arena, ARENA_ALIGNMENT) + needed)) {
+    return true; // Grew the first block in place
   }
 
-  arena->memory = new_memory;
-  arena->size = new_size;
+  // Reuse the next chunk if the request fits; one too small is dropped
+  ArenaChunk **link = arena->chunk ? &arena->chunk->next : &arena->chunks;
+  if (*link && (*link)->size < needed) {
+    ArenaChunk *small = *link;
+    *link = small->next;
+    free(small);
+  }
+  if (!*link) {
+    // Double the current block each time, so spikes take few chunks
+    size_t size = arena->size * 2 > needed ? arena->size * 2 : needed;
+    ArenaChunk *chunk = (ArenaChunk *)malloc(sizeof(ArenaChunk) + size);
+    if (!chunk) {
+      return false; // Expansion failed
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    *link = chunk;
+  }
+  arena_enter(arena, *link, 0);
   return true;
 }
 
@@ -74,29 +385,84 @@ void *arena_alloc(Arena *arena, size_t size) {
   return arena_alloc_aligned(arena, size, ARENA_ALIGNMENT);
 }
 
-void *arena_alloc_aligned(Arena *arena, size_t size, size_t alignment) {
-  if (!arena || !arena->memory || size == 0) {
-    return NULL;
-  }
-  // Try to expand arena if needed before allocation
-  if (!arena_expand_if_needed(arena, size)) {
-    // Expansion failed, but maybe we still have enough space
-  }
+// Bump allocation within the current block, never moves the block
+static void *arena_bump(Arena *arena, size_t size, size_t alignment) {
   // Align the current position
-  size_t aligned_used = align_size(arena->used, alignment);
+  size_t aligned_used = arena_aligned_offset(arena, alignment);
   // Check if we have enough space
   if (aligned_used + size > arena->size) {
     return NULL; // Arena full and couldn't expand
   }
   void *ptr = arena->memory + aligned_used;
   arena->used = aligned_used + size;
+  arena->last_alloc = (char *)ptr;
+  return ptr;
+}
+
+void *arena_alloc_aligned(Arena *arena, size_t size, size_t alignment) {
+  if (!arena || !arena->memory || size == 0) {
+    memory_forget_callsite();
+    return NULL;
+  }
+  void *ptr = arena_bump(arena, size, alignment);
+  // Full: move on to a chunk with room for the alignment padding too
+  if (!ptr && arena_expand_if_needed(arena, size + alignment)) {
+    ptr = arena_bump(arena, size, alignment);
+  }
+  if (ptr) {
+    arena_track(arena, size);
+  }
+  memory_forget_callsite();
+  return ptr;
+}
+
+bool arena_trim_last(Arena *arena, void *ptr, size_t new_size) {
+  if (!arena || !ptr || (char *)ptr != arena->last_alloc) {
+    return false;
+  }
+  size_t end = (size_t)((char *)ptr - arena->memory) + new_size;
+  if (end > arena->used) {
+    return false;
+  }
+  // The tail was charged as part of the allocation (padding never is)
+  size_t released = arena->used - end;
+  released = released < arena->tracked ? released : arena->tracked;
+  memory_release(arena->tag, released);
+  arena->tracked -= released;
+  arena->used = end;
+  return true;
+}
+
+// Pool arenas never grow in place: callers (e.g. ECS component pages) keep
+// pointers into them, and the pool chains a new arena when one fills up
+// (virtual pool arenas commit more of their range in place instead)
+static void *arena_pool_bump(Arena *arena, size_t size) {
+  if (!arena->memory || size == 0) {
+    return NULL;
+  }
+  void *ptr = arena_bump(arena, size, ARENA_ALIGNMENT);
+  if (!ptr &&
+      arena_commit(arena, arena_aligned_offset(arena, ARENA_ALIGNMENT) + size)) {
+    ptr = arena_bump(arena, size, ARENA_ALIGNMENT);
+  }
   return ptr;
 }
 
+// Pool arenas reserve plenty of address space on 64-bit, so one arena
+// normally serves the whole pool; pages are committed as they fill
+static bool arena_pool_new_arena(ArenaPool *pool, Arena *arena, size_t size) {
+  arena->tag = pool->tag;
+  if (sizeof(void *) < 8) {
+    return arena_init(arena, size);
+  }
+  size_t reserve = size > ARENA_POOL_RESERVE_SIZE ? size : ARENA_POOL_RESERVE_SIZE;
+  return arena_init_virtual(arena, reserve, size, ARENA_VIRTUAL_HUGE_PAGES);
+}
+
 bool arena_pool_init(ArenaPool *pool) {
   // ZII: pool should already be zero-initialized
   // Create first arena
-  if (!arena_init(&pool->arenas[0], ARENA_DEFAULT_SIZE)) {
+  if (!arena_pool_new_arena(pool, &pool->arenas[0], ARENA_DEFAULT_SIZE)) {
     return false;
   }
 
@@ -120,13 +486,18 @@ void arena_pool_reset(ArenaPool *pool) {
   pool->current_arena = 0;
 }
 
-void *arena_pool_alloc(ArenaPool *pool, size_t size) {
-  if (!pool || pool->arena_count == 0) {
-    return NULL;
+void arena_pool_set_tag(ArenaPool *pool, MemoryTag tag) {
+  for (size_t i = 0; i < pool->arena_count; i++) {
+    arena_set_tag(&pool->arenas[i], tag);
   }
+  pool->tag = memory_retag(pool->tag, tag, 0);
+}
+
+// Leaves current_arena at the arena that served the allocation
+static void *arena_pool_take(ArenaPool *pool, size_t size) {
 
   // Try current arena first
-  void *ptr = arena_alloc(&pool->arenas[pool->current_arena], size);
+  void *ptr = arena_pool_bump(&pool->arenas[pool->current_arena], size);
   if (ptr) {
     return ptr;
   }
@@ -139,17 +510,17 @@ void *arena_pool_alloc(ArenaPool *pool, size_t size) {
       new_arena_size = align_size(size * 2, ARENA_DEFAULT_SIZE);
     }
 
-    if (arena_init(&pool->arenas[pool->arena_count], new_arena_size)) {
+    if (arena_pool_new_arena(pool, &pool->arenas[pool->arena_count], new_arena_size)) {
       pool->current_arena = pool->arena_count;
       pool->arena_count++;
-      return arena_alloc(&pool->arenas[pool->current_arena], size);
+      return arena_pool_bump(&pool->arenas[pool->current_arena], size);
     }
   }
 
   // Try other existing arenas as fallback
   for (size_t i = 0; i < pool->arena_count; i++) {
     if (i != pool->current_arena) {
-      ptr = arena_alloc(&pool->arenas[i], size);
+      ptr = arena_pool_bump(&pool->arenas[i], size);
       if (ptr) {
         pool->current_arena = i;
         return ptr;
@@ -160,16 +531,43 @@ void *arena_pool_alloc(ArenaPool *pool, size_t size) {
   return NULL; // All arenas full and can't create new one
 }
 
+void *arena_pool_alloc(ArenaPool *pool, size_t size) {
+  if (!pool || pool->arena_count == 0) {
+    memory_forget_callsite();
+    return NULL;
+  }
+  void *ptr = arena_pool_take(pool, size);
+  if (ptr) {
+    arena_track(&pool->arenas[pool->current_arena], size);
+  }
+  memory_forget_callsite();
+  return ptr;
+}
+
 void arena_get_stats(const Arena *arena, ArenaStats *stats) {
   // ZII: stats should already be zero-initialized
   if (!arena || !stats) {
     return;
   }
 
-  stats->total_size = arena->size;
-  stats->used_bytes = arena->used;
-  stats->free_bytes = arena->size - arena->used;
+  // Blocks before the current one count as used until a reset
+  stats->total_size = arena->base_size;
+  stats->used_bytes = arena->chunk ? arena->base_size : arena->used;
   stats->arena_count = 1;
+  bool before_current = arena->chunk != NULL;
+  for (const ArenaChunk *chunk = arena->chunks; chunk; chunk = chunk->next) {
+    stats->total_size += chunk->size;
+    stats->arena_count++;
+    if (chunk == arena->chunk) {
+      stats->used_bytes += arena->used;
+      before_current = false;
+    } else if (before_current) {
+      stats->used_bytes += chunk->size;
+    }
+  }
+  stats->free_bytes = stats->total_size - stats->used_bytes;
+  stats->peak_bytes = arena->peak;
+  stats->alloc_count = arena->alloc_count;
 }
 
 void arena_pool_get_stats(const ArenaPool *pool, ArenaStats *stats) {
@@ -184,17 +582,392 @@ void arena_pool_get_stats(const ArenaPool *pool, ArenaStats *stats) {
   }
   stats->free_bytes = stats->total_size - stats->used_bytes;
   stats->arena_count = pool->arena_count;
+  for (size_t i = 0; i < pool->arena_count; i++) {
+    stats->peak_bytes += pool->arenas[i].peak; // Per arena, so an upper bound
+    stats->alloc_count += pool->arenas[i].alloc_count;
+  }
 }
 
 ArenaScope arena_scope_begin(Arena *arena) {
   ArenaScope scope = {0}; // ZII
   scope.arena = arena;
-  scope.saved_used = arena ? arena->used : 0;
+  if (arena) {
+    scope.mark = arena_mark(arena);
+  }
   return scope;
 }
 
 void arena_scope_end(ArenaScope scope) {
   if (scope.arena) {
-    scope.arena->used = scope.saved_used;
+    arena_reset_to_mark(scope.arena, scope.mark);
+  }
+}
+
+// Scratch arenas. Threads catch up with the global frame when they next ask
+// for scratch, so the main loop never touches another thread's arenas.
+typedef struct {
+  Arena frames[2];
+  uint32_t current; // Index of this frame's arena
+  uint64_t frame;   // Frame the arenas were last synced to
+} ArenaScratch;
+
+static uint64_t scratch_frame = 0;
+static __thread ArenaScratch tls_scratch;
+
+static ArenaScratch *arena_scratch_sync(void) {
+  ArenaScratch *scratch = &tls_scratch;
+  uint64_t frame = __atomic_load_n(&scratch_frame, __ATOMIC_ACQUIRE);
+  if (scratch->frame != frame) {
+    if (frame - scratch->frame == 1) {
+      scratch->current ^= 1; // This frame's becomes last frame's
+    } else {
+      arena_reset(&scratch->frames[scratch->current ^ 1]); // Both are stale
+    }
+    arena_reset(&scratch->frames[scratch->current]);
+    scratch->frame = frame;
+  }
+  for (int i = 0; i < 2; i++) {
+    if (!scratch->frames[i].base_memory) {
+      arena_init(&scratch->frames[i], ARENA_SCRATCH_SIZE);
+      scratch->frames[i].tag = MEMORY_TAG_SCRATCH;
+    }
   }
+  return scratch;
+}
+
+Arena *arena_scratch(void) {
+  ArenaScratch *scratch = arena_scratch_sync();
+  return &scratch->frames[scratch->current];
+}
+
+Arena *arena_scratch_last_frame(void) {
+  ArenaScratch *scratch = arena_scratch_sync();
+  return &scratch->frames[scratch->current ^ 1];
+}
+
+ArenaScope arena_scratch_begin(void) {
+  return arena_scope_begin(arena_scratch());
+}
+
+void arena_scratch_next_frame(void) {
+  __atomic_add_fetch(&scratch_frame, 1, __ATOMIC_RELEASE);
+  memory_telemetry_next_frame();
+}
+
+uint64_t arena_scratch_frame(void) {
+  return __atomic_load_n(&scratch_frame, __ATOMIC_ACQUIRE);
+}
+
+void arena_scratch_thread_cleanup(void) {
+  arena_cleanup(&tls_scratch.frames[0]);
+  arena_cleanup(&tls_scratch.frames[1]);
+  tls_scratch.current = 0;
+}
+
+// Object pools. Objects are carved from the newest slab only when the free
+// list is empty, so free_all just points carving back at the first slab.
+struct ObjectPoolSlab {
+  ObjectPoolSlab *next;
+  size_t reserved; // Keeps objects ARENA_ALIGNMENT aligned
+  char objects[];
+};
+
+bool object_pool_init(ObjectPool *pool, size_t object_size,
+                      size_t objects_per_slab, bool thread_caches) {
+  // ZII: pool should already be zero-initialized
+  if (object_size < sizeof(void *)) {
+    object_size = sizeof(void *); // Room for the free-list link
+  }
+  pool->object_size = align_size(object_size, ARENA_ALIGNMENT);
+  pool->objects_per_slab =
+      objects_per_slab ? objects_per_slab : OBJECT_POOL_DEFAULT_SLAB;
+  pool->thread_caches = thread_caches;
+  if (thread_caches && pthread_mutex_init(&pool->mutex, NULL) != 0) {
+    pool->thread_caches = false;
+    return false;
+  }
+  return true;
+}
+
+void object_pool_cleanup(ObjectPool *pool) {
+  memory_release(pool->tag, pool->live_count * pool->object_size);
+  ObjectPoolSlab *slab = pool->slabs;
+  while (slab) {
+    ObjectPoolSlab *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  if (pool->thread_caches) {
+    pthread_mutex_destroy(&pool->mutex);
+  }
+  // Reset to ZII state
+  memset(pool, 0, sizeof(ObjectPool));
+}
+
+// Takes an object off the shared lists (caller holds the lock if needed)
+static void *object_pool_take(ObjectPool *pool) {
+  if (pool->free_list) {
+    void *object = pool->free_list;
+    pool->free_list = *(void **)object;
+    return object;
+  }
+  if (!pool->carving || pool->carved == pool->objects_per_slab) {
+    // Slabs kept by free_all come first
+    ObjectPoolSlab *next = pool->carving ? pool->carving->next : pool->slabs;
+    if (!next) {
+      next = (ObjectPoolSlab *)malloc(sizeof(ObjectPoolSlab) +
+                                      pool->object_size * pool->objects_per_slab);
+      if (!next) {
+        return NULL;
+      }
+      next->next = NULL;
+      if (pool->carving) {
+        pool->carving->next = next;
+      } else {
+        pool->slabs = next;
+      }
+      pool->slab_count++;
+    }
+    pool->carving = next;
+    pool->carved = 0;
+  }
+  return pool->carving->objects + pool->object_size * pool->carved++;
+}
+
+static void object_pool_count(ObjectPool *pool, bool alloc) {
+  if (alloc) {
+    memory_charge(pool->tag, pool->object_size);
+  } else {
+    memory_release(pool->tag, pool->object_size);
+  }
+  if (!pool->thread_caches) {
+    if (alloc) {
+      pool->alloc_count++;
+      if (++pool->live_count > pool->peak_count) {
+        pool->peak_count = pool->live_count;
+      }
+    } else {
+      pool->free_count++;
+      pool->live_count--;
+    }
+    return;
+  }
+  if (!alloc) {
+    __atomic_add_fetch(&pool->free_count, 1, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&pool->live_count, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  __atomic_add_fetch(&pool->alloc_count, 1, __ATOMIC_RELAXED);
+  atomic_max(&pool->peak_count,
+             __atomic_add_fetch(&pool->live_count, 1, __ATOMIC_RELAXED));
+}
+
+static void *object_pool_alloc_object(ObjectPool *pool) {
+  if (!pool || pool->object_size == 0) {
+    return NULL;
+  }
+  if (!pool->thread_caches) {
+    void *object = object_pool_take(pool);
+    if (object) {
+      object_pool_count(pool, true);
+    }
+    return object;
+  }
+
+  ObjectPoolCache *cache = &pool->caches[thread_pool_current_worker()];
+  if (!cache->head) {
+    // Refill a batch under one lock
+    pthread_mutex_lock(&pool->mutex);
+    for (size_t i = 0; i < OBJECT_POOL_CACHE_BATCH; i++) {
+      void *object = object_pool_take(pool);
+      if (!object) {
+        break;
+      }
+      *(void **)object = cache->head;
+      cache->head = object;
+      cache->count++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    if (!cache->head) {
+      return NULL;
+    }
+  }
+  void *object = cache->head;
+  cache->head = *(void **)object;
+  cache->count--;
+  object_pool_count(pool, true);
+  return object;
+}
+
+void *object_pool_alloc(ObjectPool *pool) {
+  void *object = object_pool_alloc_object(pool);
+  memory_forget_callsite();
+  return object;
+}
+
+void object_pool_free(ObjectPool *pool, void *object) {
+  if (!pool || !object) {
+    return;
+  }
+  object_pool_count(pool, false);
+  if (!pool->thread_caches) {
+    *(void **)object = pool->free_list;
+    pool->free_list = object;
+    return;
+  }
+
+  ObjectPoolCache *cache = &pool->caches[thread_pool_current_worker()];
+  *(void **)object = cache->head;
+  cache->head = object;
+  cache->count++;
+  if (cache->count >= 2 * OBJECT_POOL_CACHE_BATCH) {
+    // Hand a batch back so objects freed here can be reused elsewhere
+    void *first = cache->head;
+    void *last = first;
+    for (size_t i = 1; i < OBJECT_POOL_CACHE_BATCH; i++) {
+      last = *(void **)last;
+    }
+    cache->head = *(void **)last;
+    cache->count -= OBJECT_POOL_CACHE_BATCH;
+    pthread_mutex_lock(&pool->mutex);
+    *(void **)last = pool->free_list;
+    pool->free_list = first;
+    pthread_mutex_unlock(&pool->mutex);
+  }
+}
+
+void object_pool_free_all(ObjectPool *pool) {
+  pool->free_list = NULL;
+  pool->carving = NULL; // The next carve starts at the first slab
+  pool->carved = 0;
+  memset(pool->caches, 0, sizeof(pool->caches));
+  memory_release(pool->tag, pool->live_count * pool->object_size);
+  pool->free_count += pool->live_count;
+  pool->live_count = 0;
+}
+
+void object_pool_set_tag(ObjectPool *pool, MemoryTag tag) {
+  pool->tag = memory_retag(pool->tag, tag, pool->live_count * pool->object_size);
+}
+
+void object_pool_get_stats(const ObjectPool *pool, ArenaStats *stats) {
+  // ZII: stats should already be zero-initialized
+  if (!pool || !stats) {
+    return;
+  }
+
+  stats->total_size = pool->slab_count * pool->objects_per_slab * pool->object_size;
+  stats->used_bytes = pool->live_count * pool->object_size;
+  stats->free_bytes = stats->total_size - stats->used_bytes;
+  stats->arena_count = pool->slab_count;
+  stats->peak_bytes = pool->peak_count * pool->object_size;
+  stats->alloc_count = pool->alloc_count;
+}
+
+void memory_tag_get_stats(MemoryTag tag, MemoryTagStats *stats) {
+  // ZII: stats should already be zero-initialized
+  if ((unsigned)tag >= MEMORY_TAG_COUNT || !stats) {
+    return;
+  }
+
+  MemoryTagCounters *counters = &memory_tags[tag];
+  stats->live_bytes = __atomic_load_n(&counters->live, __ATOMIC_RELAXED);
+  stats->peak_bytes = __atomic_load_n(&counters->peak, __ATOMIC_RELAXED);
+  stats->alloc_count = __atomic_load_n(&counters->allocs, __ATOMIC_RELAXED);
+  stats->alloc_bytes = __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+  stats->frame_allocs = __atomic_load_n(&counters->frame_allocs, __ATOMIC_RELAXED);
+  stats->frame_bytes = __atomic_load_n(&counters->frame_bytes, __ATOMIC_RELAXED);
+}
+
+const char *memory_tag_name(MemoryTag tag) {
+  return (unsigned)tag < MEMORY_TAG_COUNT ? memory_tag_names[tag] : "unknown";
+}
+
+void memory_telemetry_next_frame(void) {
+  for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    MemoryTagCounters *counters = &memory_tags[tag];
+    uint64_t allocs = __atomic_load_n(&counters->allocs, __ATOMIC_RELAXED);
+    uint64_t bytes = __atomic_load_n(&counters->bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&counters->frame_allocs, allocs - counters->frame_start_allocs,
+                     __ATOMIC_RELAXED);
+    __atomic_store_n(&counters->frame_bytes, bytes - counters->frame_start_bytes,
+                     __ATOMIC_RELAXED);
+    counters->frame_start_allocs = allocs;
+    counters->frame_start_bytes = bytes;
+  }
+  __atomic_add_fetch(&memory_frame, 1, __ATOMIC_RELAXED);
+}
+
+static int memory_callsite_compare(const void *a, const void *b) {
+  const MemoryCallsite *site_a = (const MemoryCallsite *)a;
+  const MemoryCallsite *site_b = (const MemoryCallsite *)b;
+  if (site_a->alloc_bytes != site_b->alloc_bytes) {
+    return site_a->alloc_bytes > site_b->alloc_bytes ? -1 : 1;
+  }
+  return site_a->alloc_count > site_b->alloc_count ? -1 : site_a->alloc_count < site_b->alloc_count;
+}
+
+size_t memory_telemetry_callsites(MemoryCallsite *sites, size_t max_sites) {
+  MemoryCallsite *all = (MemoryCallsite *)malloc(sizeof(memory_callsites));
+  if (!all) {
+    return 0;
+  }
+  size_t count = 0;
+  pthread_mutex_lock(&memory_callsite_mutex);
+  for (size_t i = 0; i < MEMORY_MAX_CALLSITES; i++) {
+    if (memory_callsites[i].file) {
+      all[count++] = memory_callsites[i];
+    }
+  }
+  pthread_mutex_unlock(&memory_callsite_mutex);
+
+  qsort(all, count, sizeof(MemoryCallsite), memory_callsite_compare);
+  count = count < max_sites ? count : max_sites;
+  memcpy(sites, all, count * sizeof(MemoryCallsite));
+  free(all);
+  return count;
+}
+
+bool memory_telemetry_dump(const char *path) {
+  FILE *file = path ? fopen(path, "w") : stdout;
+  if (!file) {
+    fprintf(stderr, "Failed to open memory telemetry file: %s\n", path);
+    return false;
+  }
+
+  fprintf(file, "# Memory telemetry, frame %" PRIu64 "\n",
+          __atomic_load_n(&memory_frame, __ATOMIC_RELAXED));
+  fprintf(file, "%-10s %14s %14s %12s %16s %12s %14s\n", "tag", "live_bytes",
+          "peak_bytes", "allocs", "alloc_bytes", "frame_allocs", "frame_bytes");
+  for (int tag = 0; tag < MEMORY_TAG_COUNT; tag++) {
+    MemoryTagStats stats = {0}; // ZII
+    memory_tag_get_stats((MemoryTag)tag, &stats);
+    fprintf(file, "%-10s %14zu %14zu %12" PRIu64 " %16" PRIu64 " %12" PRIu64 " %14" PRIu64 "\n",
+            memory_tag_name((MemoryTag)tag), stats.live_bytes, stats.peak_bytes,
+            stats.alloc_count, stats.alloc_bytes, stats.frame_allocs, stats.frame_bytes);
+  }
+
+  MemoryCallsite *sites = (MemoryCallsite *)malloc(sizeof(memory_callsites));
+  size_t count = sites ? memory_telemetry_callsites(sites, MEMORY_MAX_CALLSITES) : 0;
+  if (count > 0) {
+    fprintf(file, "\n# Call sites by bytes allocated\n");
+    fprintf(file, "%-10s %12s %16s  %s\n", "tag", "allocs", "alloc_bytes", "site");
+    for (size_t i = 0; i < count; i++) {
+      fprintf(file, "%-10s %12" PRIu64 " %16" PRIu64 "  %s:%d\n",
+              memory_tag_name(sites[i].tag), sites[i].alloc_count,
+              sites[i].alloc_bytes, sites[i].file, sites[i].line);
+    }
+    pthread_mutex_lock(&memory_callsite_mutex);
+    uint64_t dropped = memory_callsites_dropped;
+    pthread_mutex_unlock(&memory_callsite_mutex);
+    if (dropped > 0) {
+      fprintf(file, "# %" PRIu64 " allocations from sites past MEMORY_MAX_CALLSITES\n", dropped);
+    }
+  }
+  free(sites);
+
+  if (path) {
+    fclose(file);
+  }
+  return true;
 }
@@ -1,9 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
 #include "physics.h"
 #include <inttypes.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -11,6 +13,47 @@
 
 PhysicsWorld *g_physics_world = NULL;
 
+static ComponentMask physics_body_mask(const PhysicsWorld *world) {
+  return (1ULL << world->transform_type) | (1ULL << world->verlet_type) |
+         (1ULL << world->collider_type);
+}
+
+// Profiling: each phase boundary charges the time since the last one to
+// the phase that just ended. Costs a branch when profile is off.
+static double physics_profile_now(const PhysicsWorld *world) {
+  if (!world->profile) {
+    return 0.0;
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+static void physics_profile_phase(PhysicsWorld *world, PhysicsPhase phase) {
+  if (!world->profile) {
+    return;
+  }
+  double now = physics_profile_now(world);
+  world->phase_seconds[phase] += now - world->profile_mark;
+  world->profile_mark = now;
+}
+
+const char *physics_phase_name(PhysicsPhase phase) {
+  static const char *names[PHYSICS_PHASE_COUNT] = {
+      "integrate", "broadphase", "narrowphase", "constraints", "islands"};
+  return phase < PHYSICS_PHASE_COUNT ? names[phase] : "unknown";
+}
+
+// Size the grid to the boundary circle (with a margin for bodies pushing
+// past it between constraint passes)
+static void physics_world_fit_grid(PhysicsWorld *world) {
+  float grid_size = world->boundary_radius * 2.2f;
+  Vec3 grid_origin = (Vec3){world->boundary_center.x - grid_size / 2.0f,
+                            world->boundary_center.y - grid_size / 2.0f, 0.0f};
+  spatial_grid_init(&world->spatial_grid, &world->spatial_arena, grid_origin,
+                    grid_size, grid_size, PHYSICS_SPATIAL_CELL_SIZE);
+}
+
 void physics_world_init(PhysicsWorld *world, ECS *ecs,
                         ComponentType transform_type) {
   world->ecs = ecs;
@@ -21,38 +64,101 @@ void physics_world_init(PhysicsWorld *world, ECS *ecs,
   world->gravity = (Vec3){0.0f, -200.0f, 0.0f};
   world->damping = PHYSICS_DEFAULT_DAMPING;
   world->collision_iterations = PHYSICS_DEFAULT_COLLISION_ITERATIONS;
+  world->collision_solver = PHYSICS_SOLVER_COLORED;
+  world->warm_start = PHYSICS_DEFAULT_WARM_START;
+  aabb_tree_init(&world->body_tree, AABB_TREE_DEFAULT_MARGIN);
+  physics_set_fixed_timestep(world, 0.0f, PHYSICS_DEFAULT_MAX_SUBSTEPS);
 
   world->boundary_center = (Vec3){0};
   world->boundary_radius = PHYSICS_DEFAULT_BOUNDARY_RADIUS;
 
-  // Initialize arena for spatial grid allocations
-  // 16MB initial: ~2M EntityNodes (8 bytes each) for spatial grid insertions -
-  // should handle 5000+ entities across multiple cells
-  if (!arena_init(&world->spatial_arena, 16 * 1024 * 1024)) {
+  // Arena for the grid's per-pass arrays (cell offsets + 8 bytes per body);
+  // 16MB covers the default grid with room for hundreds of thousands of bodies.
+  // It's virtual: prefaulted on huge pages where the system allows, and grows
+  // in place past the first 16MB instead of chaining chunks
+  if (!arena_init_virtual(&world->spatial_arena, PHYSICS_SPATIAL_ARENA_RESERVE,
+                          PHYSICS_SPATIAL_ARENA_SIZE,
+                          ARENA_VIRTUAL_HUGE_PAGES | ARENA_VIRTUAL_PREFAULT)) {
     printf("Failed to initialize spatial arena\n");
     return;
   }
+  arena_set_tag(&world->spatial_arena, MEMORY_TAG_PHYSICS);
 
-  // Initialize spatial grid with appropriate cell size
-  float cell_size = PHYSICS_SPATIAL_CELL_SIZE;
-  float grid_size = world->boundary_radius * 2.2f;
-  Vec3 grid_origin = (Vec3){-grid_size / 2.0f, -grid_size / 2.0f, 0.0f};
-  spatial_grid_init(&world->spatial_grid, &world->spatial_arena, grid_origin,
-                    grid_size, grid_size, cell_size);
+  physics_world_fit_grid(world);
+  if (!arena_init(&world->query_arena, PHYSICS_QUERY_ARENA_SIZE)) {
+    printf("Failed to initialize query arena\n");
+    return;
+  }
+  arena_set_tag(&world->query_arena, MEMORY_TAG_PHYSICS);
+
+  // Bodies are packed into aligned arrays so the per-body passes can run as
+  // chunked parallel loops
+  world->body_group = ecs_group(ecs, physics_body_mask(world));
+  if (!world->body_group) {
+    fprintf(stderr, "Failed to create physics body group\n");
+  }
 
   g_physics_world = world;
 
-  ComponentMask physics_mask = (1ULL << world->transform_type) |
-                               (1ULL << world->verlet_type) |
-                               (1ULL << world->collider_type);
+  ComponentMask physics_mask = physics_body_mask(world);
+#ifdef DEBUG
   printf("Registering physics system with mask %" PRIu64
          " (transform=%d, verlet=%d)\n",
          physics_mask, world->transform_type, world->verlet_type);
-  ecs_register_system(ecs, physics_system_update, physics_mask);
+#endif
+  ecs_register_system_with_access(ecs, physics_system_update, 0, physics_mask);
 }
 
 void physics_world_cleanup(PhysicsWorld *world) {
+  physics_bodies_cleanup(&world->bodies);
+  free(world->held_acceleration);
+  world->held_acceleration = NULL;
+  world->held_capacity = 0;
+  for (size_t w = 0; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    free(world->contacts[w].pairs);
+    world->contacts[w] = (PhysicsContactList){0};
+  }
+  for (int c = 0; c < 2; c++) {
+    free(world->contact_cache[c].entries);
+    world->contact_cache[c] = (PhysicsContactCache){0};
+  }
+  free(world->awake_rows);
+  free(world->written_rows);
+  free(world->written);
+  free(world->tree_moved);
+  world->awake_rows = NULL;
+  world->written_rows = NULL;
+  world->written = NULL;
+  world->tree_moved = NULL;
+  world->awake_count = 0;
+  world->written_count = 0;
+  world->row_capacity = 0;
+  free(world->sleepers.cell_head);
+  free(world->sleepers.cell);
+  free(world->sleepers.next);
+  free(world->sleepers.prev);
+  free(world->sleepers.island_next);
+  world->sleepers = (PhysicsSleepers){0};
+  world->synced = false;
+  free(world->sweep.order);
+  free(world->sweep.min_x);
+  free(world->sweep.listed);
+  world->sweep = (PhysicsSweep){0};
+  aabb_tree_cleanup(&world->body_tree);
+  free(world->tree_pairs.pairs);
+  world->tree_pairs = (PhysicsContactList){0};
+  free(world->query_scratch.rows);
+  free(world->query_scratch.distances);
+  free(world->query_scratch.offsets);
+  world->query_scratch = (PhysicsQueryScratch){0};
+  spatial_grid_cleanup(&world->query_grid);
+  arena_cleanup(&world->query_arena);
+  free(world->snapshot_words);
+  world->snapshot_words = NULL;
+  world->snapshot_capacity = 0;
+  world->snapshot_rows_id = 0;
   spatial_grid_cleanup(&world->spatial_grid);
+  spatial_grid_cells_cleanup(&world->awake_cells);
   arena_cleanup(&world->spatial_arena);
   g_physics_world = NULL;
 }
@@ -74,6 +180,8 @@ Entity physics_create_circle(PhysicsWorld *world, Vec3 position, float radius,
   verlet->old_position = position;
   verlet->is_sleeping = false; // Start awake
   verlet->sleep_timer = 0;
+  verlet->island = 0;
+  verlet->tree_proxy = 0;
 
   CircleCollider *collider = (CircleCollider *)ecs_add_component(
       world->ecs, entity, world->collider_type);
@@ -84,269 +192,2716 @@ Entity physics_create_circle(PhysicsWorld *world, Vec3 position, float radius,
   return entity;
 }
 
-void physics_set_boundary(PhysicsWorld *world, Vec3 center, float radius) {
-  world->boundary_center = center;
-  world->boundary_radius = radius;
+void physics_set_boundary(PhysicsWorld *world, Vec3 center, float radius) {
+  world->boundary_center = center;
+  world->boundary_radius = radius;
+  physics_world_fit_grid(world);
+  world->synced = false; // Sleeper bins follow the grid's cells
+}
+
+void physics_system_update(float delta_time) {
+  if (!g_physics_world) {
+#ifdef DEBUG
+    printf("NO PHYSICS SYSTEM\n");
+#endif
+    return;
+  }
+
+#ifdef DEBUG
+  static int frame_count = 0;
+  if (frame_count % 120 == 0) {
+    printf("Physics system running frame %d\n", frame_count);
+  }
+  frame_count++;
+#endif
+
+  physics_world_update(g_physics_world, delta_time);
+}
+
+// ECS <-> body store. Row i of the store is row i of the body group, so both
+// directions are straight copies over each chunk's contiguous arrays. The
+// store persists between steps: physics_sync reads back what may have
+// changed since the last step, and physics_write_back what the step touched.
+
+static int physics_compare_rows(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void physics_gather_row(PhysicsBodies *bodies, size_t row,
+                               const Transform *transform,
+                               const VerletBody *verlet,
+                               const CircleCollider *collider, Entity entity) {
+  bodies->x[row] = transform->position.x;
+  bodies->y[row] = transform->position.y;
+  bodies->old_x[row] = verlet->old_position.x;
+  bodies->old_y[row] = verlet->old_position.y;
+  bodies->ax[row] = verlet->acceleration.x;
+  bodies->ay[row] = verlet->acceleration.y;
+  bodies->vx[row] = verlet->velocity.x;
+  bodies->vy[row] = verlet->velocity.y;
+  bodies->radius[row] = collider->radius;
+  bodies->inv_mass[row] = collider->mass > 0.0f ? 1.0f / collider->mass : 0.0f;
+  bodies->sleeping[row] = verlet->is_sleeping ? 1 : 0;
+  bodies->sleep_timer[row] = verlet->sleep_timer;
+  bodies->island[row] = verlet->island;
+  bodies->entity[row] = entity;
+  bodies->tree_proxy[row] = verlet->tree_proxy;
+}
+
+static void physics_gather_chunk(const EcsChunk *chunk, void *user_data,
+                                 void *chunk_context) {
+  (void)chunk_context;
+  PhysicsWorld *world = (PhysicsWorld *)user_data;
+  const Transform *transforms =
+      (const Transform *)chunk->components[world->transform_type];
+  const VerletBody *verlets =
+      (const VerletBody *)chunk->components[world->verlet_type];
+  const CircleCollider *colliders =
+      (const CircleCollider *)chunk->components[world->collider_type];
+
+  size_t base = chunk->index * ECS_COMPONENT_PAGE_SIZE;
+  for (size_t i = 0; i < chunk->count; i++) {
+    physics_gather_row(&world->bodies, base + i, &transforms[i], &verlets[i],
+                       &colliders[i], chunk->entities[i]);
+  }
+}
+
+static void physics_scatter_row(PhysicsWorld *world, const EcsChunk *chunk,
+                                size_t i, size_t row) {
+  const PhysicsBodies *bodies = &world->bodies;
+  Transform *transform =
+      &((Transform *)chunk->components[world->transform_type])[i];
+  VerletBody *verlet = &((VerletBody *)chunk->components[world->verlet_type])[i];
+
+  // Only bodies that moved are stamped, so sleepers don't look changed
+  if (transform->position.x != bodies->x[row] ||
+      transform->position.y != bodies->y[row]) {
+    transform->position.x = bodies->x[row];
+    transform->position.y = bodies->y[row];
+    ecs_chunk_mark_changed(chunk, world->transform_type, i);
+  }
+  verlet->old_position.x = bodies->old_x[row];
+  verlet->old_position.y = bodies->old_y[row];
+  verlet->acceleration.x = bodies->ax[row];
+  verlet->acceleration.y = bodies->ay[row];
+  verlet->velocity.x = bodies->vx[row];
+  verlet->velocity.y = bodies->vy[row];
+  verlet->is_sleeping = bodies->sleeping[row] != 0;
+  verlet->sleep_timer = bodies->sleep_timer[row];
+  verlet->island = bodies->island[row];
+  verlet->tree_proxy = bodies->tree_proxy[row];
+}
+
+static void physics_scatter_chunk(const EcsChunk *chunk, void *user_data,
+                                  void *chunk_context) {
+  (void)chunk_context;
+  PhysicsWorld *world = (PhysicsWorld *)user_data;
+  size_t base = chunk->index * ECS_COMPONENT_PAGE_SIZE;
+  for (size_t i = 0; i < chunk->count; i++) {
+    physics_scatter_row(world, chunk, i, base + i);
+  }
+}
+
+// A sorted row list split into runs that share a chunk, one task per run
+typedef struct {
+  PhysicsWorld *world;
+  const uint32_t *rows;
+  const uint32_t *runs; // First list entry of each run, then the list length
+} PhysicsChunkRunJob;
+
+static void physics_gather_run_task(void *context, size_t task_index,
+                                    uint32_t worker_index) {
+  (void)worker_index;
+  PhysicsChunkRunJob *job = (PhysicsChunkRunJob *)context;
+  PhysicsWorld *world = job->world;
+  uint32_t begin = job->runs[task_index];
+  uint32_t end = job->runs[task_index + 1];
+  EcsChunk chunk;
+  if (!ecs_group_chunk(world->ecs, world->body_group,
+                       job->rows[begin] / ECS_COMPONENT_PAGE_SIZE, &chunk)) {
+    return;
+  }
+  const Transform *transforms =
+      (const Transform *)chunk.components[world->transform_type];
+  const VerletBody *verlets =
+      (const VerletBody *)chunk.components[world->verlet_type];
+  const CircleCollider *colliders =
+      (const CircleCollider *)chunk.components[world->collider_type];
+
+  size_t base = chunk.index * ECS_COMPONENT_PAGE_SIZE;
+  for (uint32_t k = begin; k < end; k++) {
+    size_t i = job->rows[k] - base;
+    physics_gather_row(&world->bodies, job->rows[k], &transforms[i],
+                       &verlets[i], &colliders[i], chunk.entities[i]);
+  }
+}
+
+static void physics_scatter_run_task(void *context, size_t task_index,
+                                     uint32_t worker_index) {
+  (void)worker_index;
+  PhysicsChunkRunJob *job = (PhysicsChunkRunJob *)context;
+  PhysicsWorld *world = job->world;
+  uint32_t begin = job->runs[task_index];
+  uint32_t end = job->runs[task_index + 1];
+  EcsChunk chunk;
+  if (!ecs_group_chunk(world->ecs, world->body_group,
+                       job->rows[begin] / ECS_COMPONENT_PAGE_SIZE, &chunk)) {
+    return;
+  }
+  size_t base = chunk.index * ECS_COMPONENT_PAGE_SIZE;
+  for (uint32_t k = begin; k < end; k++) {
+    physics_scatter_row(world, &chunk, job->rows[k] - base, job->rows[k]);
+  }
+}
+
+// Runs task over the chunks holding the (ascending) rows; the run table
+// comes from the spatial arena. False if it doesn't fit.
+static bool physics_run_chunks(PhysicsWorld *world, const uint32_t *rows,
+                               size_t count, ThreadPoolTaskFunc task) {
+  if (count == 0) {
+    return true;
+  }
+  uint32_t *runs = (uint32_t *)arena_alloc(&world->spatial_arena,
+                                           (count + 1) * sizeof(uint32_t));
+  if (!runs) {
+    fprintf(stderr, "Failed to allocate chunk runs (%zu rows)\n", count);
+    return false;
+  }
+  size_t run_count = 0;
+  for (size_t k = 0; k < count; k++) {
+    if (k == 0 || rows[k] / ECS_COMPONENT_PAGE_SIZE !=
+                      rows[k - 1] / ECS_COMPONENT_PAGE_SIZE) {
+      runs[run_count++] = (uint32_t)k;
+    }
+  }
+  runs[run_count] = (uint32_t)count;
+
+  PhysicsChunkRunJob job = {0}; // ZII
+  job.world = world;
+  job.rows = rows;
+  job.runs = runs;
+  thread_pool_run(world->ecs->thread_pool, run_count, task, &job);
+  return true;
+}
+
+// Grows the row lists and the sleepers' per-row arrays; flags start clear
+static bool physics_rows_reserve(PhysicsWorld *world, size_t count) {
+  if (count <= world->row_capacity) {
+    return true;
+  }
+  size_t capacity = world->row_capacity ? world->row_capacity : 1024;
+  while (capacity < count) {
+    capacity *= 2;
+  }
+
+  uint32_t **lists[] = {&world->awake_rows,       &world->written_rows,
+                        &world->sleepers.cell,    &world->sleepers.next,
+                        &world->sleepers.prev,    &world->sleepers.island_next};
+  for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+    uint32_t *grown =
+        (uint32_t *)realloc(*lists[i], capacity * sizeof(uint32_t));
+    if (!grown) {
+      fprintf(stderr, "Failed to grow physics row lists (%zu rows)\n", capacity);
+      return false;
+    }
+    *lists[i] = grown;
+  }
+  uint8_t **flags[] = {&world->written, &world->tree_moved};
+  for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+    uint8_t *grown = (uint8_t *)realloc(*flags[i], capacity);
+    if (!grown) {
+      fprintf(stderr, "Failed to grow physics row lists (%zu rows)\n", capacity);
+      return false;
+    }
+    memset(grown + world->row_capacity, 0, capacity - world->row_capacity);
+    *flags[i] = grown;
+  }
+  world->row_capacity = capacity;
+  return true;
+}
+
+static void physics_mark_written(PhysicsWorld *world, uint32_t row) {
+  if (!world->written[row]) {
+    world->written[row] = 1;
+    world->written_rows[world->written_count++] = row;
+  }
+}
+
+// Reads every row back and lists them all as awake; integration and waking
+// sort the sleepers out. Used when rows may have moved and by the
+// single-phase functions.
+static bool physics_gather(PhysicsWorld *world) {
+  size_t count = world->body_group ? world->body_group->count : 0;
+  world->synced = false;
+  if (!physics_bodies_reserve(&world->bodies, count) ||
+      !physics_rows_reserve(world, count)) {
+    world->bodies.count = 0;
+    world->awake_count = 0;
+    world->written_count = 0;
+    return false;
+  }
+  world->bodies.count = count;
+  ecs_group_parallel_for(world->ecs, world->body_group, physics_gather_chunk,
+                         world, NULL, 0);
+  for (size_t row = 0; row < count; row++) {
+    world->awake_rows[row] = (uint32_t)row;
+  }
+  world->awake_count = count;
+  memset(world->written, 0, count);
+  world->written_count = 0;
+  world->tree_pairs_stale = true; // Rows and sleep states may have changed
+  world->tree_full_sync = true;
+  return true;
+}
+
+static void physics_scatter(PhysicsWorld *world) {
+  ecs_group_parallel_for(world->ecs, world->body_group, physics_scatter_chunk,
+                         world, NULL, 0);
+}
+
+static bool physics_sleepers_rebuild(PhysicsWorld *world);
+
+// Full sync: every row is read back, stepped once (so sleepers get their
+// wake test) and written back
+static bool physics_sync_all(PhysicsWorld *world) {
+  if (!physics_gather(world) || !physics_sleepers_rebuild(world)) {
+    return false;
+  }
+  for (size_t row = 0; row < world->bodies.count; row++) {
+    world->written_rows[row] = (uint32_t)row;
+    world->written[row] = 1;
+  }
+  world->written_count = world->bodies.count;
+  world->scatter_all = true;
+  return true;
+}
+
+// Brings the store up to date before a step. While the group's rows stay
+// put, only the awake rows and the sleepers stamped since the last
+// write-back are read; the stamped sleepers join the awake list for the
+// step's wake test. False if the store can't hold the group.
+static bool physics_sync(PhysicsWorld *world) {
+  EcsGroup *group = world->body_group;
+  if (!world->synced || !group || group->count != world->bodies.count ||
+      group->version != world->synced_version) {
+    return physics_sync_all(world);
+  }
+
+  Arena *arena = &world->spatial_arena;
+  arena_reset(arena);
+  if (!physics_run_chunks(world, world->awake_rows, world->awake_count,
+                          physics_gather_run_task)) {
+    return physics_sync_all(world);
+  }
+
+  // Binned rows are exactly the sleepers; only stamped chunks are searched
+  const PhysicsSleepers *sleepers = &world->sleepers;
+  size_t stamped_count = 0;
+  uint32_t *stamped = NULL;
+  if (sleepers->count > 0) {
+    stamped = (uint32_t *)arena_alloc(arena, sleepers->count * sizeof(uint32_t));
+    if (!stamped) {
+      fprintf(stderr, "Failed to allocate stamped sleepers (%zu bodies)\n",
+              sleepers->count);
+      return physics_sync_all(world);
+    }
+  }
+  uint32_t since = world->synced_tick;
+  ComponentType types[3] = {world->transform_type, world->verlet_type,
+                            world->collider_type};
+  size_t chunks = sleepers->count > 0 ? ecs_group_chunk_count(group) : 0;
+  for (size_t c = 0; c < chunks; c++) {
+    EcsChunk chunk;
+    if (!ecs_group_chunk(world->ecs, group, c, &chunk) ||
+        !(ecs_chunk_changed_since(&chunk, types[0], since) ||
+          ecs_chunk_changed_since(&chunk, types[1], since) ||
+          ecs_chunk_changed_since(&chunk, types[2], since))) {
+      continue;
+    }
+    size_t base = chunk.index * ECS_COMPONENT_PAGE_SIZE;
+    for (size_t i = 0; i < chunk.count; i++) {
+      size_t row = base + i;
+      if (sleepers->cell[row] == PHYSICS_NO_ROW ||
+          (chunk.ticks[types[0]][i].changed < since &&
+           chunk.ticks[types[1]][i].changed < since &&
+           chunk.ticks[types[2]][i].changed < since)) {
+        continue;
+      }
+      physics_gather_row(
+          &world->bodies, row, &((const Transform *)chunk.components[types[0]])[i],
+          &((const VerletBody *)chunk.components[types[1]])[i],
+          &((const CircleCollider *)chunk.components[types[2]])[i],
+          chunk.entities[i]);
+      stamped[stamped_count++] = (uint32_t)row;
+    }
+  }
+
+  // Both lists ascend (and don't share rows), so merge them
+  if (stamped_count > 0) {
+    size_t total = world->awake_count + stamped_count;
+    uint32_t *merged = (uint32_t *)arena_alloc(arena, total * sizeof(uint32_t));
+    if (!merged) {
+      fprintf(stderr, "Failed to merge stamped sleepers (%zu bodies)\n", total);
+      return physics_sync_all(world);
+    }
+    size_t a = 0, s = 0;
+    for (size_t k = 0; k < total; k++) {
+      merged[k] = s == stamped_count ||
+                          (a < world->awake_count &&
+                           world->awake_rows[a] < stamped[s])
+                      ? world->awake_rows[a++]
+                      : stamped[s++];
+    }
+    memcpy(world->awake_rows, merged, total * sizeof(uint32_t));
+    world->awake_count = total;
+  }
+
+  for (size_t k = 0; k < world->awake_count; k++) {
+    physics_mark_written(world, world->awake_rows[k]);
+  }
+  return true;
+}
+
+// Writes back the rows the step touched (every row after a full sync), then
+// records what the store now matches
+static void physics_write_back(PhysicsWorld *world) {
+  if (world->scatter_all) {
+    physics_scatter(world);
+  } else {
+    qsort(world->written_rows, world->written_count, sizeof(uint32_t),
+          physics_compare_rows);
+    arena_reset(&world->spatial_arena);
+    if (!physics_run_chunks(world, world->written_rows, world->written_count,
+                            physics_scatter_run_task)) {
+      physics_scatter(world);
+    }
+  }
+
+  for (size_t k = 0; k < world->written_count; k++) {
+    world->written[world->written_rows[k]] = 0;
+  }
+  world->written_count = 0;
+  world->scatter_all = false;
+  world->synced = world->body_group != NULL;
+  world->synced_version = world->body_group ? world->body_group->version : 0;
+  world->synced_tick = ecs_change_tick(world->ecs);
+}
+
+// Body-store kernels over a row list (or every row), split into batches of
+// list entries across the ECS thread pool. Each batch calls the kernel once
+// per run of consecutive rows, so a mostly awake world keeps its SIMD runs.
+
+typedef struct {
+  PhysicsWorld *world;
+  PhysicsIntegrateParams params;
+  const uint32_t *rows; // Ascending rows to run on, NULL = rows [0, count)
+  size_t count;
+} PhysicsKernelJob;
+
+typedef void (*PhysicsKernelFunc)(PhysicsKernelJob *job, size_t begin,
+                                  size_t end);
+
+static size_t physics_batch_count(size_t count) {
+  return (count + PHYSICS_BODY_BATCH_SIZE - 1) / PHYSICS_BODY_BATCH_SIZE;
+}
+
+static void physics_batch_runs(PhysicsKernelJob *job, size_t batch,
+                               PhysicsKernelFunc kernel) {
+  size_t begin = batch * PHYSICS_BODY_BATCH_SIZE;
+  size_t end = begin + PHYSICS_BODY_BATCH_SIZE;
+  if (end > job->count) {
+    end = job->count;
+  }
+  if (!job->rows) {
+    kernel(job, begin, end);
+    return;
+  }
+  while (begin < end) {
+    size_t last = begin;
+    while (last + 1 < end && job->rows[last + 1] == job->rows[last] + 1) {
+      last++;
+    }
+    kernel(job, job->rows[begin], (size_t)job->rows[last] + 1);
+    begin = last + 1;
+  }
+}
+
+static void physics_integrate_run(PhysicsKernelJob *job, size_t begin,
+                                  size_t end) {
+  physics_bodies_integrate(&job->world->bodies, begin, end, &job->params);
+}
+
+static void physics_constrain_run(PhysicsKernelJob *job, size_t begin,
+                                  size_t end) {
+  PhysicsWorld *world = job->world;
+  physics_bodies_constrain(&world->bodies, begin, end,
+                           world->boundary_center.x, world->boundary_center.y,
+                           world->boundary_radius);
+}
+
+static void physics_integrate_task(void *context, size_t task_index,
+                                   uint32_t worker_index) {
+  (void)worker_index;
+  physics_batch_runs((PhysicsKernelJob *)context, task_index,
+                     physics_integrate_run);
+}
+
+static void physics_constrain_task(void *context, size_t task_index,
+                                   uint32_t worker_index) {
+  (void)worker_index;
+  physics_batch_runs((PhysicsKernelJob *)context, task_index,
+                     physics_constrain_run);
+}
+
+static void physics_integrate_bodies(PhysicsWorld *world, float delta_time,
+                                     int32_t sleep_steps, const uint32_t *rows,
+                                     size_t count) {
+  PhysicsKernelJob job = {0}; // ZII
+  job.world = world;
+  job.rows = rows;
+  job.count = count;
+  job.params.sleep_steps = sleep_steps;
+  job.params.gravity_x = world->gravity.x;
+  job.params.gravity_y = world->gravity.y;
+  job.params.damping = world->damping;
+  job.params.delta_time = delta_time;
+  thread_pool_run(world->ecs->thread_pool, physics_batch_count(count),
+                  physics_integrate_task, &job);
+}
+
+static void physics_constrain_bodies(PhysicsWorld *world, const uint32_t *rows,
+                                     size_t count) {
+  PhysicsKernelJob job = {0}; // ZII
+  job.world = world;
+  job.rows = rows;
+  job.count = count;
+  thread_pool_run(world->ecs->thread_pool, physics_batch_count(count),
+                  physics_constrain_task, &job);
+}
+
+// Counter-based generator: a pure function of the seed, step and key, so
+// it gives the same numbers whichever thread or pass order asks
+static uint64_t physics_mix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull; // splitmix64
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Direction for a contact whose centres coincide, picked by key
+static Vec3 physics_fallback_normal(uint64_t key) {
+  float angle =
+      (float)(physics_mix64(key) >> 40) * (2.0f * (float)M_PI / 16777216.0f);
+  return (Vec3){cosf(angle), sinf(angle), 0.0f};
+}
+
+// Key from the bit patterns of two positions, for callers without a world
+static uint64_t physics_position_key(Vec3 a, Vec3 b) {
+  uint32_t bits[4];
+  memcpy(&bits[0], &a.x, sizeof(float));
+  memcpy(&bits[1], &a.y, sizeof(float));
+  memcpy(&bits[2], &b.x, sizeof(float));
+  memcpy(&bits[3], &b.y, sizeof(float));
+  return physics_mix64(((uint64_t)bits[0] << 32 | bits[1]) ^
+                       physics_mix64((uint64_t)bits[2] << 32 | bits[3]));
+}
+
+// Salt for one collision pass's fallback normals
+static uint64_t physics_contact_salt(const PhysicsWorld *world) {
+  return physics_mix64(world->random_seed ^ physics_mix64(world->step_count));
+}
+
+static bool physics_circle_contact(Vec3 pos1, float r1, Vec3 pos2, float r2,
+                                   uint64_t key, Vec3 *normal,
+                                   float *penetration);
+
+// Overlap test for rows a < b; a degenerate normal comes from the pass salt
+// and the pair's entities, so it doesn't depend on row or thread order
+static bool physics_contact_rows(const PhysicsBodies *bodies, uint32_t a,
+                                 uint32_t b, uint64_t salt, Vec3 *normal,
+                                 float *penetration) {
+  uint32_t low = bodies->entity[a] < bodies->entity[b] ? bodies->entity[a]
+                                                        : bodies->entity[b];
+  uint32_t high = bodies->entity[a] ^ bodies->entity[b] ^ low;
+  return physics_circle_contact(
+      (Vec3){bodies->x[a], bodies->y[a], 0.0f}, bodies->radius[a],
+      (Vec3){bodies->x[b], bodies->y[b], 0.0f}, bodies->radius[b],
+      salt ^ ((uint64_t)low << 32 | high), normal, penetration);
+}
+
+// Same response as resolve_circle_collision, on body rows
+static void physics_resolve_bodies(PhysicsBodies *bodies, uint32_t a,
+                                   uint32_t b, float normal_x, float normal_y,
+                                   float penetration) {
+  // Wake up any sleeping objects involved in collision
+  if (bodies->sleeping[a]) {
+    bodies->sleeping[a] = 0;
+    bodies->sleep_timer[a] = 0;
+  }
+  if (bodies->sleeping[b]) {
+    bodies->sleeping[b] = 0;
+    bodies->sleep_timer[b] = 0;
+  }
+
+  // Clamp penetration to prevent numerical explosion
+  float max_penetration =
+      (bodies->radius[a] + bodies->radius[b]) * PHYSICS_MAX_PENETRATION_RATIO;
+  if (penetration > max_penetration) {
+    penetration = max_penetration;
+  }
+
+  // Mass ratios m_b / (m_a + m_b), written with inverse masses
+  float total_inv_mass = bodies->inv_mass[a] + bodies->inv_mass[b];
+  if (total_inv_mass <= 0.0f) {
+    return; // Both immovable
+  }
+  float mass_ratio_a = bodies->inv_mass[a] / total_inv_mass;
+  float mass_ratio_b = bodies->inv_mass[b] / total_inv_mass;
+
+  float correction = penetration * PHYSICS_CORRECTION_FACTOR;
+  bodies->x[a] -= normal_x * correction * mass_ratio_a;
+  bodies->y[a] -= normal_y * correction * mass_ratio_a;
+  bodies->x[b] += normal_x * correction * mass_ratio_b;
+  bodies->y[b] += normal_y * correction * mass_ratio_b;
+
+  // Add velocity damping to prevent energy buildup
+  float relative_speed = (bodies->vx[a] - bodies->vx[b]) * normal_x +
+                         (bodies->vy[a] - bodies->vy[b]) * normal_y;
+  if (relative_speed < 0) {
+    float impulse = -(1.0f + PHYSICS_DEFAULT_RESTITUTION) * relative_speed / 2.0f;
+    bodies->vx[a] += normal_x * impulse * mass_ratio_a;
+    bodies->vy[a] += normal_y * impulse * mass_ratio_a;
+    bodies->vx[b] -= normal_x * impulse * mass_ratio_b;
+    bodies->vy[b] -= normal_y * impulse * mass_ratio_b;
+  }
+}
+
+static void physics_record_contact(PhysicsContactList *list, uint32_t a,
+                                   uint32_t b) {
+  if (list->count == list->capacity) {
+    size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+    uint32_t *pairs =
+        (uint32_t *)realloc(list->pairs, capacity * 2 * sizeof(uint32_t));
+    if (!pairs) {
+      fprintf(stderr, "Failed to grow physics contact list\n");
+      return; // The island may split; it still sleeps, just in parts
+    }
+    list->pairs = pairs;
+    list->capacity = capacity;
+  }
+  list->pairs[list->count * 2] = a;
+  list->pairs[list->count * 2 + 1] = b;
+  list->count++;
+}
+
+// Resolve every pair with its lower row in cell (cx, cy). Each body sits in
+// one cell, so visiting every cell once sees each overlapping pair once.
+// Touching pairs are appended to contacts when it isn't NULL.
+static void physics_collide_cell(PhysicsBodies *bodies, const SpatialGrid *grid,
+                                 PhysicsContactList *contacts, uint64_t salt,
+                                 int cx, int cy) {
+  size_t cell = (size_t)cy * grid->grid_width + cx;
+  uint32_t begin = grid->cell_start[cell];
+  uint32_t end = grid->cell_end[cell];
+  if (begin == end) {
+    return;
+  }
+
+  int reach = grid->reach;
+  int min_y = cy - reach < 0 ? 0 : cy - reach;
+  int max_y = cy + reach >= grid->grid_height ? grid->grid_height - 1 : cy + reach;
+  int min_x = cx - reach < 0 ? 0 : cx - reach;
+  int max_x = cx + reach >= grid->grid_width ? grid->grid_width - 1 : cx + reach;
+
+  for (uint32_t i = begin; i < end; i++) {
+    uint32_t a = grid->cell_entities[i];
+    for (int ny = min_y; ny <= max_y; ny++) {
+      for (int nx = min_x; nx <= max_x; nx++) {
+        size_t other = (size_t)ny * grid->grid_width + nx;
+        for (uint32_t j = grid->cell_start[other]; j < grid->cell_end[other];
+             j++) {
+          uint32_t b = grid->cell_entities[j];
+          if (b <= a) {
+            continue; // Each pair once
+          }
+
+          Vec3 normal;
+          float penetration;
+          if (physics_contact_rows(bodies, a, b, salt, &normal,
+                                   &penetration)) {
+            physics_resolve_bodies(bodies, a, b, normal.x, normal.y,
+                                   penetration);
+            if (contacts) {
+              physics_record_contact(contacts, a, b);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// One colour class of cells: task i is the colour's i-th occupied cell
+typedef struct {
+  PhysicsBodies *bodies;
+  const SpatialGrid *grid;
+  const uint32_t *cells;        // Occupied cells of the colour, ascending
+  PhysicsContactList *contacts; // One per worker, NULL when not recording
+  uint64_t salt;                // Fallback normal salt for the pass
+} PhysicsCollideJob;
+
+static void physics_collide_task(void *context, size_t task_index,
+                                 uint32_t worker_index) {
+  PhysicsCollideJob *job = (PhysicsCollideJob *)context;
+  int cx = (int)(job->cells[task_index] % (uint32_t)job->grid->grid_width);
+  int cy = (int)(job->cells[task_index] / (uint32_t)job->grid->grid_width);
+  physics_collide_cell(job->bodies, job->grid,
+                       job->contacts ? &job->contacts[worker_index] : NULL,
+                       job->salt, cx, cy);
+}
+
+// Sort-and-sweep broadphase. The order holds the awake rows: rows that fell
+// asleep (or are past the end after removals) are dropped, newly awake rows
+// are appended, then it is re-sorted.
+static bool physics_sweep_update(PhysicsSweep *sweep,
+                                 const PhysicsBodies *bodies,
+                                 const uint32_t *rows, size_t row_count) {
+  if (bodies->count > sweep->capacity) {
+    size_t capacity = sweep->capacity ? sweep->capacity : 256;
+    while (capacity < bodies->count) {
+      capacity *= 2;
+    }
+    uint32_t *order =
+        (uint32_t *)realloc(sweep->order, capacity * sizeof(uint32_t));
+    if (!order) {
+      fprintf(stderr, "Failed to grow sweep order (%zu rows)\n", capacity);
+      return false;
+    }
+    sweep->order = order;
+    float *min_x = (float *)realloc(sweep->min_x, capacity * sizeof(float));
+    if (!min_x) {
+      fprintf(stderr, "Failed to grow sweep order (%zu rows)\n", capacity);
+      return false;
+    }
+    sweep->min_x = min_x;
+    uint8_t *listed = (uint8_t *)realloc(sweep->listed, capacity);
+    if (!listed) {
+      fprintf(stderr, "Failed to grow sweep order (%zu rows)\n", capacity);
+      return false;
+    }
+    memset(listed + sweep->capacity, 0, capacity - sweep->capacity);
+    sweep->listed = listed;
+    sweep->capacity = capacity;
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < sweep->count; i++) {
+    uint32_t row = sweep->order[i];
+    if (row < bodies->count && !bodies->sleeping[row]) {
+      sweep->order[kept++] = row;
+    } else {
+      sweep->listed[row] = 0;
+    }
+  }
+  for (size_t k = 0; k < row_count; k++) {
+    if (!sweep->listed[rows[k]]) {
+      sweep->listed[rows[k]] = 1;
+      sweep->order[kept++] = rows[k];
+    }
+  }
+  sweep->count = kept;
+
+  // Insertion sort: near-linear on last step's order. Ties go by row, so
+  // the order depends only on the current positions, not on its history.
+  for (size_t i = 0; i < sweep->count; i++) {
+    uint32_t row = sweep->order[i];
+    float key = bodies->x[row] - bodies->radius[row];
+    size_t j = i;
+    while (j > 0 && (sweep->min_x[j - 1] > key ||
+                     (sweep->min_x[j - 1] == key && sweep->order[j - 1] > row))) {
+      sweep->order[j] = sweep->order[j - 1];
+      sweep->min_x[j] = sweep->min_x[j - 1];
+      j--;
+    }
+    sweep->order[j] = row;
+    sweep->min_x[j] = key;
+  }
+  return true;
+}
+
+// Walks the awake rows by left edge; each is tested against the following
+// rows until their left edge passes its right edge
+static void physics_sweep_collide(PhysicsWorld *world,
+                                  PhysicsContactList *contacts) {
+  PhysicsBodies *bodies = &world->bodies;
+  PhysicsSweep *sweep = &world->sweep;
+  if (!physics_sweep_update(sweep, bodies, world->awake_rows,
+                            world->awake_count)) {
+    return;
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_BROADPHASE);
+  uint64_t salt = physics_contact_salt(world);
+
+  for (size_t i = 0; i < sweep->count; i++) {
+    uint32_t first = sweep->order[i];
+    float max_x = sweep->min_x[i] + 2.0f * bodies->radius[first];
+    for (size_t j = i + 1; j < sweep->count && sweep->min_x[j] <= max_x; j++) {
+      uint32_t second = sweep->order[j];
+      // Lower row first, as the grid passes them
+      uint32_t a = first < second ? first : second;
+      uint32_t b = first < second ? second : first;
+      float reach = bodies->radius[a] + bodies->radius[b];
+      if (fabsf(bodies->y[a] - bodies->y[b]) >= reach) {
+        continue;
+      }
+
+      Vec3 normal;
+      float penetration;
+      if (physics_contact_rows(bodies, a, b, salt, &normal, &penetration)) {
+        physics_resolve_bodies(bodies, a, b, normal.x, normal.y, penetration);
+        if (contacts) {
+          physics_record_contact(contacts, a, b);
+        }
+      }
+    }
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_NARROWPHASE);
+}
+
+static bool physics_circle_overlaps_box(float x, float y, float radius,
+                                        Aabb box) {
+  float nearest_x = x < box.min_x ? box.min_x : (x > box.max_x ? box.max_x : x);
+  float nearest_y = y < box.min_y ? box.min_y : (y > box.max_y ? box.max_y : y);
+  float dx = x - nearest_x;
+  float dy = y - nearest_y;
+  return dx * dx + dy * dy <= radius * radius;
+}
+
+// Dynamic AABB tree broadphase. Leaves persist across steps through
+// VerletBody.tree_proxy. After a full sync every leaf is moved to its row's
+// current box and relabelled with the row, and leaves no row claims belong
+// to removed bodies and are dropped; otherwise rows stay put and only the
+// rows this step touched can have moved. Candidate pairs come from
+// overlapping fattened leaves, so they stay complete until a leaf is
+// reinserted: they are built once per step, and after that only the pairs
+// of reinserted rows are queried again.
+
+// Per-pass scratch, carved from the spatial arena
+typedef struct {
+  uint8_t *claimed; // Per tree node: a row owns the leaf (full sync only)
+  size_t claimed_count;
+  uint32_t *found;  // Query results
+} PhysicsTreeScratch;
+
+static Aabb physics_row_box(const PhysicsBodies *bodies, size_t row) {
+  return (Aabb){bodies->x[row] - bodies->radius[row],
+                bodies->y[row] - bodies->radius[row],
+                bodies->x[row] + bodies->radius[row],
+                bodies->y[row] + bodies->radius[row]};
+}
+
+// Returns the number of reinserted rows (flagged in world->tree_moved), or
+// -1 on failure. Inserts and removals mark every pair stale.
+static long physics_tree_sync(PhysicsWorld *world,
+                              const PhysicsTreeScratch *scratch) {
+  PhysicsBodies *bodies = &world->bodies;
+  AabbTree *tree = &world->body_tree;
+  long moved = 0;
+  if (!world->tree_full_sync) {
+    for (size_t k = 0; k < world->written_count; k++) {
+      uint32_t row = world->written_rows[k];
+      if (aabb_tree_move(tree, bodies->tree_proxy[row],
+                         physics_row_box(bodies, row))) {
+        world->tree_moved[row] = 1;
+        moved++;
+      }
+    }
+    return moved;
+  }
+
+  memset(scratch->claimed, 0, scratch->claimed_count);
+  for (size_t row = 0; row < bodies->count; row++) {
+    Aabb box = physics_row_box(bodies, row);
+    uint32_t proxy = bodies->tree_proxy[row];
+    // A copied VerletBody can share a proxy; the second row gets its own
+    if (aabb_tree_is_leaf(tree, proxy) && !scratch->claimed[proxy]) {
+      if (aabb_tree_move(tree, proxy, box)) {
+        world->tree_moved[row] = 1;
+        moved++;
+      }
+    } else {
+      proxy = aabb_tree_insert(tree, box, (uint32_t)row);
+      if (proxy == AABB_TREE_NULL) {
+        return -1;
+      }
+      world->tree_pairs_stale = true;
+    }
+    tree->nodes[proxy].user = (uint32_t)row;
+    scratch->claimed[proxy] = 1;
+    bodies->tree_proxy[row] = proxy;
+  }
+
+  if (tree->leaf_count != bodies->count) {
+    for (uint32_t proxy = 1;
+         proxy < tree->capacity && proxy < scratch->claimed_count; proxy++) {
+      if (aabb_tree_is_leaf(tree, proxy) && !scratch->claimed[proxy]) {
+        aabb_tree_remove(tree, proxy);
+        world->tree_pairs_stale = true;
+      }
+    }
+  }
+  world->tree_full_sync = false;
+  world->scatter_all = true; // Any row's proxy may have changed
+  return moved;
+}
+
+// Clears the flags the last sync set
+static void physics_tree_clear_moved(PhysicsWorld *world, bool full) {
+  if (full) {
+    memset(world->tree_moved, 0, world->bodies.count);
+    return;
+  }
+  for (size_t k = 0; k < world->written_count; k++) {
+    world->tree_moved[world->written_rows[k]] = 0;
+  }
+}
+
+// Adds the pairs of awake row a. A full rebuild takes only later rows; an
+// incremental one takes every row except earlier reinserted ones, whose own
+// query already added the pair
+static void physics_tree_query_pairs(PhysicsWorld *world,
+                                     const PhysicsTreeScratch *scratch,
+                                     uint32_t a, bool incremental) {
+  const PhysicsBodies *bodies = &world->bodies;
+  const AabbTree *tree = &world->body_tree;
+  Aabb box = tree->nodes[bodies->tree_proxy[a]].box;
+  size_t count = aabb_tree_query(tree, box, scratch->found, bodies->count);
+  for (size_t k = 0; k < count; k++) {
+    uint32_t b = scratch->found[k];
+    if (b == a || bodies->sleeping[b]) {
+      continue;
+    }
+    if (incremental ? (world->tree_moved[b] && b < a) : b < a) {
+      continue; // Each pair once
+    }
+    physics_record_contact(&world->tree_pairs, a < b ? a : b, a < b ? b : a);
+  }
+}
+
+static void physics_tree_pairs(PhysicsWorld *world,
+                               const PhysicsTreeScratch *scratch,
+                               bool incremental) {
+  PhysicsContactList *pairs = &world->tree_pairs;
+  const uint8_t *moved = world->tree_moved;
+  if (incremental) {
+    // Keep the pairs between leaves that stayed put
+    size_t kept = 0;
+    for (size_t p = 0; p < pairs->count; p++) {
+      uint32_t a = pairs->pairs[p * 2];
+      uint32_t b = pairs->pairs[p * 2 + 1];
+      if (!moved[a] && !moved[b]) {
+        pairs->pairs[kept * 2] = a;
+        pairs->pairs[kept * 2 + 1] = b;
+        kept++;
+      }
+    }
+    pairs->count = kept;
+  } else {
+    pairs->count = 0;
+  }
+
+  for (size_t k = 0; k < world->awake_count; k++) {
+    uint32_t a = world->awake_rows[k];
+    if (!incremental || moved[a]) {
+      physics_tree_query_pairs(world, scratch, a, incremental);
+    }
+  }
+  world->tree_pairs_stale = false;
+}
+
+static int physics_compare_pair_keys(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Deterministic mode: which fattened leaves overlap depends on when each
+// was last reinserted, so a pass could resolve a pair one history found and
+// another didn't. Keep just the pairs whose tight boxes overlap, in row
+// order, which depends on the current positions alone (as the grid and
+// sweep passes do). Returns row pairs in the spatial arena (pairs must not
+// be empty).
+static const uint32_t *physics_tree_stable_pairs(PhysicsWorld *world,
+                                                 size_t *count) {
+  const PhysicsBodies *bodies = &world->bodies;
+  const PhysicsContactList *pairs = &world->tree_pairs;
+  size_t bytes = pairs->count * sizeof(uint64_t);
+  uint64_t *keys = (uint64_t *)arena_alloc(&world->spatial_arena, bytes);
+  if (!keys) {
+    fprintf(stderr, "Failed to allocate stable tree pairs (%zu bytes)\n", bytes);
+    return NULL;
+  }
+
+  size_t kept = 0;
+  for (size_t p = 0; p < pairs->count; p++) {
+    uint32_t a = pairs->pairs[p * 2];
+    uint32_t b = pairs->pairs[p * 2 + 1];
+    float reach = bodies->radius[a] + bodies->radius[b];
+    if (fabsf(bodies->x[a] - bodies->x[b]) < reach &&
+        fabsf(bodies->y[a] - bodies->y[b]) < reach) {
+      keys[kept++] = (uint64_t)a << 32 | b;
+    }
+  }
+  qsort(keys, kept, sizeof(uint64_t), physics_compare_pair_keys);
+
+  // Unpack in place: pair p's two rows fit in key p's slot
+  uint32_t *rows = (uint32_t *)keys;
+  for (size_t p = 0; p < kept; p++) {
+    uint64_t key = keys[p];
+    rows[p * 2] = (uint32_t)(key >> 32);
+    rows[p * 2 + 1] = (uint32_t)key;
+  }
+  *count = kept;
+  return rows;
+}
+
+static void physics_tree_collide(PhysicsWorld *world,
+                                 PhysicsContactList *contacts) {
+  PhysicsBodies *bodies = &world->bodies;
+  if (bodies->count == 0) {
+    return; // Leaves of removed bodies go at the next sync with bodies
+  }
+
+  // Inserts take at most two nodes each, so no proxy reaches claimed_count
+  PhysicsTreeScratch scratch = {0}; // ZII
+  bool full = world->tree_full_sync;
+  scratch.claimed_count =
+      full ? (size_t)world->body_tree.capacity + 2 * bodies->count + 1 : 0;
+  size_t needed = scratch.claimed_count + bodies->count * sizeof(uint32_t) +
+                  2 * ARENA_ALIGNMENT;
+  if (full) {
+    scratch.claimed =
+        (uint8_t *)arena_alloc(&world->spatial_arena, scratch.claimed_count);
+  }
+  scratch.found = (uint32_t *)arena_alloc(&world->spatial_arena,
+                                          bodies->count * sizeof(uint32_t));
+  if ((full && !scratch.claimed) || !scratch.found) {
+    fprintf(stderr, "Failed to allocate body tree scratch (%zu bytes)\n", needed);
+    return;
+  }
+
+  long moved = physics_tree_sync(world, &scratch);
+  if (moved < 0) {
+    physics_tree_clear_moved(world, full);
+    return;
+  }
+  if (world->tree_pairs_stale || moved > 0) {
+    physics_tree_pairs(world, &scratch, !world->tree_pairs_stale);
+  }
+  if (moved > 0) {
+    physics_tree_clear_moved(world, full);
+  }
+
+  uint64_t salt = physics_contact_salt(world);
+  const uint32_t *pairs = world->tree_pairs.pairs;
+  size_t pair_count = world->tree_pairs.count;
+  if (world->deterministic && pair_count > 0) {
+    pairs = physics_tree_stable_pairs(world, &pair_count);
+    if (!pairs) {
+      world->determinism_lost = true; // This pass resolved nothing
+      return;
+    }
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_BROADPHASE);
+
+  for (size_t p = 0; p < pair_count; p++) {
+    uint32_t a = pairs[p * 2];
+    uint32_t b = pairs[p * 2 + 1];
+    Vec3 normal;
+    float penetration;
+    if (physics_contact_rows(bodies, a, b, salt, &normal, &penetration)) {
+      physics_resolve_bodies(bodies, a, b, normal.x, normal.y, penetration);
+      if (contacts) {
+        physics_record_contact(contacts, a, b);
+      }
+    }
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_NARROWPHASE);
+}
+
+static void physics_collide_bodies(PhysicsWorld *world, bool record_contacts) {
+  PhysicsBodies *bodies = &world->bodies;
+
+  // Reset arena for this pass's grid arrays
+  arena_reset(&world->spatial_arena);
+
+#ifdef DEBUG
+  // Track arena usage and sleeping objects for debugging
+  static int frame_count = 0;
+  if (frame_count == 0) {
+    ArenaStats stats = {0};
+    arena_get_stats(&world->spatial_arena, &stats);
+    printf("Spatial arena initialized: Size: %zu KB\n",
+           stats.total_size / 1024);
+  }
+
+  // Count sleeping objects every 300 frames (5 seconds at 60fps)
+  if (frame_count % 300 == 0 && frame_count > 0) {
+    int total_count = (int)bodies->count;
+    int sleeping_count = total_count - (int)world->awake_count;
+    printf("Frame %d: %d/%d objects sleeping (%.1f%%)\n", frame_count,
+           sleeping_count, total_count,
+           total_count > 0 ? (float)sleeping_count / total_count * 100.0f
+                           : 0.0f);
+  }
+
+  frame_count++;
+#endif
+
+  if (world->broadphase == PHYSICS_BROADPHASE_SWEEP) {
+    physics_sweep_collide(world, record_contacts ? &world->contacts[0] : NULL);
+    return;
+  }
+  if (world->broadphase == PHYSICS_BROADPHASE_TREE) {
+    physics_tree_collide(world, record_contacts ? &world->contacts[0] : NULL);
+    return;
+  }
+
+  // The grid holds just the awake rows (sleepers have their own bins), and
+  // the passes walk only its occupied cells, so nothing here scales with the
+  // grid's area
+  uint64_t salt = physics_contact_salt(world);
+  SpatialGrid *grid = &world->spatial_grid;
+  if (!spatial_grid_build_rows(grid, &world->spatial_arena,
+                               &world->awake_cells, bodies->x, bodies->y,
+                               bodies->radius, world->awake_rows,
+                               world->awake_count)) {
+    return;
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_BROADPHASE);
+
+  if (world->collision_solver == PHYSICS_SOLVER_SERIAL) {
+    for (size_t i = 0; i < grid->occupied_count; i++) {
+      uint32_t cell = grid->occupied[i];
+      physics_collide_cell(bodies, grid,
+                           record_contacts ? &world->contacts[0] : NULL, salt,
+                           (int)(cell % (uint32_t)grid->grid_width),
+                           (int)(cell / (uint32_t)grid->grid_width));
+    }
+    physics_profile_phase(world, PHYSICS_PHASE_NARROWPHASE);
+    return;
+  }
+
+  // A cell touches bodies up to `reach` cells away, so two cells at least
+  // 2 * reach + 1 apart on either axis never share a body. Counting sort the
+  // occupied cells by colour, keeping them ascending within each.
+  int period = 2 * grid->reach + 1;
+  size_t colors = (size_t)period * (size_t)period;
+  uint32_t *color_start = (uint32_t *)arena_alloc(
+      &world->spatial_arena, (colors + 1) * sizeof(uint32_t));
+  uint32_t *color_cells = (uint32_t *)arena_alloc(
+      &world->spatial_arena, (grid->occupied_count + 1) * sizeof(uint32_t));
+  if (!color_start || !color_cells) {
+    fprintf(stderr, "Failed to allocate cell colours (%zu cells)\n",
+            grid->occupied_count);
+    return;
+  }
+  memset(color_start, 0, (colors + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < grid->occupied_count; i++) {
+    uint32_t cx = grid->occupied[i] % (uint32_t)grid->grid_width;
+    uint32_t cy = grid->occupied[i] / (uint32_t)grid->grid_width;
+    color_start[(cy % period) * period + cx % period + 1]++;
+  }
+  for (size_t c = 0; c < colors; c++) {
+    color_start[c + 1] += color_start[c];
+  }
+  for (size_t i = 0; i < grid->occupied_count; i++) {
+    uint32_t cx = grid->occupied[i] % (uint32_t)grid->grid_width;
+    uint32_t cy = grid->occupied[i] / (uint32_t)grid->grid_width;
+    color_cells[color_start[(cy % period) * period + cx % period]++] =
+        grid->occupied[i];
+  }
+
+  PhysicsCollideJob job = {0}; // ZII
+  job.bodies = bodies;
+  job.grid = grid;
+  job.contacts = record_contacts ? world->contacts : NULL;
+  job.salt = salt;
+  uint32_t begin = 0;
+  for (size_t c = 0; c < colors; c++) {
+    // The scatter left color_start[c] at the colour's end
+    uint32_t end = color_start[c];
+    if (end > begin) {
+      job.cells = color_cells + begin;
+      thread_pool_run(world->ecs->thread_pool, end - begin,
+                      physics_collide_task, &job);
+    }
+    begin = end;
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_NARROWPHASE);
+}
+
+// Island sleeping. Bodies touching in the last collision pass of a step form
+// an island (union-find over the awake rows). An island sleeps once every
+// member has been slow for PHYSICS_SLEEP_TIME_THRESHOLD steps, and waking
+// any member wakes them all. Sleepers leave the awake list and go into
+// persistent bins (PhysicsSleepers), where each island's rows form a ring;
+// they also share an island id, which is how the rings are rebuilt after a
+// full sync.
+
+static void physics_sleepers_insert(PhysicsWorld *world, uint32_t row) {
+  PhysicsSleepers *sleepers = &world->sleepers;
+  const PhysicsBodies *bodies = &world->bodies;
+  int cell_x, cell_y;
+  spatial_grid_cell_coords(&world->spatial_grid, bodies->x[row], bodies->y[row],
+                           &cell_x, &cell_y);
+  uint32_t cell = (uint32_t)(cell_y * world->spatial_grid.grid_width + cell_x);
+  uint32_t head = sleepers->cell_head[cell];
+  sleepers->next[row] = head;
+  sleepers->prev[row] = PHYSICS_NO_ROW;
+  if (head != PHYSICS_NO_ROW) {
+    sleepers->prev[head] = row;
+  }
+  sleepers->cell_head[cell] = row;
+  sleepers->cell[row] = cell;
+  sleepers->count++;
+  if (bodies->radius[row] > sleepers->max_radius) {
+    sleepers->max_radius = bodies->radius[row];
+  }
+}
+
+static void physics_sleepers_remove(PhysicsSleepers *sleepers, uint32_t row) {
+  uint32_t prev = sleepers->prev[row];
+  uint32_t next = sleepers->next[row];
+  if (prev != PHYSICS_NO_ROW) {
+    sleepers->next[prev] = next;
+  } else {
+    sleepers->cell_head[sleepers->cell[row]] = next;
+  }
+  if (next != PHYSICS_NO_ROW) {
+    sleepers->prev[next] = prev;
+  }
+  sleepers->cell[row] = PHYSICS_NO_ROW;
+  sleepers->count--;
+}
+
+// Bins every sleeping row and every row still carrying an island id (one
+// whose game code woke it), ringing rows by island id. Island 0 sleepers
+// are rings of one. Runs after a full gather.
+static bool physics_sleepers_rebuild(PhysicsWorld *world) {
+  PhysicsSleepers *sleepers = &world->sleepers;
+  const PhysicsBodies *bodies = &world->bodies;
+  size_t cell_count = (size_t)world->spatial_grid.grid_width *
+                      (size_t)world->spatial_grid.grid_height;
+  if (cell_count != sleepers->cell_count) {
+    uint32_t *heads = (uint32_t *)realloc(sleepers->cell_head,
+                                          cell_count * sizeof(uint32_t));
+    if (!heads) {
+      fprintf(stderr, "Failed to allocate sleeper bins (%zu cells)\n",
+              cell_count);
+      return false;
+    }
+    sleepers->cell_head = heads;
+    sleepers->cell_count = cell_count;
+  }
+  memset(sleepers->cell_head, 0xFF, cell_count * sizeof(uint32_t));
+  sleepers->count = 0;
+  sleepers->max_radius = 0.0f;
+
+  // First row seen of each island id (open addressing, at most half full)
+  size_t slots = 16;
+  while (slots < bodies->count * 2) {
+    slots *= 2;
+  }
+  Arena *arena = &world->spatial_arena;
+  arena_reset(arena);
+  uint32_t *ids = (uint32_t *)arena_alloc(arena, slots * sizeof(uint32_t));
+  uint32_t *firsts = (uint32_t *)arena_alloc(arena, slots * sizeof(uint32_t));
+  if (!ids || !firsts) {
+    fprintf(stderr, "Failed to allocate island table (%zu slots)\n", slots);
+    return false;
+  }
+  memset(ids, 0, slots * sizeof(uint32_t)); // PHYSICS_NO_ISLAND = empty
+
+  for (size_t i = 0; i < bodies->count; i++) {
+    uint32_t row = (uint32_t)i;
+    uint32_t island = bodies->island[row];
+    sleepers->cell[row] = PHYSICS_NO_ROW;
+    sleepers->island_next[row] = row;
+    if (!bodies->sleeping[row] && island == PHYSICS_NO_ISLAND) {
+      continue;
+    }
+    physics_sleepers_insert(world, row);
+    if (island == PHYSICS_NO_ISLAND) {
+      continue;
+    }
+    size_t slot = (size_t)physics_mix64(island) & (slots - 1);
+    while (ids[slot] != island && ids[slot] != PHYSICS_NO_ISLAND) {
+      slot = (slot + 1) & (slots - 1);
+    }
+    if (ids[slot] == PHYSICS_NO_ISLAND) {
+      ids[slot] = island;
+      firsts[slot] = row;
+    } else {
+      sleepers->island_next[row] = sleepers->island_next[firsts[slot]];
+      sleepers->island_next[firsts[slot]] = row;
+    }
+  }
+  return true;
+}
+
+// Wakes the island of binned row: every member leaves the bins, and the
+// ones asleep join the awake rows and the rows to write back
+static void physics_wake_island(PhysicsWorld *world, uint32_t row) {
+  PhysicsSleepers *sleepers = &world->sleepers;
+  PhysicsBodies *bodies = &world->bodies;
+  uint32_t member = row;
+  do {
+    uint32_t next = sleepers->island_next[member];
+    physics_sleepers_remove(sleepers, member);
+    if (bodies->sleeping[member]) {
+      bodies->sleeping[member] = 0;
+      bodies->sleep_timer[member] = 0;
+      world->awake_rows[world->awake_count++] = member;
+      physics_mark_written(world, member);
+    }
+    bodies->island[member] = PHYSICS_NO_ISLAND;
+    sleepers->island_next[member] = member;
+    member = next;
+  } while (member != row);
+}
+
+// Wakes every island with a member that woke by itself (integration, or game
+// code clearing is_sleeping) or that an awake body now overlaps, and leaves
+// just the awake rows in the awake list. Returns the number of awake bodies.
+static size_t physics_wake_islands(PhysicsWorld *world) {
+  PhysicsBodies *bodies = &world->bodies;
+  PhysicsSleepers *sleepers = &world->sleepers;
+  const SpatialGrid *grid = &world->spatial_grid;
+  uint32_t *rows = world->awake_rows;
+
+  // Binned rows in the list are sleepers read back this step: the ones
+  // still asleep are rebinned (they may have been moved), and rows that
+  // were just put to sleep by game code are binned on their own
+  size_t awake = 0;
+  for (size_t k = 0; k < world->awake_count; k++) {
+    uint32_t row = rows[k];
+    if (!bodies->sleeping[row]) {
+      rows[awake++] = row;
+      continue;
+    }
+    if (sleepers->cell[row] != PHYSICS_NO_ROW) {
+      physics_sleepers_remove(sleepers, row);
+    } else {
+      sleepers->island_next[row] = row;
+    }
+    physics_sleepers_insert(world, row);
+  }
+  world->awake_count = awake;
+  for (size_t k = 0; k < awake; k++) {
+    if (sleepers->cell[rows[k]] != PHYSICS_NO_ROW) {
+      physics_wake_island(world, rows[k]);
+    }
+  }
+
+  // Bodies awake before islands woke look for sleepers they run into
+  Arena *arena = &world->spatial_arena;
+  arena_reset(arena);
+  uint32_t *found = NULL;
+  if (awake > 0 && sleepers->count > 0) {
+    found = (uint32_t *)arena_alloc(arena, sleepers->count * sizeof(uint32_t));
+    if (!found) {
+      fprintf(stderr, "Failed to allocate island wake list (%zu bodies)\n",
+              sleepers->count);
+    }
+  }
+  for (size_t k = 0; found && k < awake && sleepers->count > 0; k++) {
+    uint32_t a = rows[k];
+    float extent = bodies->radius[a] + sleepers->max_radius;
+    int min_x, min_y, max_x, max_y;
+    spatial_grid_cell_coords(grid, bodies->x[a] - extent,
+                             bodies->y[a] - extent, &min_x, &min_y);
+    spatial_grid_cell_coords(grid, bodies->x[a] + extent,
+                             bodies->y[a] + extent, &max_x, &max_y);
+    size_t hits = 0;
+    for (int cy = min_y; cy <= max_y; cy++) {
+      for (int cx = min_x; cx <= max_x; cx++) {
+        uint32_t b = sleepers->cell_head[(size_t)cy * grid->grid_width + cx];
+        for (; b != PHYSICS_NO_ROW; b = sleepers->next[b]) {
+          float dx = bodies->x[b] - bodies->x[a];
+          float dy = bodies->y[b] - bodies->y[a];
+          float reach = bodies->radius[a] + bodies->radius[b];
+          if (dx * dx + dy * dy < reach * reach) {
+            found[hits++] = b;
+          }
+        }
+      }
+    }
+    for (size_t h = 0; h < hits; h++) {
+      if (sleepers->cell[found[h]] != PHYSICS_NO_ROW) {
+        physics_wake_island(world, found[h]);
+      }
+    }
+  }
+
+  if (world->awake_count > awake) {
+    qsort(rows, world->awake_count, sizeof(uint32_t), physics_compare_rows);
+  }
+  return world->awake_count;
+}
+
+static uint32_t physics_island_find(uint32_t *parent, uint32_t row) {
+  while (parent[row] != row) {
+    parent[row] = parent[parent[row]]; // Path halving
+    row = parent[row];
+  }
+  return row;
+}
+
+// Joins each recorded contact's islands, then puts to sleep every island whose
+// members have all been slow long enough. A body falls asleep at rest (its
+// old position is its position), so a sleeper left alone stays as it is.
+static void physics_sleep_islands(PhysicsWorld *world) {
+  PhysicsBodies *bodies = &world->bodies;
+  uint32_t *rows = world->awake_rows;
+  size_t count = world->awake_count;
+  Arena *arena = &world->spatial_arena;
+
+  // Union-find over positions in the awake list; contacts name rows
+  arena_reset(arena);
+  uint32_t *position =
+      (uint32_t *)arena_alloc(arena, bodies->count * sizeof(uint32_t));
+  uint32_t *parent = (uint32_t *)arena_alloc(arena, count * sizeof(uint32_t));
+  uint32_t *state = (uint32_t *)arena_alloc(arena, count * sizeof(uint32_t));
+  uint32_t *first = (uint32_t *)arena_alloc(arena, count * sizeof(uint32_t));
+  if (!position || !parent || !state || !first) {
+    fprintf(stderr, "Failed to allocate island arrays (%zu bodies)\n", count);
+    return;
+  }
+
+  for (size_t k = 0; k < count; k++) {
+    position[rows[k]] = (uint32_t)k;
+    parent[k] = (uint32_t)k;
+    state[k] = UINT32_MAX; // Ready until a slow-timer says otherwise
+  }
+  for (size_t w = 0; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    const PhysicsContactList *list = &world->contacts[w];
+    for (size_t c = 0; c < list->count; c++) {
+      uint32_t a = physics_island_find(parent, position[list->pairs[c * 2]]);
+      uint32_t b =
+          physics_island_find(parent, position[list->pairs[c * 2 + 1]]);
+      if (a != b) {
+        // Lower row becomes the root so the result doesn't depend on the
+        // order workers recorded contacts in
+        if (a < b) {
+          parent[b] = a;
+        } else {
+          parent[a] = b;
+        }
+      }
+    }
+  }
+
+  for (size_t k = 0; k < count; k++) {
+    uint32_t row = rows[k];
+    if (bodies->sleep_timer[row] >= PHYSICS_SLEEP_TIME_THRESHOLD) {
+      bodies->sleep_timer[row] = PHYSICS_SLEEP_TIME_THRESHOLD; // No overflow
+    } else {
+      state[physics_island_find(parent, (uint32_t)k)] = 0;
+    }
+  }
+
+  // state[root]: 0 = stays awake, UINT32_MAX = sleeps, else its new island
+  // id (and first[root] its first row, where the others join the ring)
+  PhysicsSleepers *sleepers = &world->sleepers;
+  size_t kept = 0;
+  for (size_t k = 0; k < count; k++) {
+    uint32_t row = rows[k];
+    uint32_t root = physics_island_find(parent, (uint32_t)k);
+    if (state[root] == 0) {
+      rows[kept++] = row;
+      continue;
+    }
+    if (state[root] == UINT32_MAX) {
+      do {
+        world->next_island++;
+      } while (world->next_island == PHYSICS_NO_ISLAND ||
+               world->next_island == UINT32_MAX);
+      state[root] = world->next_island;
+      first[root] = row;
+      sleepers->island_next[row] = row;
+    } else {
+      sleepers->island_next[row] = sleepers->island_next[first[root]];
+      sleepers->island_next[first[root]] = row;
+    }
+    bodies->sleeping[row] = 1;
+    bodies->island[row] = state[root];
+    bodies->vx[row] = 0.0f;
+    bodies->vy[row] = 0.0f;
+    bodies->ax[row] = 0.0f;
+    bodies->ay[row] = 0.0f;
+    bodies->old_x[row] = bodies->x[row];
+    bodies->old_y[row] = bodies->y[row];
+    physics_sleepers_insert(world, row);
+  }
+  world->awake_count = kept; // The sleepers are already listed to write back
+}
+
+// Contact cache and warm starting. Position corrections push overlapping
+// bodies apart, and Verlet turns that push into velocity, so a resting pile
+// keeps bouncing on its contacts unless many passes shrink the overlap
+// first. Pairs still overlapping at the end of a step are kept in a table
+// keyed by entity pair; a pair that was already there last step with about
+// the same normal is resting, and warm_start of its separating motion is
+// taken back out (by moving old positions, so only velocity changes).
+// Bodies resting against the boundary get the same treatment.
+
+static uint64_t physics_contact_key(uint32_t entity_a, uint32_t entity_b) {
+  return entity_a < entity_b ? ((uint64_t)entity_a << 32) | entity_b
+                             : ((uint64_t)entity_b << 32) | entity_a;
+}
+
+// Finds the key's slot, or the empty slot it would go in
+static PhysicsContactEntry *physics_contact_slot(const PhysicsContactCache *cache,
+                                                 uint64_t key) {
+  // Mix the bits so neighbouring entity ids spread across the table
+  uint64_t hash = key;
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  size_t mask = cache->capacity - 1;
+  size_t slot = (size_t)hash & mask;
+  while (cache->entries[slot].key != key && cache->entries[slot].key != 0) {
+    slot = (slot + 1) & mask;
+  }
+  return &cache->entries[slot];
+}
+
+// Removes share of the separating displacement between rows a and b along
+// the normal (from a towards b), split by inverse mass
+static void physics_settle_contact(PhysicsBodies *bodies, uint32_t a,
+                                   uint32_t b, float normal_x, float normal_y,
+                                   float share) {
+  float total_inv_mass = bodies->inv_mass[a] + bodies->inv_mass[b];
+  if (total_inv_mass <= 0.0f) {
+    return;
+  }
+  float separating =
+      ((bodies->x[b] - bodies->old_x[b]) - (bodies->x[a] - bodies->old_x[a])) *
+          normal_x +
+      ((bodies->y[b] - bodies->old_y[b]) - (bodies->y[a] - bodies->old_y[a])) *
+          normal_y;
+  if (separating <= 0.0f) {
+    return; // Closing: leave it to the next step's correction
+  }
+  float removed = separating * share;
+  float ratio_a = bodies->inv_mass[a] / total_inv_mass;
+  float ratio_b = bodies->inv_mass[b] / total_inv_mass;
+  bodies->old_x[a] -= normal_x * removed * ratio_a;
+  bodies->old_y[a] -= normal_y * removed * ratio_a;
+  bodies->old_x[b] += normal_x * removed * ratio_b;
+  bodies->old_y[b] += normal_y * removed * ratio_b;
+}
+
+// A body touching the boundary at both ends of the step is resting on it
+static void physics_settle_boundary(PhysicsWorld *world) {
+  PhysicsBodies *bodies = &world->bodies;
+  float center_x = world->boundary_center.x;
+  float center_y = world->boundary_center.y;
+  for (size_t k = 0; k < world->awake_count; k++) {
+    uint32_t i = world->awake_rows[k];
+    if (bodies->inv_mass[i] <= 0.0f) {
+      continue;
+    }
+    float limit = world->boundary_radius - bodies->radius[i] -
+                  PHYSICS_BOUNDARY_CONTACT_SLOP;
+    float dx = bodies->x[i] - center_x;
+    float dy = bodies->y[i] - center_y;
+    float old_dx = bodies->old_x[i] - center_x;
+    float old_dy = bodies->old_y[i] - center_y;
+    float distance_sq = dx * dx + dy * dy;
+    if (limit <= 0.0f || distance_sq < limit * limit ||
+        old_dx * old_dx + old_dy * old_dy < limit * limit) {
+      continue;
+    }
+    float distance = sqrtf(distance_sq);
+    float normal_x = dx / distance;
+    float normal_y = dy / distance;
+    float inward = (bodies->old_x[i] - bodies->x[i]) * normal_x +
+                   (bodies->old_y[i] - bodies->y[i]) * normal_y;
+    if (inward > 0.0f) {
+      bodies->old_x[i] -= normal_x * inward * world->warm_start;
+      bodies->old_y[i] -= normal_y * inward * world->warm_start;
+    }
+  }
+}
+
+// Fills the spare table with the pairs from the last pass that still
+// overlap, settles the ones that were resting, then makes it the current one
+static int physics_compare_pairs(const void *a, const void *b) {
+  const uint32_t *x = (const uint32_t *)a;
+  const uint32_t *y = (const uint32_t *)b;
+  if (x[0] != y[0]) {
+    return (x[0] > y[0]) - (x[0] < y[0]);
+  }
+  return (x[1] > y[1]) - (x[1] < y[1]);
+}
+
+// Deterministic mode: which worker recorded a contact depends on the thread
+// count, and the cache and islands visit contacts list by list. Moves every
+// list into the first one and sorts it by rows in place, so they see one
+// order. False if the first list can't grow to hold them all (left unmerged).
+static bool physics_merge_contacts(PhysicsWorld *world) {
+  PhysicsContactList *merged = &world->contacts[0];
+  size_t total = 0;
+  for (size_t w = 0; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    total += world->contacts[w].count;
+  }
+  if (total > merged->capacity) {
+    uint32_t *pairs =
+        (uint32_t *)realloc(merged->pairs, total * 2 * sizeof(uint32_t));
+    if (!pairs) {
+      fprintf(stderr, "Failed to grow contact merge (%zu pairs)\n", total);
+      return false;
+    }
+    merged->pairs = pairs;
+    merged->capacity = total;
+  }
+
+  for (size_t w = 1; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    PhysicsContactList *list = &world->contacts[w];
+    memcpy(merged->pairs + merged->count * 2, list->pairs,
+           list->count * 2 * sizeof(uint32_t));
+    merged->count += list->count;
+    list->count = 0;
+  }
+  qsort(merged->pairs, merged->count, 2 * sizeof(uint32_t), physics_compare_pairs);
+  size_t kept = 0;
+  for (size_t c = 0; c < merged->count; c++) {
+    uint32_t a = merged->pairs[c * 2];
+    uint32_t b = merged->pairs[c * 2 + 1];
+    if (kept == 0 || a != merged->pairs[kept * 2 - 2] || b != merged->pairs[kept * 2 - 1]) {
+      merged->pairs[kept * 2] = a;
+      merged->pairs[kept * 2 + 1] = b;
+      kept++;
+    }
+  }
+  merged->count = kept;
+  return true;
+}
+
+static void physics_cache_contacts(PhysicsWorld *world) {
+  PhysicsBodies *bodies = &world->bodies;
+  if (world->deterministic && !physics_merge_contacts(world)) {
+    world->determinism_lost = true;
+  }
+  const PhysicsContactCache *previous =
+      &world->contact_cache[world->contact_cache_read];
+  PhysicsContactCache *cache =
+      &world->contact_cache[1 - world->contact_cache_read];
+
+  size_t total = 0;
+  for (size_t w = 0; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    total += world->contacts[w].count;
+  }
+  size_t capacity = cache->capacity ? cache->capacity : 1024;
+  while (capacity < total * 2) {
+    capacity *= 2;
+  }
+  if (capacity != cache->capacity) {
+    PhysicsContactEntry *entries = (PhysicsContactEntry *)realloc(
+        cache->entries, capacity * sizeof(PhysicsContactEntry));
+    if (!entries) {
+      fprintf(stderr, "Failed to grow physics contact cache (%zu slots)\n",
+              capacity);
+      world->contact_cache[world->contact_cache_read].count = 0;
+      return; // Next step starts cold
+    }
+    cache->entries = entries;
+    cache->capacity = capacity;
+  }
+  memset(cache->entries, 0, cache->capacity * sizeof(PhysicsContactEntry));
+  cache->count = 0;
+
+  bool warm = world->warm_start > 0.0f && previous->count > 0;
+  for (size_t w = 0; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    const PhysicsContactList *list = &world->contacts[w];
+    for (size_t c = 0; c < list->count; c++) {
+      uint32_t a = list->pairs[c * 2];
+      uint32_t b = list->pairs[c * 2 + 1];
+      float dx = bodies->x[b] - bodies->x[a];
+      float dy = bodies->y[b] - bodies->y[a];
+      float distance = sqrtf(dx * dx + dy * dy);
+      if (distance <= 0.0f ||
+          distance >= bodies->radius[a] + bodies->radius[b]) {
+        continue; // Separated by the time the step ended
+      }
+      uint64_t key = physics_contact_key(bodies->entity[a], bodies->entity[b]);
+      PhysicsContactEntry *entry = physics_contact_slot(cache, key);
+      if (entry->key == key) {
+        continue; // Recorded by another worker as well
+      }
+      // Store the normal from the lower entity so it doesn't depend on rows
+      float normal_x = dx / distance;
+      float normal_y = dy / distance;
+      float sign = bodies->entity[a] < bodies->entity[b] ? 1.0f : -1.0f;
+      entry->key = key;
+      entry->normal_x = normal_x * sign;
+      entry->normal_y = normal_y * sign;
+      cache->count++;
+
+      if (warm) {
+        const PhysicsContactEntry *last = physics_contact_slot(previous, key);
+        if (last->key == key &&
+            last->normal_x * entry->normal_x + last->normal_y * entry->normal_y >=
+                PHYSICS_WARM_START_MIN_ALIGNMENT) {
+          physics_settle_contact(bodies, a, b, normal_x, normal_y,
+                                 world->warm_start);
+        }
+      }
+    }
+  }
+  if (world->warm_start > 0.0f) {
+    physics_settle_boundary(world);
+  }
+  world->contact_cache_read = 1 - world->contact_cache_read;
+}
+
+// Integrate, then iterate collisions and constraints on the awake rows of
+// the body store. Bodies only fall asleep as whole islands, so integration
+// just counts slow steps and the island passes decide.
+static void physics_step_bodies(PhysicsWorld *world, float delta_time) {
+  world->profile_mark = physics_profile_now(world);
+  physics_integrate_bodies(world, delta_time, INT32_MAX, world->awake_rows,
+                           world->awake_count);
+  physics_profile_phase(world, PHYSICS_PHASE_INTEGRATE);
+  world->tree_pairs_stale = true; // The awake rows may have changed
+  if (physics_wake_islands(world) == 0) {
+    // Everything is asleep: nothing to collide or constrain, and the cached
+    // contacts are stale by the time anything wakes
+    world->contact_cache[world->contact_cache_read].count = 0;
+    physics_profile_phase(world, PHYSICS_PHASE_ISLANDS);
+    return;
+  }
+  physics_profile_phase(world, PHYSICS_PHASE_ISLANDS);
+
+  for (size_t w = 0; w < THREAD_POOL_MAX_THREADS + 1; w++) {
+    world->contacts[w].count = 0;
+  }
+  for (int i = 0; i < world->collision_iterations; i++) {
+    physics_collide_bodies(world, i == world->collision_iterations - 1);
+    physics_constrain_bodies(world, world->awake_rows, world->awake_count);
+    physics_profile_phase(world, PHYSICS_PHASE_CONSTRAINTS);
+  }
+  physics_cache_contacts(world);
+  physics_sleep_islands(world);
+  physics_profile_phase(world, PHYSICS_PHASE_ISLANDS);
+}
+
+void physics_set_seed(PhysicsWorld *world, uint64_t seed) {
+  world->random_seed = seed;
+  world->step_count = 0;
+}
+
+static uint64_t physics_hash_words(uint64_t hash, const void *data,
+                                   size_t count) {
+  const uint32_t *words = (const uint32_t *)data;
+  for (size_t i = 0; i < count; i++) {
+    for (int byte = 0; byte < 4; byte++) {
+      hash ^= (words[i] >> (byte * 8)) & 0xFFu;
+      hash *= 0x100000001B3ull; // FNV-1a prime
+    }
+  }
+  return hash;
+}
+
+uint64_t physics_state_hash(const PhysicsWorld *world) {
+  const PhysicsBodies *bodies = &world->bodies;
+  uint64_t hash = 0xCBF29CE484222325ull; // FNV-1a offset basis
+  hash = physics_hash_words(hash, bodies->entity, bodies->count);
+  hash = physics_hash_words(hash, bodies->x, bodies->count);
+  hash = physics_hash_words(hash, bodies->y, bodies->count);
+  hash = physics_hash_words(hash, bodies->old_x, bodies->count);
+  hash = physics_hash_words(hash, bodies->old_y, bodies->count);
+  hash = physics_hash_words(hash, bodies->sleeping, bodies->count);
+  return hash;
+}
+
+static void physics_finish_step(PhysicsWorld *world) {
+  world->step_count++;
+  if (world->deterministic) {
+    world->state_hash = physics_state_hash(world);
+  }
+}
+
+// One frame on the body store: sync, step, then write back
+void physics_world_step(PhysicsWorld *world, float delta_time) {
+  memset(world->phase_seconds, 0, sizeof(world->phase_seconds));
+  if (!physics_sync(world)) {
+    return;
+  }
+
+  physics_step_bodies(world, delta_time);
+  physics_finish_step(world);
+  physics_write_back(world);
+}
+
+void physics_set_fixed_timestep(PhysicsWorld *world, float timestep,
+                                int max_substeps) {
+  world->fixed_timestep = timestep > 0.0f ? timestep : 0.0f;
+  world->max_substeps =
+      max_substeps > 0 ? max_substeps : PHYSICS_DEFAULT_MAX_SUBSTEPS;
+  world->accumulator = 0.0f;
+  world->interpolation_alpha = 1.0f;
+}
+
+// Keeps the frame's accelerations of the rows read back (the only ones that
+// can have any) for every substep (integration clears them), so forces act
+// over the whole frame as they would in one variable step. Returns the rows
+// held, the first entries of the written list.
+static size_t physics_hold_accelerations(PhysicsWorld *world) {
+  size_t count = world->written_count;
+  size_t needed = count * 2;
+  if (needed > world->held_capacity) {
+    float *held = (float *)realloc(world->held_acceleration,
+                                   needed * sizeof(float));
+    if (!held) {
+      fprintf(stderr, "Failed to allocate substep accelerations\n");
+      return 0;
+    }
+    world->held_acceleration = held;
+    world->held_capacity = needed;
+  }
+  for (size_t k = 0; k < count; k++) {
+    uint32_t row = world->written_rows[k];
+    world->held_acceleration[k * 2] = world->bodies.ax[row];
+    world->held_acceleration[k * 2 + 1] = world->bodies.ay[row];
+  }
+  return count;
+}
+
+// Bodies that fell asleep in an earlier substep stay asleep
+static void physics_restore_accelerations(PhysicsWorld *world, size_t held) {
+  for (size_t k = 0; k < held; k++) {
+    uint32_t row = world->written_rows[k];
+    if (!world->bodies.sleeping[row]) {
+      world->bodies.ax[row] = world->held_acceleration[k * 2];
+      world->bodies.ay[row] = world->held_acceleration[k * 2 + 1];
+    }
+  }
+}
+
+int physics_world_update(PhysicsWorld *world, float frame_time) {
+  memset(world->phase_seconds, 0, sizeof(world->phase_seconds));
+  if (world->fixed_timestep <= 0.0f) {
+    physics_world_step(world, frame_time);
+    world->interpolation_alpha = 1.0f;
+    return 1;
+  }
+
+  world->accumulator += frame_time > 0.0f ? frame_time : 0.0f;
+  int steps = (int)(world->accumulator / world->fixed_timestep);
+  int max_substeps =
+      world->max_substeps > 0 ? world->max_substeps : PHYSICS_DEFAULT_MAX_SUBSTEPS;
+  if (steps > max_substeps) {
+    // Drop the backlog rather than spend ever longer catching up
+    steps = max_substeps;
+    world->accumulator = (float)steps * world->fixed_timestep;
+  }
+  world->accumulator -= (float)steps * world->fixed_timestep;
+  world->interpolation_alpha = world->accumulator / world->fixed_timestep;
+
+  if (steps == 0 || !physics_sync(world)) {
+    return 0;
+  }
+
+  size_t held = steps > 1 ? physics_hold_accelerations(world) : 0;
+  for (int i = 0; i < steps; i++) {
+    if (i > 0) {
+      physics_restore_accelerations(world, held);
+    }
+    physics_step_bodies(world, world->fixed_timestep);
+    physics_finish_step(world);
+  }
+  physics_write_back(world);
+  return steps;
+}
+
+Vec3 physics_interpolated_position(const PhysicsWorld *world, Entity entity) {
+  const Transform *transform = (const Transform *)ecs_get_component(
+      world->ecs, entity, world->transform_type);
+  const VerletBody *verlet = (const VerletBody *)ecs_get_component(
+      world->ecs, entity, world->verlet_type);
+  if (!transform) {
+    return (Vec3){0};
+  }
+  if (!verlet) {
+    return transform->position;
+  }
+
+  float alpha = world->interpolation_alpha;
+  Vec3 previous = verlet->old_position;
+  return (Vec3){previous.x + (transform->position.x - previous.x) * alpha,
+                previous.y + (transform->position.y - previous.y) * alpha,
+                previous.z + (transform->position.z - previous.z) * alpha};
+}
+
+// Snapshots. The world keeps the rows of the last snapshot it took or
+// restored, as PhysicsSnapshotRow words; a delta stores a bit per row, and
+// for each changed row a mask of its changed words followed by those words.
+// Sleeping bodies don't change at all, so they cost one bit.
+
+// A row's changed words must fit one mask word
+typedef char physics_snapshot_row_fits_mask[PHYSICS_SNAPSHOT_ROW_WORDS <= 32 ? 1 : -1];
+
+#define PHYSICS_SNAPSHOT_WORD(member) \
+  (offsetof(PhysicsSnapshotRow, member) / sizeof(uint32_t))
+
+static bool physics_snapshot_reserve(PhysicsWorld *world, size_t count) {
+  if (count <= world->snapshot_capacity) {
+    return true;
+  }
+  uint32_t *words = (uint32_t *)realloc(
+      world->snapshot_words, count * sizeof(PhysicsSnapshotRow));
+  if (!words) {
+    fprintf(stderr, "Failed to grow snapshot rows (%zu bodies)\n", count);
+    return false;
+  }
+  world->snapshot_words = words;
+  world->snapshot_capacity = count;
+  return true;
+}
+
+// Copies a component's words into the held row. With out, changed words
+// are appended there and flagged in the returned mask from bit `first` on
+// (each word is written, and kept only if it changed, to avoid branches).
+static uint32_t physics_snapshot_words(uint32_t *held, const void *source,
+                                       size_t bytes, size_t first,
+                                       uint32_t **out) {
+  if (!out) {
+    memcpy(held, source, bytes);
+    return 0;
+  }
+  const char *from = (const char *)source;
+  uint32_t *cursor = *out;
+  uint32_t mask = 0;
+  for (size_t w = 0; w < bytes / sizeof(uint32_t); w++) {
+    uint32_t word;
+    memcpy(&word, from + w * sizeof(uint32_t), sizeof(uint32_t));
+    uint32_t changed = word != held[w];
+    mask |= changed << (first + w);
+    held[w] = word;
+    *cursor = word;
+    cursor += changed;
+  }
+  *out = cursor;
+  return mask;
+}
+
+// Copies the group's rows into the held rows. With bits, encodes the delta
+// from the previously held rows at *out and returns the changed row count.
+static size_t physics_snapshot_read(PhysicsWorld *world, uint32_t *bits,
+                                    uint32_t **out) {
+  size_t changed_rows = 0;
+  size_t base = 0;
+  size_t chunks = ecs_group_chunk_count(world->body_group);
+  for (size_t c = 0; c < chunks; c++) {
+    EcsChunk chunk;
+    if (!ecs_group_chunk(world->ecs, world->body_group, c, &chunk)) {
+      continue;
+    }
+    const Transform *transforms =
+        (const Transform *)chunk.components[world->transform_type];
+    const VerletBody *verlets =
+        (const VerletBody *)chunk.components[world->verlet_type];
+    const CircleCollider *colliders =
+        (const CircleCollider *)chunk.components[world->collider_type];
+    for (size_t i = 0; i < chunk.count; i++) {
+      size_t row = base + i;
+      uint32_t *held = world->snapshot_words + row * PHYSICS_SNAPSHOT_ROW_WORDS;
+      uint32_t *mask_slot = out ? (*out)++ : NULL;
+      uint32_t mask = 0;
+      mask |= physics_snapshot_words(held + PHYSICS_SNAPSHOT_WORD(entity),
+                                     &chunk.entities[i], sizeof(Entity),
+                                     PHYSICS_SNAPSHOT_WORD(entity), out);
+      mask |= physics_snapshot_words(held + PHYSICS_SNAPSHOT_WORD(transform),
+                                     &transforms[i], sizeof(Transform),
+                                     PHYSICS_SNAPSHOT_WORD(transform), out);
+      // Copied whole, padding included, so it compares stably
+      mask |= physics_snapshot_words(held + PHYSICS_SNAPSHOT_WORD(verlet),
+                                     &verlets[i], sizeof(VerletBody),
+                                     PHYSICS_SNAPSHOT_WORD(verlet), out);
+      mask |= physics_snapshot_words(held + PHYSICS_SNAPSHOT_WORD(collider),
+                                     &colliders[i], sizeof(CircleCollider),
+                                     PHYSICS_SNAPSHOT_WORD(collider), out);
+      if (!out) {
+        continue;
+      }
+      if (mask) {
+        *mask_slot = mask;
+        bits[row / 32] |= 1u << (row % 32);
+        changed_rows++;
+      } else {
+        *out = mask_slot; // Unchanged: drop the slot
+      }
+    }
+    base += chunk.count;
+  }
+  return out ? changed_rows : base;
+}
+
+// Brings the held rows to the snapshot's, replaying deltas from the nearest
+// full snapshot or the snapshot the rows already hold
+static bool physics_snapshot_decode(PhysicsWorld *world,
+                                    const PhysicsSnapshot *snapshot) {
+  if (snapshot->id == world->snapshot_rows_id) {
+    return true;
+  }
+  if (!physics_snapshot_reserve(world, snapshot->body_count)) {
+    return false;
+  }
+  const char *rows = (const char *)snapshot->data +
+                     snapshot->contact_count * sizeof(PhysicsContactEntry);
+  if (!snapshot->base) {
+    memcpy(world->snapshot_words, rows,
+           snapshot->body_count * sizeof(PhysicsSnapshotRow));
+  } else {
+    if (!physics_snapshot_decode(world, snapshot->base)) {
+      return false;
+    }
+    const uint32_t *bits = (const uint32_t *)rows;
+    const uint32_t *cursor = bits + (snapshot->body_count + 31) / 32;
+    for (size_t row = 0; row < snapshot->body_count; row++) {
+      if (!bits[row / 32]) {
+        row |= 31; // No changes in this word's rows
+        continue;
+      }
+      if (!(bits[row / 32] & (1u << (row % 32)))) {
+        continue;
+      }
+      uint32_t mask = *cursor++;
+      uint32_t *words = world->snapshot_words + row * PHYSICS_SNAPSHOT_ROW_WORDS;
+      // Reads one word ahead at most; the data keeps a spare word for it
+      for (size_t w = 0; w < PHYSICS_SNAPSHOT_ROW_WORDS; w++) {
+        uint32_t bit = (mask >> w) & 1u;
+        words[w] = bit ? *cursor : words[w];
+        cursor += bit;
+      }
+    }
+  }
+  world->snapshot_rows_id = snapshot->id;
+  return true;
 }
 
-void physics_system_update(float delta_time) {
-  static int frame_count = 0;
-  if (!g_physics_world) {
-    printf("NO PHYSICS SYSTEM");
-    return;
+bool physics_snapshot(PhysicsWorld *world, const PhysicsSnapshot *base,
+                      Arena *arena, PhysicsSnapshot *out) {
+  *out = (PhysicsSnapshot){0}; // ZII
+  size_t count = world->body_group ? world->body_group->count : 0;
+  if (base && base->body_count != count) {
+    base = NULL; // Bodies came or went: rows no longer line up
+  }
+  if (base && !physics_snapshot_decode(world, base)) {
+    return false;
+  }
+  if (!physics_snapshot_reserve(world, count)) {
+    return false;
   }
 
-  if (frame_count % 120 == 0) {
-    printf("Physics system running frame %d\n", frame_count);
+  // Deltas are encoded in place into room for the worst case, and the
+  // unused tail is handed back (this is the arena's last allocation)
+  const PhysicsContactCache *cache =
+      &world->contact_cache[world->contact_cache_read];
+  size_t contact_bytes = cache->count * sizeof(PhysicsContactEntry);
+  size_t bit_words = (count + 31) / 32;
+  size_t row_bytes =
+      base ? (bit_words + count * (1 + PHYSICS_SNAPSHOT_ROW_WORDS)) * sizeof(uint32_t)
+           : count * sizeof(PhysicsSnapshotRow);
+  size_t bytes = contact_bytes + row_bytes + sizeof(uint32_t); // Spare word
+
+  char *data = (char *)arena_alloc(arena, bytes);
+  if (!data) {
+    fprintf(stderr, "Failed to allocate snapshot (%zu bytes)\n", bytes);
+    return false;
   }
 
-  physics_verlet_integration(g_physics_world, delta_time);
+  // Empty slots are copied too and overwritten, so the scan doesn't branch
+  PhysicsContactEntry *contacts = (PhysicsContactEntry *)data;
+  size_t stored = 0;
+  for (size_t slot = 0; slot < cache->capacity && stored < cache->count; slot++) {
+    contacts[stored] = cache->entries[slot];
+    stored += cache->entries[slot].key != 0;
+  }
 
-  for (int i = 0; i < g_physics_world->collision_iterations; i++) {
-    physics_solve_collisions(g_physics_world);
-    physics_apply_constraints(g_physics_world);
+  size_t changed_rows = count;
+  if (base) {
+    uint32_t *bits = (uint32_t *)(data + contact_bytes);
+    memset(bits, 0, bit_words * sizeof(uint32_t));
+    uint32_t *cursor = bits + bit_words;
+    changed_rows = physics_snapshot_read(world, bits, &cursor);
+    size_t used = (size_t)((char *)cursor - data) + sizeof(uint32_t);
+    if (arena_trim_last(arena, data, used)) {
+      bytes = used;
+    }
+  } else {
+    physics_snapshot_read(world, NULL, NULL);
+    memcpy(data + contact_bytes, world->snapshot_words, row_bytes);
   }
 
-  frame_count++;
+  out->base = base;
+  out->id = ++world->last_snapshot_id;
+  out->body_count = count;
+  out->changed_rows = changed_rows;
+  out->contact_count = stored;
+  out->step_count = world->step_count;
+  out->random_seed = world->random_seed;
+  out->accumulator = world->accumulator;
+  out->interpolation_alpha = world->interpolation_alpha;
+  out->next_island = world->next_island;
+  out->data = data;
+  out->data_size = bytes;
+  world->snapshot_rows_id = out->id;
+  return true;
 }
 
-void physics_verlet_integration(PhysicsWorld *world, float delta_time) {
-  for (Entity entity = 1; entity < world->ecs->next_entity_id; entity++) {
-    if (!ecs_entity_active(world->ecs, entity))
-      continue;
+static bool physics_restore_contacts(PhysicsWorld *world,
+                                     const PhysicsSnapshot *snapshot) {
+  PhysicsContactCache *cache = &world->contact_cache[world->contact_cache_read];
+  size_t capacity = cache->capacity ? cache->capacity : 1024;
+  while (capacity < snapshot->contact_count * 2) {
+    capacity *= 2;
+  }
+  if (capacity != cache->capacity) {
+    PhysicsContactEntry *entries = (PhysicsContactEntry *)realloc(
+        cache->entries, capacity * sizeof(PhysicsContactEntry));
+    if (!entries) {
+      fprintf(stderr, "Failed to grow physics contact cache (%zu slots)\n",
+              capacity);
+      cache->count = 0;
+      return false;
+    }
+    cache->entries = entries;
+    cache->capacity = capacity;
+  }
+  memset(cache->entries, 0, cache->capacity * sizeof(PhysicsContactEntry));
+  const PhysicsContactEntry *contacts =
+      (const PhysicsContactEntry *)snapshot->data;
+  for (size_t c = 0; c < snapshot->contact_count; c++) {
+    *physics_contact_slot(cache, contacts[c].key) = contacts[c];
+  }
+  cache->count = snapshot->contact_count;
+  return true;
+}
+
+bool physics_restore(PhysicsWorld *world, const PhysicsSnapshot *snapshot) {
+  size_t count = world->body_group ? world->body_group->count : 0;
+  if (snapshot->body_count != count) {
+    fprintf(stderr, "Snapshot has %zu bodies, world has %zu\n",
+            snapshot->body_count, count);
+    return false;
+  }
+  if (!physics_snapshot_decode(world, snapshot)) {
+    return false;
+  }
 
-    if (!ecs_has_component(world->ecs, entity, world->transform_type) ||
-        !ecs_has_component(world->ecs, entity, world->verlet_type)) {
+  size_t chunks = ecs_group_chunk_count(world->body_group);
+  for (size_t c = 0, base = 0; c < chunks; c++) {
+    EcsChunk chunk;
+    if (!ecs_group_chunk(world->ecs, world->body_group, c, &chunk)) {
       continue;
     }
-
-    Transform *transform = (Transform *)ecs_get_component(
-        world->ecs, entity, world->transform_type);
-    VerletBody *verlet =
-        (VerletBody *)ecs_get_component(world->ecs, entity, world->verlet_type);
-
-    Vec3 current_position = transform->position;
-
-    // Calculate current velocity from position difference
-    Vec3 velocity = vec3_multiply(
-        vec3_add(current_position, vec3_multiply(verlet->old_position, -1.0f)),
-        1.0f / delta_time);
-    float speed = sqrtf(velocity.x * velocity.x + velocity.y * velocity.y);
-    verlet->velocity = velocity;
-
-    // Sleep management
-    if (verlet->is_sleeping) {
-      // Check if we should wake up (collision or significant external force)
-      float accel_magnitude =
-          sqrtf(verlet->acceleration.x * verlet->acceleration.x +
-                verlet->acceleration.y * verlet->acceleration.y);
-      if (speed > PHYSICS_WAKE_VELOCITY_THRESHOLD ||
-          accel_magnitude > PHYSICS_WAKE_VELOCITY_THRESHOLD) {
-        verlet->is_sleeping = false;
-        verlet->sleep_timer = 0;
-      } else {
-        // Stay asleep - no physics integration
-        verlet->acceleration = (Vec3){0};
-        continue;
-      }
-    } else {
-      // Check if we should go to sleep
-      if (speed < PHYSICS_SLEEP_VELOCITY_THRESHOLD) {
-        verlet->sleep_timer++;
-        if (verlet->sleep_timer >= PHYSICS_SLEEP_TIME_THRESHOLD) {
-          verlet->is_sleeping = true;
-          verlet->velocity = (Vec3){0};
-          verlet->acceleration = (Vec3){0};
-          continue;
-        }
-      } else {
-        verlet->sleep_timer = 0; // Reset timer if moving too fast
+    for (size_t i = 0; i < chunk.count; i++) {
+      const uint32_t *held =
+          world->snapshot_words + (base + i) * PHYSICS_SNAPSHOT_ROW_WORDS;
+      if (chunk.entities[i] != held[PHYSICS_SNAPSHOT_WORD(entity)]) {
+        fprintf(stderr, "Snapshot row %zu is another entity\n", base + i);
+        return false;
       }
     }
+    base += chunk.count;
+  }
 
-    verlet->acceleration = vec3_add(verlet->acceleration, world->gravity);
+  // The body store is refilled too, for queries and the state hash; the
+  // next step regathers it in full
+  if (!physics_bodies_reserve(&world->bodies, count)) {
+    return false;
+  }
+  world->bodies.count = count;
+  world->tree_pairs_stale = true;
+  world->synced = false;
+  for (size_t c = 0, base = 0; c < chunks; c++) {
+    EcsChunk chunk;
+    if (!ecs_group_chunk(world->ecs, world->body_group, c, &chunk)) {
+      continue;
+    }
+    Transform *transforms = (Transform *)chunk.components[world->transform_type];
+    VerletBody *verlets = (VerletBody *)chunk.components[world->verlet_type];
+    CircleCollider *colliders =
+        (CircleCollider *)chunk.components[world->collider_type];
+    for (size_t i = 0; i < chunk.count; i++) {
+      const uint32_t *held =
+          world->snapshot_words + (base + i) * PHYSICS_SNAPSHOT_ROW_WORDS;
+      Transform transform;
+      memcpy(&transform, held + PHYSICS_SNAPSHOT_WORD(transform), sizeof(Transform));
+      if (memcmp(&transforms[i], &transform, sizeof(Transform)) != 0) {
+        transforms[i] = transform;
+        ecs_chunk_mark_changed(&chunk, world->transform_type, i);
+      }
+      memcpy(&verlets[i], held + PHYSICS_SNAPSHOT_WORD(verlet), sizeof(VerletBody));
+      memcpy(&colliders[i], held + PHYSICS_SNAPSHOT_WORD(collider),
+             sizeof(CircleCollider));
+      physics_gather_row(&world->bodies, base + i, &transform, &verlets[i],
+                         &colliders[i], chunk.entities[i]);
+    }
+    base += chunk.count;
+  }
 
-    Vec3 new_position = vec3_add(
-        current_position,
-        vec3_add(
-            vec3_multiply(vec3_add(current_position,
-                                   vec3_multiply(verlet->old_position, -1.0f)),
-                          world->damping),
-            vec3_multiply(verlet->acceleration, delta_time * delta_time)));
+  world->step_count = snapshot->step_count;
+  world->random_seed = snapshot->random_seed;
+  world->accumulator = snapshot->accumulator;
+  world->interpolation_alpha = snapshot->interpolation_alpha;
+  world->next_island = snapshot->next_island;
+  physics_restore_contacts(world, snapshot);
+  if (world->deterministic) {
+    world->state_hash = physics_state_hash(world);
+  }
+  return true;
+}
 
-    verlet->old_position = current_position;
-    transform->position = new_position;
+size_t physics_query_region(const PhysicsWorld *world, Aabb box,
+                            Entity *out_entities, size_t max_entities) {
+  const PhysicsBodies *bodies = &world->bodies;
+  size_t count = 0;
+  if (world->broadphase == PHYSICS_BROADPHASE_TREE) {
+    // Leaves are fattened, so take every candidate (one per leaf at most,
+    // like the step's found rows) and cap only the exact hits. The step's
+    // buffer lives in the spatial arena, so this one comes from the calling
+    // thread's scratch.
+    const AabbTree *tree = &world->body_tree;
+    size_t capacity = tree->leaf_count > bodies->count ? tree->leaf_count
+                                                       : bodies->count;
+    if (capacity == 0 || max_entities == 0) {
+      return 0;
+    }
+    ArenaScope scope = arena_scratch_begin();
+    uint32_t *found =
+        (uint32_t *)arena_alloc(scope.arena, capacity * sizeof(uint32_t));
+    if (!found) {
+      arena_scope_end(scope);
+      return 0;
+    }
+    size_t found_count = aabb_tree_query(tree, box, found, capacity);
+    for (size_t k = 0; k < found_count && count < max_entities; k++) {
+      uint32_t row = found[k];
+      if (row < bodies->count &&
+          physics_circle_overlaps_box(bodies->x[row], bodies->y[row],
+                                      bodies->radius[row], box)) {
+        out_entities[count++] = bodies->entity[row];
+      }
+    }
+    arena_scope_end(scope);
+    return count;
+  }
 
-    verlet->acceleration = (Vec3){0};
+  for (size_t row = 0; row < bodies->count && count < max_entities; row++) {
+    if (physics_circle_overlaps_box(bodies->x[row], bodies->y[row],
+                                    bodies->radius[row], box)) {
+      out_entities[count++] = bodies->entity[row];
+    }
   }
+  return count;
 }
 
-void physics_solve_collisions(PhysicsWorld *world) {
-
-  // Reset arena for this frame's spatial allocations
-  arena_reset(&world->spatial_arena);
+// Batched queries. The step's grid is no use here (it leaves sleepers out
+// and the tree and sweep broadphases don't build it), so each batch builds
+// its own over every body, with the same cells, in the query arena. Rows
+// found are gathered in the world's scratch and copied into the caller's
+// arena in one block at the end.
+
+static bool physics_query_begin(PhysicsWorld *world) {
+  arena_reset(&world->query_arena);
+  world->query_scratch.count = 0;
+  world->query_grid = world->spatial_grid; // Same geometry as the step's grid
+  return spatial_grid_build(&world->query_grid, &world->query_arena,
+                            world->bodies.x, world->bodies.y,
+                            world->bodies.radius, NULL, world->bodies.count);
+}
 
-  // Track arena usage and sleeping objects for debugging
-  static int frame_count = 0;
-  if (frame_count == 0) {
-    ArenaStats stats = {0};
-    arena_get_stats(&world->spatial_arena, &stats);
-    printf("Spatial arena initialized: Size: %zu KB\n",
-           stats.total_size / 1024);
+static bool physics_query_reserve(PhysicsQueryScratch *scratch, size_t extra) {
+  if (scratch->count + extra <= scratch->capacity) {
+    return true;
+  }
+  size_t capacity = scratch->capacity ? scratch->capacity : 1024;
+  while (capacity < scratch->count + extra) {
+    capacity *= 2;
+  }
+  uint32_t *rows =
+      (uint32_t *)realloc(scratch->rows, capacity * sizeof(uint32_t));
+  if (rows) {
+    scratch->rows = rows;
+  }
+  float *distances =
+      (float *)realloc(scratch->distances, capacity * sizeof(float));
+  if (distances) {
+    scratch->distances = distances;
   }
+  if (!rows || !distances) {
+    fprintf(stderr, "Failed to grow physics query scratch (%zu rows)\n",
+            capacity);
+    return false;
+  }
+  scratch->capacity = capacity;
+  return true;
+}
 
-  // Count sleeping objects every 300 frames (5 seconds at 60fps)
-  if (frame_count % 300 == 0 && frame_count > 0) {
-    int sleeping_count = 0;
-    int total_count = 0;
-    for (Entity entity = 1; entity < world->ecs->next_entity_id; entity++) {
-      if (!ecs_entity_active(world->ecs, entity))
-        continue;
-      if (!ecs_has_component(world->ecs, entity, world->verlet_type))
-        continue;
+static bool physics_query_reserve_offsets(PhysicsQueryScratch *scratch,
+                                          size_t count) {
+  if (count + 1 <= scratch->offset_capacity) {
+    return true;
+  }
+  uint32_t *grown =
+      (uint32_t *)realloc(scratch->offsets, (count + 1) * sizeof(uint32_t));
+  if (!grown) {
+    fprintf(stderr, "Failed to grow physics query offsets (%zu queries)\n",
+            count);
+    return false;
+  }
+  scratch->offsets = grown;
+  scratch->offset_capacity = count + 1;
+  return true;
+}
 
-      VerletBody *verlet = (VerletBody *)ecs_get_component(world->ecs, entity,
-                                                           world->verlet_type);
-      total_count++;
-      if (verlet->is_sleeping)
-        sleeping_count++;
+// Grid candidates for a circle (every row in the cells it reaches), appended
+// to the scratch; returns false if the scratch can't grow
+static bool physics_query_candidates(PhysicsWorld *world, float x, float y,
+                                     float radius) {
+  PhysicsQueryScratch *scratch = &world->query_scratch;
+  size_t room = scratch->capacity - scratch->count;
+  size_t found = spatial_grid_query(&world->query_grid, x, y, radius,
+                                    scratch->rows + scratch->count, room);
+  if (found > room) {
+    if (!physics_query_reserve(scratch, found)) {
+      return false;
     }
-    printf("Frame %d: %d/%d objects sleeping (%.1f%%)\n", frame_count,
-           sleeping_count, total_count,
-           total_count > 0 ? (float)sleeping_count / total_count * 100.0f
-                           : 0.0f);
+    spatial_grid_query(&world->query_grid, x, y, radius,
+                       scratch->rows + scratch->count, found);
   }
+  scratch->count += found;
+  return true;
+}
 
-  frame_count++;
+// Copies the gathered rows out as entities
+static bool physics_query_finish(PhysicsWorld *world, size_t count,
+                                 Arena *arena, PhysicsQueryResults *results) {
+  const PhysicsQueryScratch *scratch = &world->query_scratch;
+  uint32_t *block = (uint32_t *)arena_alloc(
+      arena, (count + 1 + scratch->count) * sizeof(uint32_t));
+  if (!block) {
+    fprintf(stderr, "Query results don't fit the arena (%zu entities)\n",
+            scratch->count);
+    return false;
+  }
+  results->offsets = block;
+  results->entities = block + count + 1;
+  results->query_count = count;
+  memcpy(results->offsets, scratch->offsets, (count + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < scratch->count; i++) {
+    results->entities[i] = world->bodies.entity[scratch->rows[i]];
+  }
+  return true;
+}
 
-  spatial_grid_clear(&world->spatial_grid);
+bool physics_query_circles(PhysicsWorld *world,
+                           const PhysicsCircleQuery *queries, size_t count,
+                           Arena *arena, PhysicsQueryResults *results) {
+  *results = (PhysicsQueryResults){0}; // ZII
+  PhysicsQueryScratch *scratch = &world->query_scratch;
+  if (!physics_query_begin(world) ||
+      !physics_query_reserve_offsets(scratch, count)) {
+    return false;
+  }
 
-  // Insert all entities into spatial grid (skip sleeping objects for
-  // optimization)
-  for (Entity entity = 1; entity < world->ecs->next_entity_id; entity++) {
-    if (!ecs_entity_active(world->ecs, entity)) {
-      continue;
+  const PhysicsBodies *bodies = &world->bodies;
+  for (size_t q = 0; q < count; q++) {
+    const PhysicsCircleQuery *query = &queries[q];
+    size_t first = scratch->count;
+    scratch->offsets[q] = (uint32_t)first;
+    if (!physics_query_candidates(world, query->center.x, query->center.y,
+                                  query->radius)) {
+      return false;
     }
+    size_t kept = first;
+    for (size_t i = first; i < scratch->count; i++) {
+      uint32_t row = scratch->rows[i];
+      float dx = bodies->x[row] - query->center.x;
+      float dy = bodies->y[row] - query->center.y;
+      float reach = bodies->radius[row] + query->radius;
+      if (dx * dx + dy * dy <= reach * reach) {
+        scratch->rows[kept++] = row;
+      }
+    }
+    scratch->count = kept;
+  }
+  scratch->offsets[count] = (uint32_t)scratch->count;
+  return physics_query_finish(world, count, arena, results);
+}
 
-    if (!ecs_has_component(world->ecs, entity, world->transform_type) ||
-        !ecs_has_component(world->ecs, entity, world->verlet_type) ||
-        !ecs_has_component(world->ecs, entity, world->collider_type)) {
-      continue;
+bool physics_query_boxes(PhysicsWorld *world, const Aabb *boxes, size_t count,
+                         Arena *arena, PhysicsQueryResults *results) {
+  *results = (PhysicsQueryResults){0}; // ZII
+  PhysicsQueryScratch *scratch = &world->query_scratch;
+  if (!physics_query_begin(world) ||
+      !physics_query_reserve_offsets(scratch, count)) {
+    return false;
+  }
+
+  const PhysicsBodies *bodies = &world->bodies;
+  for (size_t q = 0; q < count; q++) {
+    Aabb box = boxes[q];
+    size_t first = scratch->count;
+    scratch->offsets[q] = (uint32_t)first;
+    // The grid sweeps a square, so the box's larger half-extent covers it
+    float half_w = (box.max_x - box.min_x) * 0.5f;
+    float half_h = (box.max_y - box.min_y) * 0.5f;
+    if (!physics_query_candidates(world, box.min_x + half_w,
+                                  box.min_y + half_h,
+                                  half_w > half_h ? half_w : half_h)) {
+      return false;
     }
+    size_t kept = first;
+    for (size_t i = first; i < scratch->count; i++) {
+      uint32_t row = scratch->rows[i];
+      if (physics_circle_overlaps_box(bodies->x[row], bodies->y[row],
+                                      bodies->radius[row], box)) {
+        scratch->rows[kept++] = row;
+      }
+    }
+    scratch->count = kept;
+  }
+  scratch->offsets[count] = (uint32_t)scratch->count;
+  return physics_query_finish(world, count, arena, results);
+}
 
-    VerletBody *verlet =
-        (VerletBody *)ecs_get_component(world->ecs, entity, world->verlet_type);
-    if (verlet->is_sleeping) {
-      continue; // Skip sleeping objects for collision detection optimization
+// Distance from a point to a body's edge, 0 inside it
+static float physics_edge_distance(const PhysicsBodies *bodies, uint32_t row,
+                                   float x, float y) {
+  float dx = bodies->x[row] - x;
+  float dy = bodies->y[row] - y;
+  float distance = sqrtf(dx * dx + dy * dy) - bodies->radius[row];
+  return distance > 0.0f ? distance : 0.0f;
+}
+
+// Searches square rings of cells outwards from the point's cell, keeping the
+// k best rows sorted by distance in rows/distances. A row in ring r is at
+// least r - 1 cells from the point (clamping never moves cells apart), so
+// the search stops once that bound, less the largest radius, can't beat the
+// k-th best.
+static size_t physics_nearest_rows(const PhysicsWorld *world,
+                                   const PhysicsNearestQuery *query,
+                                   uint32_t *rows, float *distances) {
+  const PhysicsBodies *bodies = &world->bodies;
+  const SpatialGrid *grid = &world->query_grid;
+  float limit = query->max_distance > 0.0f ? query->max_distance : INFINITY;
+  int center_x, center_y;
+  spatial_grid_cell_coords(grid, query->point.x, query->point.y, &center_x,
+                           &center_y);
+  int rings = grid->grid_width > grid->grid_height ? grid->grid_width
+                                                   : grid->grid_height;
+  size_t found = 0;
+
+  for (int ring = 0; ring <= rings; ring++) {
+    float bound = (float)(ring - 1) * grid->cell_size - grid->max_radius;
+    float worst = found == query->k ? distances[found - 1] : limit;
+    if (bound > worst) {
+      break;
     }
 
-    Transform *transform = (Transform *)ecs_get_component(
-        world->ecs, entity, world->transform_type);
-    CircleCollider *collider = (CircleCollider *)ecs_get_component(
-        world->ecs, entity, world->collider_type);
+    for (int cy = center_y - ring; cy <= center_y + ring; cy++) {
+      if (cy < 0 || cy >= grid->grid_height) {
+        continue;
+      }
+      // Inner rows of a ring only have their two end cells
+      bool edge = cy == center_y - ring || cy == center_y + ring;
+      int step = edge || ring == 0 ? 1 : 2 * ring;
+      for (int cx = center_x - ring; cx <= center_x + ring; cx += step) {
+        if (cx < 0 || cx >= grid->grid_width) {
+          continue;
+        }
+        size_t cell = (size_t)cy * grid->grid_width + cx;
+        for (uint32_t k = grid->cell_start[cell]; k < grid->cell_end[cell];
+             k++) {
+          uint32_t row = grid->cell_entities[k];
+          float distance = physics_edge_distance(bodies, row, query->point.x,
+                                                 query->point.y);
+          if (distance > limit ||
+              (found == query->k && distance >= distances[found - 1])) {
+            continue;
+          }
+          // Insertion into the sorted best k, dropping the worst when full
+          size_t slot = found < query->k ? found++ : found - 1;
+          while (slot > 0 && distances[slot - 1] > distance) {
+            rows[slot] = rows[slot - 1];
+            distances[slot] = distances[slot - 1];
+            slot--;
+          }
+          rows[slot] = row;
+          distances[slot] = distance;
+        }
+      }
+    }
+  }
+  return found;
+}
 
-    spatial_grid_insert(&world->spatial_grid, &world->spatial_arena, entity,
-                        transform->position, collider->radius);
+bool physics_query_nearest(PhysicsWorld *world,
+                           const PhysicsNearestQuery *queries, size_t count,
+                           Arena *arena, PhysicsQueryResults *results) {
+  *results = (PhysicsQueryResults){0}; // ZII
+  PhysicsQueryScratch *scratch = &world->query_scratch;
+  if (!physics_query_begin(world) ||
+      !physics_query_reserve_offsets(scratch, count)) {
+    return false;
   }
 
-  // Check collisions using spatial partitioning
-  for (Entity entity1 = 1; entity1 < world->ecs->next_entity_id; entity1++) {
-    if (!ecs_entity_active(world->ecs, entity1)) {
+  for (size_t q = 0; q < count; q++) {
+    scratch->offsets[q] = (uint32_t)scratch->count;
+    if (queries[q].k == 0) {
       continue;
     }
-
-    if (!ecs_has_component(world->ecs, entity1, world->transform_type) ||
-        !ecs_has_component(world->ecs, entity1, world->verlet_type) ||
-        !ecs_has_component(world->ecs, entity1, world->collider_type)) {
-      continue;
+    if (!physics_query_reserve(scratch, queries[q].k)) {
+      return false;
     }
+    scratch->count += physics_nearest_rows(world, &queries[q],
+                                           scratch->rows + scratch->count,
+                                           scratch->distances + scratch->count);
+  }
+  scratch->offsets[count] = (uint32_t)scratch->count;
+  return physics_query_finish(world, count, arena, results);
+}
 
-    Transform *t1 = (Transform *)ecs_get_component(world->ecs, entity1,
-                                                   world->transform_type);
-    VerletBody *v1 = (VerletBody *)ecs_get_component(world->ecs, entity1,
-                                                     world->verlet_type);
-    CircleCollider *c1 = (CircleCollider *)ecs_get_component(
-        world->ecs, entity1, world->collider_type);
-
-    if (v1->is_sleeping) {
-      continue; // Skip sleeping objects as primary collision entity
+// Nearest hit of a ray (unit direction) with a row's circle within
+// max_distance; updates hit and returns true if it is closer
+static bool physics_ray_circle(const PhysicsBodies *bodies, uint32_t row,
+                               float ox, float oy, float dx, float dy,
+                               float max_distance, PhysicsRayHit *hit) {
+  float fx = ox - bodies->x[row];
+  float fy = oy - bodies->y[row];
+  float radius = bodies->radius[row];
+  float b = fx * dx + fy * dy;
+  float c = fx * fx + fy * fy - radius * radius;
+  float t;
+  if (c <= 0.0f) {
+    t = 0.0f; // Starts inside
+  } else {
+    float discriminant = b * b - c;
+    if (b > 0.0f || discriminant < 0.0f) {
+      return false; // Pointing away, or missing
     }
+    t = -b - sqrtf(discriminant);
+  }
+  if (t > max_distance || (hit->hit && t >= hit->distance)) {
+    return false;
+  }
+  hit->hit = true;
+  hit->entity = bodies->entity[row];
+  hit->distance = t;
+  hit->point = (Vec3){ox + dx * t, oy + dy * t, 0.0f};
+  float nx = hit->point.x - bodies->x[row];
+  float ny = hit->point.y - bodies->y[row];
+  float length = sqrtf(nx * nx + ny * ny);
+  hit->normal = length > 0.0f ? (Vec3){nx / length, ny / length, 0.0f}
+                              : (Vec3){-dx, -dy, 0.0f};
+  return true;
+}
 
-    // Get potential collision candidates from spatial grid
-    Entity *potential_entities;
-    int potential_count;
-    spatial_grid_get_potential_collisions(
-        &world->spatial_grid, entity1, t1->position, c1->radius,
-        &potential_entities, &potential_count);
-
-    // Check collisions with potential candidates
-    for (int i = 0; i < potential_count; i++) {
-      Entity entity2 = potential_entities[i];
-
-      // Skip if entity2 < entity1 to avoid duplicate checks (but allow entity2
-      // == entity1 + 1, entity1 + 2, etc.)
-      if (entity2 < entity1) {
-        continue;
-      }
+// Walks the cells along the ray (Amanatides-Woo) and tests the rows in the
+// cells within reach of each. A circle hit at distance t has its center
+// within the largest radius of the ray at t, so its cell is within reach of
+// the ray's cell there - also after clamping, which never moves cells apart.
+// The walk runs over unclamped cells while the ray is within reach of the
+// grid and stops at the first cell entered beyond the best hit; bodies
+// outside the grid (outliers, listed by the caller) are tested directly.
+static void physics_raycast_one(const PhysicsWorld *world,
+                                const PhysicsRaycastQuery *query,
+                                const uint32_t *outliers, size_t outlier_count,
+                                PhysicsRayHit *hit) {
+  const PhysicsBodies *bodies = &world->bodies;
+  const SpatialGrid *grid = &world->query_grid;
+  *hit = (PhysicsRayHit){0}; // ZII
+  float length = sqrtf(query->direction.x * query->direction.x +
+                       query->direction.y * query->direction.y);
+  if (length <= 0.0f || bodies->count == 0) {
+    return;
+  }
+  float dx = query->direction.x / length;
+  float dy = query->direction.y / length;
+  float ox = query->origin.x;
+  float oy = query->origin.y;
+  float max_distance = query->max_distance > 0.0f ? query->max_distance : INFINITY;
+  for (size_t i = 0; i < outlier_count; i++) {
+    physics_ray_circle(bodies, outliers[i], ox, oy, dx, dy, max_distance, hit);
+  }
 
-      if (!ecs_entity_active(world->ecs, entity2)) {
-        continue;
+  // Clip the ray to the grid grown by reach cells
+  float cell = grid->cell_size;
+  int reach = grid->reach;
+  float margin = (float)reach * cell;
+  float bounds[2][2] = {
+      {grid->grid_origin.x - margin,
+       grid->grid_origin.x + (float)grid->grid_width * cell + margin},
+      {grid->grid_origin.y - margin,
+       grid->grid_origin.y + (float)grid->grid_height * cell + margin}};
+  float origin[2] = {ox, oy};
+  float direction[2] = {dx, dy};
+  float t_start = 0.0f;
+  float t_end = max_distance;
+  for (int axis = 0; axis < 2; axis++) {
+    if (direction[axis] == 0.0f) {
+      if (origin[axis] < bounds[axis][0] || origin[axis] > bounds[axis][1]) {
+        return;
       }
+      continue;
+    }
+    float t0 = (bounds[axis][0] - origin[axis]) / direction[axis];
+    float t1 = (bounds[axis][1] - origin[axis]) / direction[axis];
+    if (t0 > t1) {
+      float swap = t0;
+      t0 = t1;
+      t1 = swap;
+    }
+    t_start = t0 > t_start ? t0 : t_start;
+    t_end = t1 < t_end ? t1 : t_end;
+  }
+  if (t_start > t_end) {
+    return;
+  }
 
-      if (!ecs_has_component(world->ecs, entity2, world->transform_type) ||
-          !ecs_has_component(world->ecs, entity2, world->verlet_type) ||
-          !ecs_has_component(world->ecs, entity2, world->collider_type)) {
-        continue;
+  int cx = (int)floorf((ox + dx * t_start - grid->grid_origin.x) / cell);
+  int cy = (int)floorf((oy + dy * t_start - grid->grid_origin.y) / cell);
+  int step_x = dx > 0.0f ? 1 : -1;
+  int step_y = dy > 0.0f ? 1 : -1;
+  float t_max_x =
+      dx != 0.0f
+          ? (grid->grid_origin.x + (float)(cx + (step_x > 0)) * cell - ox) / dx
+          : INFINITY;
+  float t_max_y =
+      dy != 0.0f
+          ? (grid->grid_origin.y + (float)(cy + (step_y > 0)) * cell - oy) / dy
+          : INFINITY;
+  float t_delta_x = dx != 0.0f ? cell / fabsf(dx) : INFINITY;
+  float t_delta_y = dy != 0.0f ? cell / fabsf(dy) : INFINITY;
+
+  float t_enter = t_start;
+  while (t_enter <= t_end && (!hit->hit || t_enter <= hit->distance)) {
+    // Clamping the span clamps every cell in it
+    int min_x = cx - reach, max_x = cx + reach;
+    int min_y = cy - reach, max_y = cy + reach;
+    min_x = min_x < 0 ? 0 : (min_x >= grid->grid_width ? grid->grid_width - 1 : min_x);
+    max_x = max_x < 0 ? 0 : (max_x >= grid->grid_width ? grid->grid_width - 1 : max_x);
+    min_y = min_y < 0 ? 0 : (min_y >= grid->grid_height ? grid->grid_height - 1 : min_y);
+    max_y = max_y < 0 ? 0 : (max_y >= grid->grid_height ? grid->grid_height - 1 : max_y);
+    for (int ny = min_y; ny <= max_y; ny++) {
+      for (int nx = min_x; nx <= max_x; nx++) {
+        size_t other = (size_t)ny * grid->grid_width + nx;
+        for (uint32_t k = grid->cell_start[other]; k < grid->cell_end[other];
+             k++) {
+          physics_ray_circle(bodies, grid->cell_entities[k], ox, oy, dx, dy,
+                             max_distance, hit);
+        }
       }
+    }
 
-      Transform *t2 = (Transform *)ecs_get_component(world->ecs, entity2,
-                                                     world->transform_type);
-      VerletBody *v2 = (VerletBody *)ecs_get_component(world->ecs, entity2,
-                                                       world->verlet_type);
-      CircleCollider *c2 = (CircleCollider *)ecs_get_component(
-          world->ecs, entity2, world->collider_type);
-
-      Vec3 normal;
-      float penetration;
-      if (circle_circle_collision(t1->position, c1->radius, t2->position,
-                                  c2->radius, &normal, &penetration)) {
-        resolve_circle_collision(t1, v1, c1, t2, v2, c2, normal, penetration);
-      }
+    if (t_max_x < t_max_y) {
+      t_enter = t_max_x;
+      t_max_x += t_delta_x;
+      cx += step_x;
+    } else {
+      t_enter = t_max_y;
+      t_max_y += t_delta_y;
+      cy += step_y;
     }
   }
 }
 
-void physics_apply_constraints(PhysicsWorld *world) {
-  for (Entity entity = 1; entity < world->ecs->next_entity_id; entity++) {
-    if (!ecs_entity_active(world->ecs, entity))
-      continue;
+PhysicsRayHit *physics_raycast(PhysicsWorld *world,
+                               const PhysicsRaycastQuery *queries, size_t count,
+                               Arena *arena) {
+  if (!physics_query_begin(world)) {
+    return NULL;
+  }
+  PhysicsRayHit *hits =
+      (PhysicsRayHit *)arena_alloc(arena, count * sizeof(PhysicsRayHit));
+  if (!hits) {
+    fprintf(stderr, "Raycast hits don't fit the arena (%zu rays)\n", count);
+    return NULL;
+  }
 
-    if (!ecs_has_component(world->ecs, entity, world->transform_type) ||
-        !ecs_has_component(world->ecs, entity, world->collider_type)) {
+  // Bodies outside the grid sit in its edge cells, where the walk may not
+  // reach them; the world boundary normally keeps this list empty
+  const PhysicsBodies *bodies = &world->bodies;
+  const SpatialGrid *grid = &world->query_grid;
+  PhysicsQueryScratch *scratch = &world->query_scratch;
+  float grid_max_x = grid->grid_origin.x + (float)grid->grid_width * grid->cell_size;
+  float grid_max_y = grid->grid_origin.y + (float)grid->grid_height * grid->cell_size;
+  for (size_t i = 0; i < bodies->count; i++) {
+    if (bodies->x[i] >= grid->grid_origin.x && bodies->x[i] < grid_max_x &&
+        bodies->y[i] >= grid->grid_origin.y && bodies->y[i] < grid_max_y) {
       continue;
     }
+    if (!physics_query_reserve(scratch, 1)) {
+      return NULL;
+    }
+    scratch->rows[scratch->count++] = (uint32_t)i;
+  }
 
-    Transform *transform = (Transform *)ecs_get_component(
-        world->ecs, entity, world->transform_type);
-    CircleCollider *collider = (CircleCollider *)ecs_get_component(
-        world->ecs, entity, world->collider_type);
+  for (size_t q = 0; q < count; q++) {
+    physics_raycast_one(world, &queries[q], scratch->rows, scratch->count,
+                        &hits[q]);
+  }
+  return hits;
+}
 
-    Vec3 to_center = vec3_add(world->boundary_center,
-                              vec3_multiply(transform->position, -1.0f));
-    float distance =
-        sqrtf(to_center.x * to_center.x + to_center.y * to_center.y);
-    float max_distance = world->boundary_radius - collider->radius;
+// Single phases, each a full ECS round trip (tests and tools use these); the
+// next step regathers every row
+void physics_verlet_integration(PhysicsWorld *world, float delta_time) {
+  if (physics_gather(world)) {
+    physics_integrate_bodies(world, delta_time, 0, NULL, world->bodies.count);
+    physics_scatter(world);
+  }
+}
 
-    if (distance > max_distance) {
-      Vec3 direction = vec3_multiply(to_center, 1.0f / distance);
-      transform->position = vec3_add(world->boundary_center,
-                                     vec3_multiply(direction, -max_distance));
+void physics_solve_collisions(PhysicsWorld *world) {
+  if (physics_gather(world)) {
+    size_t awake = 0;
+    for (size_t row = 0; row < world->bodies.count; row++) {
+      if (!world->bodies.sleeping[row]) {
+        world->awake_rows[awake++] = (uint32_t)row;
+      }
     }
+    world->awake_count = awake;
+    physics_collide_bodies(world, false);
+    physics_scatter(world);
+  }
+}
+
+void physics_apply_constraints(PhysicsWorld *world) {
+  if (physics_gather(world)) {
+    physics_constrain_bodies(world, NULL, world->bodies.count);
+    physics_scatter(world);
   }
 }
 
 bool circle_circle_collision(Vec3 pos1, float r1, Vec3 pos2, float r2,
                              Vec3 *normal, float *penetration) {
+  return physics_circle_contact(pos1, r1, pos2, r2,
+                                physics_position_key(pos1, pos2), normal,
+                                penetration);
+}
+
+static bool physics_circle_contact(Vec3 pos1, float r1, Vec3 pos2, float r2,
+                                   uint64_t key, Vec3 *normal,
+                                   float *penetration) {
   Vec3 diff = vec3_add(pos2, vec3_multiply(pos1, -1.0f));
   float distance_sq = diff.x * diff.x + diff.y * diff.y;
   float radius_sum = r1 + r2;
@@ -362,10 +2917,8 @@ bool circle_circle_collision(Vec3 pos1, float r1, Vec3 pos2, float r2,
       PHYSICS_OVERLAP_THRESHOLD) { // Use small threshold instead of 0
     *normal = vec3_multiply(diff, 1.0f / distance);
   } else {
-    // Generate random direction when circles are nearly overlapping
-    // TODO: do we need this anymore?
-    float angle = ((float)rand() / RAND_MAX) * 2.0f * M_PI;
-    *normal = (Vec3){cosf(angle), sinf(angle), 0.0f};
+    // Centres (nearly) coincide: any direction separates them
+    *normal = physics_fallback_normal(key);
   }
   return true;
 }
@@ -406,11 +2959,9 @@ void resolve_circle_collision(Transform *t1, VerletBody *v1, CircleCollider *c1,
     normal.x /= normal_length;
     normal.y /= normal_length;
   } else {
-    // Fallback to random direction if normal is invalid
-    float angle = ((float)rand() / RAND_MAX) * 2.0f * M_PI;
-    normal.x = cosf(angle);
-    normal.y = sinf(angle);
-    normal.z = 0.0f;
+    // Fallback direction if normal is invalid, keyed by the positions
+    normal = physics_fallback_normal(
+        physics_position_key(t1->position, t2->position));
   }
 
   // Position correction with consistent factor
@@ -433,154 +2984,273 @@ void resolve_circle_collision(Transform *t1, VerletBody *v1, CircleCollider *c1,
   }
 }
 
-// Spatial partitioning implementation with arena allocator
+// Spatial partitioning: uniform grid rebuilt by counting sort each pass
 void spatial_grid_init(SpatialGrid *grid, Arena *arena, Vec3 origin,
                        float width, float height, float cell_size) {
-  (void)arena; // TODO: Arena parameter kept for API compatibility but not used
-               // since we malloc cells directly
+  (void)arena; // Per-build arrays come from the arena given to the build
+  *grid = (SpatialGrid){0}; // ZII
   grid->grid_origin = origin;
   grid->cell_size = cell_size;
   grid->grid_width = (int)(width / cell_size) + 1;
   grid->grid_height = (int)(height / cell_size) + 1;
-
-  int total_cells = grid->grid_width * grid->grid_height;
-  // Use malloc for cells array to avoid issues with arena reallocation
-  grid->cells = (SpatialCell *)malloc(sizeof(SpatialCell) * total_cells);
-
-  if (!grid->cells) {
-    printf(
-        "ERROR: Failed to allocate spatial grid cells (%d cells, %zu bytes)\\n",
-        total_cells, sizeof(SpatialCell) * total_cells);
-    return;
-  }
-
-  memset(grid->cells, 0, sizeof(SpatialCell) * total_cells);
-  printf("Spatial grid initialized: %dx%d = %d cells\\n", grid->grid_width,
-         grid->grid_height, total_cells);
 }
 
 void spatial_grid_cleanup(SpatialGrid *grid) {
-  if (grid && grid->cells) {
-    free(grid->cells);
-  }
   memset(grid, 0, sizeof(SpatialGrid));
 }
 
 void spatial_grid_clear(SpatialGrid *grid) {
-  // With arena allocator, we just reset all cell entity lists to NULL
-  // The arena will be reset between frames
-  if (!grid || !grid->cells) {
-    printf("WARNING: spatial_grid_clear called with null grid or cells\n");
-    return; // Grid not initialized
+  grid->cell_start = NULL;
+  grid->cell_end = NULL;
+  grid->occupied = NULL;
+  grid->occupied_count = 0;
+  grid->cell_entities = NULL;
+  grid->body_cell = NULL;
+  grid->body_count = 0;
+  grid->max_radius = 0.0f;
+  grid->reach = 0;
+}
+
+static int spatial_grid_clamp(int value, int limit) {
+  return value < 0 ? 0 : (value >= limit ? limit - 1 : value);
+}
+
+// Bodies outside the grid land in the nearest edge cell; clamping never
+// moves two cells further apart, so no overlap is lost
+void spatial_grid_cell_coords(const SpatialGrid *grid, float x, float y,
+                              int *cell_x, int *cell_y) {
+  *cell_x = spatial_grid_clamp(
+      (int)floorf((x - grid->grid_origin.x) / grid->cell_size),
+      grid->grid_width);
+  *cell_y = spatial_grid_clamp(
+      (int)floorf((y - grid->grid_origin.y) / grid->cell_size),
+      grid->grid_height);
+}
+
+bool spatial_grid_build(SpatialGrid *grid, Arena *arena, const float *x,
+                        const float *y, const float *radius,
+                        const int32_t *exclude, size_t count) {
+  spatial_grid_clear(grid);
+  if (grid->grid_width <= 0 || grid->grid_height <= 0) {
+    return false;
   }
 
-  int total_cells = grid->grid_width * grid->grid_height;
+  // One allocation per build for all five arrays
+  size_t cell_count = (size_t)grid->grid_width * (size_t)grid->grid_height;
+  size_t needed = ((cell_count + 1) + cell_count + 3 * count) * sizeof(uint32_t);
+  uint32_t *block = (uint32_t *)arena_alloc(arena, needed);
+  if (!block) {
+    ArenaStats stats = {0};
+    arena_get_stats(arena, &stats);
+    fprintf(stderr,
+            "Failed to allocate spatial grid arrays (%zu bytes, arena %zu/%zu)\n",
+            needed, stats.used_bytes, stats.total_size);
+    return false;
+  }
+  grid->cell_start = block;
+  grid->cell_end = block + 1;
+  uint32_t *cursor = block + cell_count + 1;
+  grid->cell_entities = cursor + cell_count;
+  grid->body_cell = grid->cell_entities + count;
+  uint32_t *occupied = grid->body_cell + count;
+  grid->occupied = occupied;
+  grid->body_count = count;
+
+  // Pass 1: bin every row and count cell sizes
+  memset(grid->cell_start, 0, (cell_count + 1) * sizeof(uint32_t));
+  for (size_t i = 0; i < count; i++) {
+    if (exclude && exclude[i]) {
+      grid->body_cell[i] = SPATIAL_GRID_NO_CELL;
+      continue;
+    }
+    int cell_x, cell_y;
+    spatial_grid_cell_coords(grid, x[i], y[i], &cell_x, &cell_y);
+    uint32_t cell = (uint32_t)(cell_y * grid->grid_width + cell_x);
+    grid->body_cell[i] = cell;
+    grid->cell_start[cell + 1]++;
+    if (radius[i] > grid->max_radius) {
+      grid->max_radius = radius[i];
+    }
+  }
 
-  for (int i = 0; i < total_cells; i++) {
-    grid->cells[i].entities = NULL;
+  // Prefix sum into start offsets, then pass 2 scatters rows in order
+  for (size_t c = 0; c < cell_count; c++) {
+    if (grid->cell_start[c + 1]) {
+      occupied[grid->occupied_count++] = (uint32_t)c;
+    }
+    grid->cell_start[c + 1] += grid->cell_start[c];
+    cursor[c] = grid->cell_start[c];
+  }
+  for (size_t i = 0; i < count; i++) {
+    uint32_t cell = grid->body_cell[i];
+    if (cell != SPATIAL_GRID_NO_CELL) {
+      grid->cell_entities[cursor[cell]++] = (uint32_t)i;
+    }
   }
-}
 
-static int spatial_grid_hash(SpatialGrid *grid, int x, int y) {
-  if (x < 0 || x >= grid->grid_width || y < 0 || y >= grid->grid_height) {
-    return -1;
+  // Two bodies overlap only if their centers are within 2 * max_radius
+  grid->reach = (int)ceilf(2.0f * grid->max_radius / grid->cell_size);
+  if (grid->reach < 1) {
+    grid->reach = 1;
   }
-  return y * grid->grid_width + x;
+  return true;
 }
 
-static void spatial_grid_get_cell_coords(SpatialGrid *grid, Vec3 position,
-                                         int *x, int *y) {
-  *x = (int)((position.x - grid->grid_origin.x) / grid->cell_size);
-  *y = (int)((position.y - grid->grid_origin.y) / grid->cell_size);
+// Reset the cells the last build filled (all of them after the grid's size
+// changed) and make room for row_count more
+static bool spatial_grid_cells_prepare(SpatialGridCells *cells,
+                                       size_t cell_count, size_t row_count) {
+  if (cells->cell_count != cell_count) {
+    uint32_t *start =
+        (uint32_t *)realloc(cells->start, cell_count * sizeof(uint32_t));
+    if (start) {
+      cells->start = start;
+    }
+    uint32_t *end =
+        start ? (uint32_t *)realloc(cells->end, cell_count * sizeof(uint32_t))
+              : NULL;
+    if (!end) {
+      fprintf(stderr, "Failed to allocate grid cell ranges (%zu cells)\n",
+              cell_count);
+      return false;
+    }
+    cells->end = end;
+    cells->cell_count = cell_count;
+    memset(cells->start, 0, cell_count * sizeof(uint32_t));
+    memset(cells->end, 0, cell_count * sizeof(uint32_t));
+  } else {
+    for (size_t i = 0; i < cells->occupied_count; i++) {
+      cells->start[cells->occupied[i]] = 0;
+      cells->end[cells->occupied[i]] = 0;
+    }
+  }
+  cells->occupied_count = 0;
+
+  if (row_count > cells->occupied_capacity) {
+    size_t capacity = cells->occupied_capacity ? cells->occupied_capacity : 256;
+    while (capacity < row_count) {
+      capacity *= 2;
+    }
+    uint32_t *occupied =
+        (uint32_t *)realloc(cells->occupied, capacity * sizeof(uint32_t));
+    if (!occupied) {
+      fprintf(stderr, "Failed to grow grid cell list (%zu cells)\n", capacity);
+      return false;
+    }
+    cells->occupied = occupied;
+    cells->occupied_capacity = capacity;
+  }
+  return true;
 }
 
-void spatial_grid_insert(SpatialGrid *grid, Arena *arena, Entity entity,
-                         Vec3 position, float radius) {
-  if (!grid || !grid->cells || !arena) {
-    printf(
-        "ERROR: spatial_grid_insert called with null grid, cells, or arena\n");
-    return;
+bool spatial_grid_build_rows(SpatialGrid *grid, Arena *arena,
+                             SpatialGridCells *cells, const float *x,
+                             const float *y, const float *radius,
+                             const uint32_t *rows, size_t row_count) {
+  spatial_grid_clear(grid);
+  if (grid->grid_width <= 0 || grid->grid_height <= 0) {
+    return false;
+  }
+  size_t cell_count = (size_t)grid->grid_width * (size_t)grid->grid_height;
+  if (!spatial_grid_cells_prepare(cells, cell_count, row_count)) {
+    return false;
   }
 
-  // Calculate which cells this entity overlaps (considering its radius)
-  int min_x, min_y, max_x, max_y;
+  size_t needed = 2 * row_count * sizeof(uint32_t);
+  uint32_t *block = (uint32_t *)arena_alloc(arena, needed ? needed : 1);
+  if (!block) {
+    ArenaStats stats = {0};
+    arena_get_stats(arena, &stats);
+    fprintf(stderr,
+            "Failed to allocate spatial grid arrays (%zu bytes, arena %zu/%zu)\n",
+            needed, stats.used_bytes, stats.total_size);
+    return false;
+  }
+  grid->cell_start = cells->start;
+  grid->cell_end = cells->end;
+  grid->cell_entities = block;
+  grid->body_cell = block + row_count;
+  grid->body_count = row_count;
+
+  // Pass 1: bin every row, counting into end and listing each cell once
+  for (size_t i = 0; i < row_count; i++) {
+    uint32_t row = rows[i];
+    int cell_x, cell_y;
+    spatial_grid_cell_coords(grid, x[row], y[row], &cell_x, &cell_y);
+    uint32_t cell = (uint32_t)(cell_y * grid->grid_width + cell_x);
+    grid->body_cell[i] = cell;
+    if (cells->end[cell]++ == 0) {
+      cells->occupied[cells->occupied_count++] = cell;
+    }
+    if (radius[row] > grid->max_radius) {
+      grid->max_radius = radius[row];
+    }
+  }
 
-  Vec3 min_pos = (Vec3){position.x - radius, position.y - radius, 0.0f};
-  Vec3 max_pos = (Vec3){position.x + radius, position.y + radius, 0.0f};
-
-  spatial_grid_get_cell_coords(grid, min_pos, &min_x, &min_y);
-  spatial_grid_get_cell_coords(grid, max_pos, &max_x, &max_y);
-
-  // Insert entity into all overlapping cells using arena allocation
-  for (int y = min_y; y <= max_y; y++) {
-    for (int x = min_x; x <= max_x; x++) {
-      int cell_index = spatial_grid_hash(grid, x, y);
-      if (cell_index >= 0) {
-        EntityNode *node = (EntityNode *)arena_alloc(arena, sizeof(EntityNode));
-        if (node) {
-          node->entity = entity;
-          node->next = grid->cells[cell_index].entities;
-          grid->cells[cell_index].entities = node;
-        } else {
-          printf(
-              "ERROR: Failed to allocate EntityNode from arena for entity %d\n",
-              entity);
-          ArenaStats stats = {0};
-          arena_get_stats(arena, &stats);
-          printf("Arena stats: Size=%zu, Used=%zu, Free=%zu\n",
-                 stats.total_size, stats.used_bytes, stats.free_bytes);
-          return; // Early return to prevent further crashes
-        }
+  // Offsets in cell order, with end as the cursor for pass 2, so the layout
+  // matches a full build of the same rows. A crowded grid is cheaper to
+  // rescan than to sort.
+  if (cells->occupied_count > cell_count / 16) {
+    size_t listed = 0;
+    for (size_t c = 0; c < cell_count; c++) {
+      if (cells->end[c]) {
+        cells->occupied[listed++] = (uint32_t)c;
       }
     }
+  } else {
+    qsort(cells->occupied, cells->occupied_count, sizeof(uint32_t),
+          physics_compare_rows);
+  }
+  uint32_t offset = 0;
+  for (size_t i = 0; i < cells->occupied_count; i++) {
+    uint32_t cell = cells->occupied[i];
+    uint32_t size = cells->end[cell];
+    cells->start[cell] = offset;
+    cells->end[cell] = offset;
+    offset += size;
   }
+  for (size_t i = 0; i < row_count; i++) {
+    grid->cell_entities[cells->end[grid->body_cell[i]]++] = rows[i];
+  }
+  grid->occupied = cells->occupied;
+  grid->occupied_count = cells->occupied_count;
+
+  grid->reach = (int)ceilf(2.0f * grid->max_radius / grid->cell_size);
+  if (grid->reach < 1) {
+    grid->reach = 1;
+  }
+  return true;
 }
 
-void spatial_grid_get_potential_collisions(SpatialGrid *grid, Entity entity,
-                                           Vec3 position, float radius,
-                                           Entity **out_entities,
-                                           int *out_count) {
-  static Entity
-      potential_entities[PHYSICS_SPATIAL_BUFFER_SIZE]; // Static buffer to avoid
-                                                       // allocation
-  int count = 0;
+void spatial_grid_cells_cleanup(SpatialGridCells *cells) {
+  free(cells->start);
+  free(cells->end);
+  free(cells->occupied);
+  *cells = (SpatialGridCells){0}; // ZII
+}
 
-  // Calculate which cells this entity overlaps
-  int min_x, min_y, max_x, max_y;
+size_t spatial_grid_query(const SpatialGrid *grid, float x, float y,
+                          float radius, uint32_t *out_rows, size_t max_rows) {
+  if (!grid->cell_start) {
+    return 0;
+  }
 
-  Vec3 min_pos = (Vec3){position.x - radius, position.y - radius, 0.0f};
-  Vec3 max_pos = (Vec3){position.x + radius, position.y + radius, 0.0f};
-
-  spatial_grid_get_cell_coords(grid, min_pos, &min_x, &min_y);
-  spatial_grid_get_cell_coords(grid, max_pos, &max_x, &max_y);
-
-  // Collect all entities from overlapping cells
-  for (int y = min_y; y <= max_y && count < PHYSICS_SPATIAL_BUFFER_SIZE; y++) {
-    for (int x = min_x; x <= max_x && count < PHYSICS_SPATIAL_BUFFER_SIZE;
-         x++) {
-      int cell_index = spatial_grid_hash(grid, x, y);
-      if (cell_index >= 0) {
-        EntityNode *current = grid->cells[cell_index].entities;
-        while (current && count < PHYSICS_SPATIAL_BUFFER_SIZE) {
-          // Don't include the entity itself and avoid duplicates
-          if (current->entity != entity) {
-            bool already_added = false;
-            for (int i = 0; i < count; i++) {
-              if (potential_entities[i] == current->entity) {
-                already_added = true;
-                break;
-              }
-            }
-            if (!already_added) {
-              potential_entities[count++] = current->entity;
-            }
-          }
-          current = current->next;
+  float extent = radius + grid->max_radius;
+  int min_x, min_y, max_x, max_y;
+  spatial_grid_cell_coords(grid, x - extent, y - extent, &min_x, &min_y);
+  spatial_grid_cell_coords(grid, x + extent, y + extent, &max_x, &max_y);
+
+  size_t count = 0;
+  for (int cy = min_y; cy <= max_y; cy++) {
+    for (int cx = min_x; cx <= max_x; cx++) {
+      size_t cell = (size_t)cy * grid->grid_width + cx;
+      for (uint32_t k = grid->cell_start[cell]; k < grid->cell_end[cell]; k++) {
+        if (count < max_rows) {
+          out_rows[count] = grid->cell_entities[k];
         }
+        count++;
       }
     }
   }
-
-  *out_entities = potential_entities;
-  *out_count = count;
+  return count;
 }
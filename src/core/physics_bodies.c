@@ -0,0 +1,389 @@
+#include "physics_bodies.h"
+#include "physics.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PHYSICS_SIMD_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PHYSICS_SIMD_SSE2 1
+#endif
+
+#define PHYSICS_BODY_ARRAY_COUNT 15
+
+bool physics_bodies_reserve(PhysicsBodies *bodies, size_t capacity) {
+  if (capacity <= bodies->capacity) {
+    return true;
+  }
+
+  // Grow geometrically so a slowly growing world doesn't reallocate each step
+  size_t new_capacity = bodies->capacity ? bodies->capacity : 1024;
+  while (new_capacity < capacity) {
+    new_capacity *= 2;
+  }
+
+  // All element types are 4 bytes; pad each array to keep the next aligned.
+  // Capacities are powers of two, so without the extra cache line every
+  // array's row i would map to the same cache set and a row-wise pass over
+  // all fifteen would keep evicting itself.
+  size_t stride = ((new_capacity * sizeof(float) + PHYSICS_BODY_ALIGNMENT - 1) &
+                   ~(size_t)(PHYSICS_BODY_ALIGNMENT - 1)) +
+                  PHYSICS_BODY_ARRAY_STAGGER;
+  char *block = (char *)malloc(stride * PHYSICS_BODY_ARRAY_COUNT +
+                               PHYSICS_BODY_ALIGNMENT);
+  if (!block) {
+    fprintf(stderr, "Failed to allocate physics body store (%zu bodies)\n",
+            new_capacity);
+    return false;
+  }
+
+  free(bodies->block);
+  bodies->block = block;
+  bodies->capacity = new_capacity;
+
+  char *base = (char *)(((uintptr_t)block + PHYSICS_BODY_ALIGNMENT - 1) &
+                        ~(uintptr_t)(PHYSICS_BODY_ALIGNMENT - 1));
+  float **arrays[] = {&bodies->x,  &bodies->y,  &bodies->old_x,
+                      &bodies->old_y, &bodies->ax, &bodies->ay,
+                      &bodies->vx, &bodies->vy, &bodies->radius,
+                      &bodies->inv_mass};
+  for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+    *arrays[i] = (float *)(base + i * stride);
+  }
+  bodies->sleeping = (int32_t *)(base + 10 * stride);
+  bodies->sleep_timer = (int32_t *)(base + 11 * stride);
+  bodies->island = (uint32_t *)(base + 12 * stride);
+  bodies->entity = (uint32_t *)(base + 13 * stride);
+  bodies->tree_proxy = (uint32_t *)(base + 14 * stride);
+  return true;
+}
+
+void physics_bodies_cleanup(PhysicsBodies *bodies) {
+  free(bodies->block);
+  memset(bodies, 0, sizeof(PhysicsBodies));
+}
+
+const char *physics_bodies_simd_name(void) {
+#if defined(PHYSICS_SIMD_AVX2)
+  return "avx2";
+#elif defined(PHYSICS_SIMD_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+// Thresholds are compared squared to avoid a sqrt per body
+#define WAKE_SPEED_SQ                                                          \
+  (PHYSICS_WAKE_VELOCITY_THRESHOLD * PHYSICS_WAKE_VELOCITY_THRESHOLD)
+#define SLEEP_SPEED_SQ                                                         \
+  (PHYSICS_SLEEP_VELOCITY_THRESHOLD * PHYSICS_SLEEP_VELOCITY_THRESHOLD)
+
+// Reference implementation; the SIMD kernels below are lane-wise copies of it
+static int32_t sleep_steps(const PhysicsIntegrateParams *p) {
+  return p->sleep_steps > 0 ? p->sleep_steps : PHYSICS_SLEEP_TIME_THRESHOLD;
+}
+
+static void integrate_scalar(PhysicsBodies *b, size_t begin, size_t end,
+                             const PhysicsIntegrateParams *p) {
+  const int32_t steps = sleep_steps(p);
+  const float inv_dt = 1.0f / p->delta_time;
+  const float dt_sq = p->delta_time * p->delta_time;
+
+  for (size_t i = begin; i < end; i++) {
+    float x = b->x[i];
+    float y = b->y[i];
+    float dx = x - b->old_x[i];
+    float dy = y - b->old_y[i];
+    float vx = dx * inv_dt;
+    float vy = dy * inv_dt;
+    float speed_sq = vx * vx + vy * vy;
+    b->vx[i] = vx;
+    b->vy[i] = vy;
+
+    if (b->sleeping[i]) {
+      // Wake on significant motion or external force, else stay put
+      float accel_sq = b->ax[i] * b->ax[i] + b->ay[i] * b->ay[i];
+      if (speed_sq > WAKE_SPEED_SQ || accel_sq > WAKE_SPEED_SQ) {
+        b->sleeping[i] = 0;
+        b->sleep_timer[i] = 0;
+      } else {
+        b->ax[i] = 0.0f;
+        b->ay[i] = 0.0f;
+        continue;
+      }
+    } else if (speed_sq < SLEEP_SPEED_SQ) {
+      if (++b->sleep_timer[i] >= steps) {
+        b->sleeping[i] = 1;
+        b->vx[i] = 0.0f;
+        b->vy[i] = 0.0f;
+        b->ax[i] = 0.0f;
+        b->ay[i] = 0.0f;
+        continue;
+      }
+    } else {
+      b->sleep_timer[i] = 0;
+    }
+
+    float ax = b->ax[i] + p->gravity_x;
+    float ay = b->ay[i] + p->gravity_y;
+    b->x[i] = x + (dx * p->damping + ax * dt_sq);
+    b->y[i] = y + (dy * p->damping + ay * dt_sq);
+    b->old_x[i] = x;
+    b->old_y[i] = y;
+    b->ax[i] = 0.0f;
+    b->ay[i] = 0.0f;
+  }
+}
+
+static void constrain_scalar(PhysicsBodies *b, size_t begin, size_t end,
+                             float cx, float cy, float radius) {
+  for (size_t i = begin; i < end; i++) {
+    float dx = cx - b->x[i];
+    float dy = cy - b->y[i];
+    float distance = sqrtf(dx * dx + dy * dy);
+    float max_distance = radius - b->radius[i];
+    if (distance > max_distance) {
+      float inv_distance = 1.0f / distance;
+      b->x[i] = cx + (dx * inv_distance) * -max_distance;
+      b->y[i] = cy + (dy * inv_distance) * -max_distance;
+    }
+  }
+}
+
+#if defined(PHYSICS_SIMD_AVX2)
+
+#define LANES 8
+
+static inline __m256 select_ps(__m256 mask, __m256 a, __m256 b) {
+  return _mm256_blendv_ps(b, a, mask);
+}
+
+static size_t integrate_simd(PhysicsBodies *b, size_t begin, size_t end,
+                             const PhysicsIntegrateParams *p) {
+  const __m256 inv_dt = _mm256_set1_ps(1.0f / p->delta_time);
+  const __m256 dt_sq = _mm256_set1_ps(p->delta_time * p->delta_time);
+  const __m256 damping = _mm256_set1_ps(p->damping);
+  const __m256 gravity_x = _mm256_set1_ps(p->gravity_x);
+  const __m256 gravity_y = _mm256_set1_ps(p->gravity_y);
+  const __m256 wake_sq = _mm256_set1_ps(WAKE_SPEED_SQ);
+  const __m256 sleep_sq = _mm256_set1_ps(SLEEP_SPEED_SQ);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i timer_limit = _mm256_set1_epi32(sleep_steps(p) - 1);
+
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES) {
+    __m256 x = _mm256_loadu_ps(b->x + i);
+    __m256 y = _mm256_loadu_ps(b->y + i);
+    __m256 ax = _mm256_loadu_ps(b->ax + i);
+    __m256 ay = _mm256_loadu_ps(b->ay + i);
+    __m256 dx = _mm256_sub_ps(x, _mm256_loadu_ps(b->old_x + i));
+    __m256 dy = _mm256_sub_ps(y, _mm256_loadu_ps(b->old_y + i));
+    __m256 vx = _mm256_mul_ps(dx, inv_dt);
+    __m256 vy = _mm256_mul_ps(dy, inv_dt);
+    __m256 speed_sq = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy));
+    __m256 accel_sq = _mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay));
+    __m256i sleeping_i = _mm256_loadu_si256((const __m256i *)(b->sleeping + i));
+    __m256i timer = _mm256_loadu_si256((const __m256i *)(b->sleep_timer + i));
+
+    __m256 asleep = _mm256_castsi256_ps(
+        _mm256_cmpgt_epi32(sleeping_i, _mm256_setzero_si256()));
+    __m256 wake = _mm256_and_ps(
+        asleep, _mm256_or_ps(_mm256_cmp_ps(speed_sq, wake_sq, _CMP_GT_OQ),
+                             _mm256_cmp_ps(accel_sq, wake_sq, _CMP_GT_OQ)));
+    __m256 stay = _mm256_andnot_ps(wake, asleep);
+    __m256 slow =
+        _mm256_andnot_ps(asleep, _mm256_cmp_ps(speed_sq, sleep_sq, _CMP_LT_OQ));
+
+    // Timer: +1 while slow, kept while asleep, 0 otherwise
+    __m256i new_timer = _mm256_or_si256(
+        _mm256_and_si256(_mm256_castps_si256(slow), _mm256_add_epi32(timer, one)),
+        _mm256_and_si256(_mm256_castps_si256(stay), timer));
+    __m256 fall = _mm256_and_ps(
+        slow, _mm256_castsi256_ps(_mm256_cmpgt_epi32(new_timer, timer_limit)));
+    __m256 rest = _mm256_or_ps(stay, fall);
+
+    __m256 new_x = _mm256_add_ps(
+        x, _mm256_add_ps(_mm256_mul_ps(dx, damping),
+                         _mm256_mul_ps(_mm256_add_ps(ax, gravity_x), dt_sq)));
+    __m256 new_y = _mm256_add_ps(
+        y, _mm256_add_ps(_mm256_mul_ps(dy, damping),
+                         _mm256_mul_ps(_mm256_add_ps(ay, gravity_y), dt_sq)));
+
+    _mm256_storeu_ps(b->x + i, select_ps(rest, x, new_x));
+    _mm256_storeu_ps(b->y + i, select_ps(rest, y, new_y));
+    _mm256_storeu_ps(b->old_x + i,
+                     select_ps(rest, _mm256_loadu_ps(b->old_x + i), x));
+    _mm256_storeu_ps(b->old_y + i,
+                     select_ps(rest, _mm256_loadu_ps(b->old_y + i), y));
+    _mm256_storeu_ps(b->vx + i, _mm256_andnot_ps(fall, vx));
+    _mm256_storeu_ps(b->vy + i, _mm256_andnot_ps(fall, vy));
+    _mm256_storeu_ps(b->ax + i, zero);
+    _mm256_storeu_ps(b->ay + i, zero);
+    _mm256_storeu_si256((__m256i *)(b->sleeping + i),
+                        _mm256_and_si256(_mm256_castps_si256(rest), one));
+    _mm256_storeu_si256((__m256i *)(b->sleep_timer + i), new_timer);
+  }
+  return i;
+}
+
+static size_t constrain_simd(PhysicsBodies *b, size_t begin, size_t end,
+                             float center_x, float center_y, float radius) {
+  const __m256 cx = _mm256_set1_ps(center_x);
+  const __m256 cy = _mm256_set1_ps(center_y);
+  const __m256 boundary = _mm256_set1_ps(radius);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES) {
+    __m256 x = _mm256_loadu_ps(b->x + i);
+    __m256 y = _mm256_loadu_ps(b->y + i);
+    __m256 dx = _mm256_sub_ps(cx, x);
+    __m256 dy = _mm256_sub_ps(cy, y);
+    __m256 distance = _mm256_sqrt_ps(
+        _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+    __m256 max_distance = _mm256_sub_ps(boundary, _mm256_loadu_ps(b->radius + i));
+    __m256 outside = _mm256_cmp_ps(distance, max_distance, _CMP_GT_OQ);
+    if (_mm256_movemask_ps(outside) == 0) {
+      continue; // Common case: the whole batch is inside
+    }
+
+    __m256 inv_distance = _mm256_div_ps(one, distance);
+    __m256 neg_max = _mm256_xor_ps(max_distance, sign);
+    __m256 new_x = _mm256_add_ps(cx, _mm256_mul_ps(_mm256_mul_ps(dx, inv_distance), neg_max));
+    __m256 new_y = _mm256_add_ps(cy, _mm256_mul_ps(_mm256_mul_ps(dy, inv_distance), neg_max));
+    _mm256_storeu_ps(b->x + i, select_ps(outside, new_x, x));
+    _mm256_storeu_ps(b->y + i, select_ps(outside, new_y, y));
+  }
+  return i;
+}
+
+#elif defined(PHYSICS_SIMD_SSE2)
+
+#define LANES 4
+
+// SSE2 has no blendv
+static inline __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static size_t integrate_simd(PhysicsBodies *b, size_t begin, size_t end,
+                             const PhysicsIntegrateParams *p) {
+  const __m128 inv_dt = _mm_set1_ps(1.0f / p->delta_time);
+  const __m128 dt_sq = _mm_set1_ps(p->delta_time * p->delta_time);
+  const __m128 damping = _mm_set1_ps(p->damping);
+  const __m128 gravity_x = _mm_set1_ps(p->gravity_x);
+  const __m128 gravity_y = _mm_set1_ps(p->gravity_y);
+  const __m128 wake_sq = _mm_set1_ps(WAKE_SPEED_SQ);
+  const __m128 sleep_sq = _mm_set1_ps(SLEEP_SPEED_SQ);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128i one = _mm_set1_epi32(1);
+  const __m128i timer_limit = _mm_set1_epi32(sleep_steps(p) - 1);
+
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES) {
+    __m128 x = _mm_loadu_ps(b->x + i);
+    __m128 y = _mm_loadu_ps(b->y + i);
+    __m128 ax = _mm_loadu_ps(b->ax + i);
+    __m128 ay = _mm_loadu_ps(b->ay + i);
+    __m128 dx = _mm_sub_ps(x, _mm_loadu_ps(b->old_x + i));
+    __m128 dy = _mm_sub_ps(y, _mm_loadu_ps(b->old_y + i));
+    __m128 vx = _mm_mul_ps(dx, inv_dt);
+    __m128 vy = _mm_mul_ps(dy, inv_dt);
+    __m128 speed_sq = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy));
+    __m128 accel_sq = _mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay));
+    __m128i sleeping_i = _mm_loadu_si128((const __m128i *)(b->sleeping + i));
+    __m128i timer = _mm_loadu_si128((const __m128i *)(b->sleep_timer + i));
+
+    __m128 asleep =
+        _mm_castsi128_ps(_mm_cmpgt_epi32(sleeping_i, _mm_setzero_si128()));
+    __m128 wake = _mm_and_ps(asleep, _mm_or_ps(_mm_cmpgt_ps(speed_sq, wake_sq),
+                                               _mm_cmpgt_ps(accel_sq, wake_sq)));
+    __m128 stay = _mm_andnot_ps(wake, asleep);
+    __m128 slow = _mm_andnot_ps(asleep, _mm_cmplt_ps(speed_sq, sleep_sq));
+
+    // Timer: +1 while slow, kept while asleep, 0 otherwise
+    __m128i new_timer = _mm_or_si128(
+        _mm_and_si128(_mm_castps_si128(slow), _mm_add_epi32(timer, one)),
+        _mm_and_si128(_mm_castps_si128(stay), timer));
+    __m128 fall = _mm_and_ps(
+        slow, _mm_castsi128_ps(_mm_cmpgt_epi32(new_timer, timer_limit)));
+    __m128 rest = _mm_or_ps(stay, fall);
+
+    __m128 new_x = _mm_add_ps(
+        x, _mm_add_ps(_mm_mul_ps(dx, damping),
+                      _mm_mul_ps(_mm_add_ps(ax, gravity_x), dt_sq)));
+    __m128 new_y = _mm_add_ps(
+        y, _mm_add_ps(_mm_mul_ps(dy, damping),
+                      _mm_mul_ps(_mm_add_ps(ay, gravity_y), dt_sq)));
+
+    _mm_storeu_ps(b->x + i, select_ps(rest, x, new_x));
+    _mm_storeu_ps(b->y + i, select_ps(rest, y, new_y));
+    _mm_storeu_ps(b->old_x + i, select_ps(rest, _mm_loadu_ps(b->old_x + i), x));
+    _mm_storeu_ps(b->old_y + i, select_ps(rest, _mm_loadu_ps(b->old_y + i), y));
+    _mm_storeu_ps(b->vx + i, _mm_andnot_ps(fall, vx));
+    _mm_storeu_ps(b->vy + i, _mm_andnot_ps(fall, vy));
+    _mm_storeu_ps(b->ax + i, zero);
+    _mm_storeu_ps(b->ay + i, zero);
+    _mm_storeu_si128((__m128i *)(b->sleeping + i),
+                     _mm_and_si128(_mm_castps_si128(rest), one));
+    _mm_storeu_si128((__m128i *)(b->sleep_timer + i), new_timer);
+  }
+  return i;
+}
+
+static size_t constrain_simd(PhysicsBodies *b, size_t begin, size_t end,
+                             float center_x, float center_y, float radius) {
+  const __m128 cx = _mm_set1_ps(center_x);
+  const __m128 cy = _mm_set1_ps(center_y);
+  const __m128 boundary = _mm_set1_ps(radius);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 sign = _mm_set1_ps(-0.0f);
+
+  size_t i = begin;
+  for (; i + LANES <= end; i += LANES) {
+    __m128 x = _mm_loadu_ps(b->x + i);
+    __m128 y = _mm_loadu_ps(b->y + i);
+    __m128 dx = _mm_sub_ps(cx, x);
+    __m128 dy = _mm_sub_ps(cy, y);
+    __m128 distance =
+        _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+    __m128 max_distance = _mm_sub_ps(boundary, _mm_loadu_ps(b->radius + i));
+    __m128 outside = _mm_cmpgt_ps(distance, max_distance);
+    if (_mm_movemask_ps(outside) == 0) {
+      continue; // Common case: the whole batch is inside
+    }
+
+    __m128 inv_distance = _mm_div_ps(one, distance);
+    __m128 neg_max = _mm_xor_ps(max_distance, sign);
+    __m128 new_x = _mm_add_ps(cx, _mm_mul_ps(_mm_mul_ps(dx, inv_distance), neg_max));
+    __m128 new_y = _mm_add_ps(cy, _mm_mul_ps(_mm_mul_ps(dy, inv_distance), neg_max));
+    _mm_storeu_ps(b->x + i, select_ps(outside, new_x, x));
+    _mm_storeu_ps(b->y + i, select_ps(outside, new_y, y));
+  }
+  return i;
+}
+
+#endif
+
+void physics_bodies_integrate(PhysicsBodies *bodies, size_t begin, size_t end,
+                              const PhysicsIntegrateParams *params) {
+#if defined(PHYSICS_SIMD_AVX2) || defined(PHYSICS_SIMD_SSE2)
+  begin = integrate_simd(bodies, begin, end, params);
+#endif
+  integrate_scalar(bodies, begin, end, params); // Tail
+}
+
+void physics_bodies_constrain(PhysicsBodies *bodies, size_t begin, size_t end,
+                              float center_x, float center_y, float radius) {
+#if defined(PHYSICS_SIMD_AVX2) || defined(PHYSICS_SIMD_SSE2)
+  begin = constrain_simd(bodies, begin, end, center_x, center_y, radius);
+#endif
+  constrain_scalar(bodies, begin, end, center_x, center_y, radius);
+}
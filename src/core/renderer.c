@@ -27,6 +27,7 @@ int renderer_init(Renderer *renderer, ECS *ecs) {
 
   g_renderer = renderer;
 
+  // Registered without access sets: GL calls must stay on the main thread
   ComponentMask required =
       (1ULL << renderer->transform_type) | (1ULL << renderer->renderable_type);
   ecs_register_system(ecs, renderer_system_update, required);
@@ -119,15 +120,11 @@ void renderer_render_quad(Renderer *renderer, Transform *transform,
 }
 
 void renderer_render_entities(Renderer *renderer) {
-  for (Entity entity = 1; entity < renderer->ecs->next_entity_id; entity++) {
-    if (!ecs_entity_active(renderer->ecs, entity))
-      continue;
-
-    if (!ecs_has_component(renderer->ecs, entity, renderer->transform_type) ||
-        !ecs_has_component(renderer->ecs, entity, renderer->renderable_type)) {
-      continue;
-    }
-
+  ComponentMask mask =
+      (1ULL << renderer->transform_type) | (1ULL << renderer->renderable_type);
+  EcsQueryIter iter = ecs_query_iter(renderer->ecs, mask);
+  Entity entity;
+  while (ecs_query_next(&iter, &entity)) {
     Transform *transform = (Transform *)ecs_get_component(
         renderer->ecs, entity, renderer->transform_type);
     Renderable *renderable = (Renderable *)ecs_get_component(
@@ -0,0 +1,160 @@
+#define _POSIX_C_SOURCE 200809L
+#include "thread_pool.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// worker_index of the current thread: 0 for the submitting thread, set once
+// by each worker. Used so nested serial runs keep per-thread data separate.
+static __thread uint32_t tls_worker_index = 0;
+
+static void run_tasks(ThreadPool *pool, ThreadPoolTaskFunc func, void *context,
+                      size_t task_count, uint32_t worker_index) {
+  for (;;) {
+    size_t task = __atomic_fetch_add(&pool->next_task, 1, __ATOMIC_RELAXED);
+    if (task >= task_count) {
+      break;
+    }
+    func(context, task, worker_index);
+  }
+}
+
+static void *worker_main(void *arg) {
+  ThreadPoolWorker *worker = (ThreadPoolWorker *)arg;
+  ThreadPool *pool = worker->pool;
+  tls_worker_index = worker->index;
+
+  uint64_t seen_job = 0;
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->shutting_down &&
+           (pool->job_id == seen_job || !pool->job_running)) {
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+    }
+    if (pool->shutting_down) {
+      break;
+    }
+
+    // Join the job under the lock so the submitter cannot post the next one
+    // until this worker has left
+    seen_job = pool->job_id;
+    ThreadPoolTaskFunc func = pool->func;
+    void *context = pool->context;
+    size_t task_count = pool->task_count;
+    pool->busy_workers++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    run_tasks(pool, func, context, task_count, worker->index);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->busy_workers--;
+    if (pool->busy_workers == 0) {
+      pthread_cond_signal(&pool->done_cond);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  arena_scratch_thread_cleanup();
+  return NULL;
+}
+
+bool thread_pool_init(ThreadPool *pool, uint32_t thread_count) {
+  // ZII: pool should already be zero-initialized
+  if (thread_count == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = cpus > 1 ? (uint32_t)(cpus - 1) : 0;
+  }
+  if (thread_count > THREAD_POOL_MAX_THREADS) {
+    thread_count = THREAD_POOL_MAX_THREADS;
+  }
+
+  if (pthread_mutex_init(&pool->mutex, NULL) != 0) {
+    return false;
+  }
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+  pool->initialized = true;
+
+  for (uint32_t i = 0; i < thread_count; i++) {
+    ThreadPoolWorker *worker = &pool->workers[i];
+    worker->pool = pool;
+    worker->index = i + 1;
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+      fprintf(stderr, "Failed to start worker thread %u\n", i);
+      break;
+    }
+    pool->thread_count++;
+  }
+
+  return true;
+}
+
+void thread_pool_cleanup(ThreadPool *pool) {
+  if (!pool->initialized) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->shutting_down = true;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (uint32_t i = 0; i < pool->thread_count; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+  }
+
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_mutex_destroy(&pool->mutex);
+
+  // Reset to ZII state
+  memset(pool, 0, sizeof(ThreadPool));
+}
+
+void thread_pool_run(ThreadPool *pool, size_t task_count,
+                     ThreadPoolTaskFunc func, void *context) {
+  if (!func || task_count == 0) {
+    return;
+  }
+
+  bool parallel = pool && pool->initialized && pool->thread_count > 0 &&
+                  task_count > 1;
+  if (parallel) {
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->job_running) {
+      parallel = false; // Called from inside a task
+    } else {
+      pool->func = func;
+      pool->context = context;
+      pool->task_count = task_count;
+      pool->next_task = 0;
+      pool->job_id++;
+      pool->job_running = true;
+      pthread_cond_broadcast(&pool->work_cond);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+  }
+
+  if (!parallel) {
+    for (size_t i = 0; i < task_count; i++) {
+      func(context, i, tls_worker_index);
+    }
+    return;
+  }
+
+  run_tasks(pool, func, context, task_count, 0);
+
+  // All tasks are claimed; wait for workers still finishing theirs
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->busy_workers > 0) {
+    pthread_cond_wait(&pool->done_cond, &pool->mutex);
+  }
+  pool->job_running = false;
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+uint32_t thread_pool_worker_count(const ThreadPool *pool) {
+  return (pool && pool->initialized ? pool->thread_count : 0) + 1;
+}
+
+uint32_t thread_pool_current_worker(void) { return tls_worker_index; }
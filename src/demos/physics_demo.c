@@ -28,7 +28,8 @@
 #define GRID_SPACING_MULTIPLIER 1.2f // Adequate spacing to prevent initial overlaps
 #define GRID_POSITION_RANDOMNESS 0.3f
 #define SPAWN_HEIGHT_OFFSET 30.0f
-#define MAX_DELTA_TIME 0.033f
+#define PHYSICS_TIMESTEP (1.0f / 120.0f) // Fixed physics rate, independent of frame rate
+#define PHYSICS_MAX_SUBSTEPS 4           // Caps a slow frame at 1/30 s of simulation
 #define MOUSE_INFLUENCE_RADIUS                                                 \
   100.0f // Radius within which mouse affects circles
 #define MOUSE_FORCE_STRENGTH                                                   \
@@ -85,6 +86,7 @@ int main(void) {
   PhysicsWorld physics = {0}; // ZII
   physics_world_init(&physics, &ecs, renderer.transform_type);
   physics_set_boundary(&physics, (Vec3){0.0f, 0.0f, 0.0f}, BOUNDARY_RADIUS);
+  physics_set_fixed_timestep(&physics, PHYSICS_TIMESTEP, PHYSICS_MAX_SUBSTEPS);
 
   // Create random circles distributed within the boundary
   for (int i = 0; i < NUM_CIRCLES; i++) {
@@ -155,14 +157,12 @@ int main(void) {
   while (!window_should_close(window)) {
     window_poll_events();
     input_update(&input);
+    arena_scratch_next_frame();
 
     double current_time = glfwGetTime();
     float delta_time = (float)(current_time - last_time);
     last_time = current_time;
 
-    if (delta_time > MAX_DELTA_TIME)
-      delta_time = MAX_DELTA_TIME;
-
     // Log frame performance
     log_frame_time(delta_time);
 
@@ -170,17 +170,22 @@ int main(void) {
       glfwSetWindowShouldClose(window->handle, GLFW_TRUE);
     }
 
+    // Memory telemetry: per-tag usage (and call sites in debug builds)
+    if (input_key_pressed(&input, GLFW_KEY_M)) {
+      if (memory_telemetry_dump("memory_telemetry.txt")) {
+        printf("Wrote memory_telemetry.txt\n");
+      }
+    }
+
     if (input_key_pressed(&input, GLFW_KEY_SPACE)) {
-      for (Entity entity = 1; entity < ecs.next_entity_id; entity++) {
-        if (!ecs_entity_active(&ecs, entity))
-          continue;
-
-        if (ecs_has_component(&ecs, entity, physics.verlet_type)) {
-          VerletBody *verlet = (VerletBody *)ecs_get_component(
-              &ecs, entity, physics.verlet_type);
-          verlet->acceleration =
-              vec3_add(verlet->acceleration, (Vec3){0.0f, IMPULSE_FORCE, 0.0f});
-        }
+      EcsQueryIter iter = ecs_query_iter(&ecs, 1ULL << physics.verlet_type);
+      Entity entity;
+      while (ecs_query_next(&iter, &entity)) {
+        // Stamped, so sleeping bodies are read back and woken by the force
+        VerletBody *verlet = (VerletBody *)ecs_get_component_mut(
+            &ecs, entity, physics.verlet_type);
+        verlet->acceleration =
+            vec3_add(verlet->acceleration, (Vec3){0.0f, IMPULSE_FORCE, 0.0f});
       }
     }
 
@@ -204,22 +209,27 @@ int main(void) {
 
       Vec3 mouse_pos = (Vec3){world_x, world_y, 0.0f};
 
-      // Apply force to circles within influence radius
-      for (Entity entity = 1; entity < ecs.next_entity_id; entity++) {
-        if (!ecs_entity_active(&ecs, entity))
-          continue;
-
-        if (!ecs_has_component(&ecs, entity, physics.transform_type) ||
-            !ecs_has_component(&ecs, entity, physics.verlet_type) ||
-            !ecs_has_component(&ecs, entity, physics.collider_type))
-          continue;
-
+      // Apply force to circles within influence radius, found through the
+      // physics world's spatial queries rather than a scan of every body
+      ArenaScope scratch = arena_scratch_begin();
+      PhysicsCircleQuery influence = {mouse_pos, MOUSE_INFLUENCE_RADIUS};
+      PhysicsQueryResults nearby = {0}; // ZII
+      if (!physics_query_circles(&physics, &influence, 1, scratch.arena,
+                                 &nearby)) {
+        nearby.query_count = 0;
+      }
+      size_t nearby_count = nearby.query_count ? nearby.offsets[1] : 0;
+      for (size_t i = 0; i < nearby_count; i++) {
+        Entity entity = nearby.entities[i];
         Transform *transform = (Transform *)ecs_get_component(
             &ecs, entity, physics.transform_type);
-        VerletBody *verlet =
-            (VerletBody *)ecs_get_component(&ecs, entity, physics.verlet_type);
+        VerletBody *verlet = (VerletBody *)ecs_get_component_mut(
+            &ecs, entity, physics.verlet_type);
         CircleCollider *collider = (CircleCollider *)ecs_get_component(
             &ecs, entity, physics.collider_type);
+        if (!transform || !verlet || !collider) {
+          continue; // Destroyed since the last physics step
+        }
 
         // Calculate distance from mouse to circle center
         Vec3 to_mouse =
@@ -266,6 +276,7 @@ int main(void) {
           }
         }
       }
+      arena_scope_end(scratch);
     }
 
     glClearColor(0.1f, 0.1f, 0.2f, 1.0f);
@@ -291,6 +302,7 @@ int main(void) {
 
   LOG_INFO("Shutting down physics demo");
   physics_world_cleanup(&physics);
+  arena_scratch_thread_cleanup();
   input_cleanup(&input);
   renderer_cleanup(&renderer);
   ecs_cleanup(&ecs);
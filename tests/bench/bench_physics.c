@@ -0,0 +1,407 @@
+// Headless physics benchmark. Sweeps body counts, radius distributions,
+// collision iteration counts and broadphases with fixed seeds, and reports
+// per-phase step times (mean and percentiles) as CSV or JSON lines, with the
+// mean number of awake bodies.
+//
+//   bin/bench_physics [--bodies 1000,10000,100000] [--radii uniform,bimodal,wide]
+//                     [--iterations 4,8] [--broadphase grid,sweep,tree]
+//                     [--awake 10,100,1000] [--steps N] [--warmup N] [--seed N]
+//                     [--threads N] [--format csv|json] [--out FILE]
+//
+// --awake swaps the settling pile for a sparse lattice that falls asleep
+// body by body, with that many bodies kicked every step so they stay awake:
+// step times should follow the awake count, not the body count.
+//
+// Results go to stdout (or FILE); progress goes to stderr.
+#define _POSIX_C_SOURCE 200809L
+#include "core/components.h"
+#include "core/physics.h"
+#include "core/thread_pool.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BENCH_MAX_VALUES 16
+#define BENCH_FILL 0.45f  // Share of the pile's disc covered by bodies
+#define BENCH_DELTA_TIME (1.0f / 60.0f)
+#define BENCH_SLEEP_WARMUP (PHYSICS_SLEEP_TIME_THRESHOLD + 10)  // Steps for a lattice to fall asleep
+#define BENCH_KICK 400.0f  // Acceleration keeping kicked lattice bodies awake
+
+typedef enum {
+    BENCH_RADII_UNIFORM = 0,  // 2-5
+    BENCH_RADII_BIMODAL,      // 90% at 2, 10% at 8
+    BENCH_RADII_WIDE,         // Log-uniform 1-16
+    BENCH_RADII_COUNT
+} BenchRadii;
+
+static const char* radii_names[BENCH_RADII_COUNT] = {"uniform", "bimodal", "wide"};
+static const char* broadphase_names[] = {"grid", "sweep", "tree"};
+
+typedef struct {
+    int bodies[BENCH_MAX_VALUES];
+    int body_count;
+    int radii[BENCH_MAX_VALUES];
+    int radii_count;
+    int iterations[BENCH_MAX_VALUES];
+    int iteration_count;
+    int broadphases[BENCH_MAX_VALUES];
+    int broadphase_count;
+    int awake[BENCH_MAX_VALUES];  // Kicked bodies per lattice run; none = pile runs
+    int awake_count;
+    int steps;
+    int warmup;
+    uint64_t seed;
+    int threads;
+    bool json;
+    const char* out_path;
+} BenchOptions;
+
+// Step times of one run: column 0 is the whole step, then one per phase,
+// then whatever the phases don't cover (gather, scatter)
+#define BENCH_COLUMNS (PHYSICS_PHASE_COUNT + 2)
+
+static double bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+// splitmix64, so every run places the same bodies on every platform
+static uint64_t bench_next(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static float bench_random(uint64_t* state) {
+    return (float)(bench_next(state) >> 40) / (float)(1u << 24);
+}
+
+static float bench_radius(BenchRadii radii, uint64_t* state) {
+    float t = bench_random(state);
+    switch (radii) {
+        case BENCH_RADII_BIMODAL:
+            return t < 0.9f ? 2.0f : 8.0f;
+        case BENCH_RADII_WIDE:
+            return expf(t * logf(16.0f));
+        default:
+            return 2.0f + t * 3.0f;
+    }
+}
+
+static int parse_name(const char* name, const char** names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Comma-separated numbers, or names when names is set; false on a bad list
+static bool parse_list(const char* text, const char** names, int name_count, int* values, int* count) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", text);
+    *count = 0;
+    for (char* item = strtok(buffer, ","); item; item = strtok(NULL, ",")) {
+        if (*count == BENCH_MAX_VALUES) {
+            return false;
+        }
+        int value = names ? parse_name(item, names, name_count) : atoi(item);
+        if (value < 0 || (!names && value == 0)) {
+            return false;
+        }
+        values[(*count)++] = value;
+    }
+    return *count > 0;
+}
+
+static bool parse_options(int argc, char** argv, BenchOptions* options) {
+    *options = (BenchOptions){0};  // ZII
+    int bodies[] = {1000, 10000, 100000};
+    memcpy(options->bodies, bodies, sizeof(bodies));
+    options->body_count = 3;
+    for (int i = 0; i < BENCH_RADII_COUNT; i++) {
+        options->radii[i] = i;
+    }
+    options->radii_count = BENCH_RADII_COUNT;
+    options->iterations[0] = 4;
+    options->iterations[1] = 8;
+    options->iteration_count = 2;
+    options->broadphases[0] = PHYSICS_BROADPHASE_GRID;
+    options->broadphase_count = 1;
+    options->steps = 100;
+    options->warmup = 30;
+    options->seed = 1;
+    options->threads = 1;
+
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        bool ok = value != NULL;
+        if (strcmp(argv[i], "--bodies") == 0 && ok) {
+            ok = parse_list(value, NULL, 0, options->bodies, &options->body_count);
+        } else if (strcmp(argv[i], "--radii") == 0 && ok) {
+            ok = parse_list(value, radii_names, BENCH_RADII_COUNT, options->radii, &options->radii_count);
+        } else if (strcmp(argv[i], "--iterations") == 0 && ok) {
+            ok = parse_list(value, NULL, 0, options->iterations, &options->iteration_count);
+        } else if (strcmp(argv[i], "--broadphase") == 0 && ok) {
+            ok = parse_list(value, broadphase_names, 3, options->broadphases, &options->broadphase_count);
+        } else if (strcmp(argv[i], "--awake") == 0 && ok) {
+            ok = parse_list(value, NULL, 0, options->awake, &options->awake_count);
+        } else if (strcmp(argv[i], "--steps") == 0 && ok) {
+            options->steps = atoi(value);
+            ok = options->steps > 0;
+        } else if (strcmp(argv[i], "--warmup") == 0 && ok) {
+            options->warmup = atoi(value);
+            ok = options->warmup >= 0;
+        } else if (strcmp(argv[i], "--seed") == 0 && ok) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && ok) {
+            options->threads = atoi(value);
+            ok = options->threads > 0 && options->threads <= THREAD_POOL_MAX_THREADS;
+        } else if (strcmp(argv[i], "--format") == 0 && ok) {
+            options->json = strcmp(value, "json") == 0;
+            ok = options->json || strcmp(value, "csv") == 0;
+        } else if (strcmp(argv[i], "--out") == 0 && ok) {
+            options->out_path = value;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Bad option: %s %s\n", argv[i], value ? value : "");
+            return false;
+        }
+        i++;
+    }
+    return true;
+}
+
+// A jittered lattice filling a disc at BENCH_FILL, inside a boundary with
+// room to spare; the pile settles under gravity during the warmup
+static void bench_create_bodies(PhysicsWorld* world, int count, BenchRadii radii, uint64_t seed) {
+    uint64_t state = seed;
+    float* radius = (float*)malloc((size_t)count * sizeof(float));
+    float area = 0.0f;
+    float largest = 0.0f;
+    for (int i = 0; i < count; i++) {
+        radius[i] = bench_radius(radii, &state);
+        area += (float)M_PI * radius[i] * radius[i];
+        largest = radius[i] > largest ? radius[i] : largest;
+    }
+
+    float spacing = sqrtf(area / BENCH_FILL / (float)count);
+    float pile_radius = sqrtf(area / BENCH_FILL / (float)M_PI);
+    physics_set_boundary(world, (Vec3){0}, pile_radius * 1.3f + 2.0f * largest);
+
+    int placed = 0;
+    for (float y = -pile_radius; placed < count; y += spacing) {
+        for (float x = -pile_radius; x <= pile_radius && placed < count; x += spacing) {
+            float jitter_x = (bench_random(&state) - 0.5f) * spacing * 0.2f;
+            float jitter_y = (bench_random(&state) - 0.5f) * spacing * 0.2f;
+            if (x * x + y * y > pile_radius * pile_radius && y < pile_radius) {
+                continue;  // Outside the disc (past its top, keep stacking)
+            }
+            float r = radius[placed];
+            physics_create_circle(world, (Vec3){x + jitter_x, y + jitter_y, 0.0f}, r, r * r * 0.1f);
+            placed++;
+        }
+    }
+    free(radius);
+}
+
+// A lattice with a gap of a largest diameter between neighbours and no
+// gravity, so every body comes to rest and falls asleep on its own
+static void bench_create_lattice(PhysicsWorld* world, Entity* entities, int count, BenchRadii radii,
+                                 uint64_t seed) {
+    uint64_t state = seed;
+    float* radius = (float*)malloc((size_t)count * sizeof(float));
+    float largest = 0.0f;
+    for (int i = 0; i < count; i++) {
+        radius[i] = bench_radius(radii, &state);
+        largest = radius[i] > largest ? radius[i] : largest;
+    }
+
+    int side = (int)ceilf(sqrtf((float)count));
+    float spacing = 4.0f * largest;
+    float half = (float)(side - 1) * spacing * 0.5f;
+    physics_set_boundary(world, (Vec3){0}, half * 1.5f + 2.0f * largest);
+    world->gravity = (Vec3){0};
+    for (int i = 0; i < count; i++) {
+        Vec3 position = {(float)(i % side) * spacing - half, (float)(i / side) * spacing - half, 0.0f};
+        entities[i] = physics_create_circle(world, position, radius[i], radius[i] * radius[i] * 0.1f);
+    }
+    free(radius);
+}
+
+// Pushes `kicked` bodies spread over the lattice, alternating direction so
+// they shake in place; stamped, as game code changing a sleeper must be
+static void bench_kick(ECS* ecs, const PhysicsWorld* world, const Entity* entities, int count, int kicked,
+                       int step) {
+    for (int k = 0; k < kicked; k++) {
+        Entity entity = entities[(size_t)k * (size_t)count / (size_t)kicked];
+        VerletBody* verlet = (VerletBody*)ecs_get_component_mut(ecs, entity, world->verlet_type);
+        verlet->acceleration.x += (step + k) % 2 ? BENCH_KICK : -BENCH_KICK;
+    }
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const double* sorted, int count, double p) {
+    int rank = (int)ceil(p / 100.0 * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void report(FILE* out, const BenchOptions* options, int bodies, double awake, int radii,
+                   int iterations, int broadphase, const char* column, double* samples, int count) {
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    qsort(samples, (size_t)count, sizeof(double), compare_doubles);
+    double mean = sum / count * 1000.0;
+    double p50 = percentile(samples, count, 50.0) * 1000.0;
+    double p90 = percentile(samples, count, 90.0) * 1000.0;
+    double p99 = percentile(samples, count, 99.0) * 1000.0;
+    double max = samples[count - 1] * 1000.0;
+
+    if (options->json) {
+        fprintf(out,
+                "{\"bodies\":%d,\"awake\":%.0f,\"radii\":\"%s\",\"iterations\":%d,\"broadphase\":\"%s\","
+                "\"threads\":%d,\"simd\":\"%s\",\"seed\":%llu,\"steps\":%d,\"phase\":\"%s\","
+                "\"mean_ms\":%.4f,\"p50_ms\":%.4f,\"p90_ms\":%.4f,\"p99_ms\":%.4f,\"max_ms\":%.4f}\n",
+                bodies, awake, radii_names[radii], iterations, broadphase_names[broadphase], options->threads,
+                physics_bodies_simd_name(), (unsigned long long)options->seed, count, column, mean, p50,
+                p90, p99, max);
+    } else {
+        fprintf(out, "%d,%.0f,%s,%d,%s,%d,%s,%llu,%d,%s,%.4f,%.4f,%.4f,%.4f,%.4f\n", bodies, awake,
+                radii_names[radii], iterations, broadphase_names[broadphase], options->threads, physics_bodies_simd_name(),
+                (unsigned long long)options->seed, count, column, mean, p50, p90, p99, max);
+    }
+}
+
+// kicked > 0 runs the sleeping lattice instead of the pile. The ECS tick
+// advances after every step, as ecs_update_systems does.
+static void run(FILE* out, const BenchOptions* options, ThreadPool* pool, int bodies, int radii,
+                int iterations, int broadphase, int kicked) {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ecs_set_thread_pool(&ecs, pool);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.collision_iterations = iterations;
+    world.broadphase = (PhysicsBroadphase)broadphase;
+    physics_set_seed(&world, options->seed);
+    Entity* entities = NULL;
+    int warmup = options->warmup;
+    if (kicked > 0) {
+        entities = (Entity*)malloc((size_t)bodies * sizeof(Entity));
+        bench_create_lattice(&world, entities, bodies, (BenchRadii)radii, options->seed);
+        kicked = kicked < bodies ? kicked : bodies;
+        warmup = warmup > BENCH_SLEEP_WARMUP ? warmup : BENCH_SLEEP_WARMUP;
+    } else {
+        bench_create_bodies(&world, bodies, (BenchRadii)radii, options->seed);
+    }
+
+    for (int step = 0; step < warmup; step++) {
+        physics_world_step(&world, BENCH_DELTA_TIME);
+        ecs_advance_tick(&ecs);
+    }
+
+    world.profile = true;
+    double awake = 0.0;
+    double* samples = (double*)malloc((size_t)options->steps * BENCH_COLUMNS * sizeof(double));
+    for (int step = 0; step < options->steps; step++) {
+        if (kicked > 0) {
+            bench_kick(&ecs, &world, entities, bodies, kicked, step);
+        }
+        double start = bench_now();
+        physics_world_step(&world, BENCH_DELTA_TIME);
+        double total = bench_now() - start;
+        ecs_advance_tick(&ecs);
+        awake += (double)world.awake_count / options->steps;
+        double* row = samples + (size_t)step * BENCH_COLUMNS;
+        row[0] = total;
+        for (int phase = 0; phase < PHYSICS_PHASE_COUNT; phase++) {
+            row[phase + 1] = world.phase_seconds[phase];
+            total -= world.phase_seconds[phase];
+        }
+        row[BENCH_COLUMNS - 1] = total > 0.0 ? total : 0.0;
+    }
+
+    // Reported column by column, so gather each into a contiguous run
+    double* column = (double*)malloc((size_t)options->steps * sizeof(double));
+    for (int c = 0; c < BENCH_COLUMNS; c++) {
+        for (int step = 0; step < options->steps; step++) {
+            column[step] = samples[(size_t)step * BENCH_COLUMNS + c];
+        }
+        const char* name = c == 0                   ? "step"
+                           : c == BENCH_COLUMNS - 1 ? "other"
+                                                    : physics_phase_name((PhysicsPhase)(c - 1));
+        report(out, options, bodies, awake, radii, iterations, broadphase, name, column, options->steps);
+    }
+    fflush(out);
+
+    free(column);
+    free(samples);
+    free(entities);
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!parse_options(argc, argv, &options)) {
+        return 1;
+    }
+    FILE* out = options.out_path ? fopen(options.out_path, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "Failed to open %s\n", options.out_path);
+        return 1;
+    }
+
+    ThreadPool pool = {0};  // ZII
+    bool threaded = options.threads > 1 && thread_pool_init(&pool, (uint32_t)options.threads);
+    if (!options.json) {
+        fprintf(out, "bodies,awake,radii,iterations,broadphase,threads,simd,seed,steps,phase,"
+                     "mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n");
+    }
+
+    for (int b = 0; b < options.broadphase_count; b++) {
+        for (int n = 0; n < options.body_count; n++) {
+            for (int r = 0; r < options.radii_count; r++) {
+                for (int i = 0; i < options.iteration_count; i++) {
+                    int scenarios = options.awake_count > 0 ? options.awake_count : 1;
+                    for (int a = 0; a < scenarios; a++) {
+                        int kicked = options.awake_count > 0 ? options.awake[a] : 0;
+                        fprintf(stderr, "%s: %d bodies (%d kicked), %s radii, %d iterations\n",
+                                broadphase_names[options.broadphases[b]], options.bodies[n], kicked,
+                                radii_names[options.radii[r]], options.iterations[i]);
+                        run(out, &options, threaded ? &pool : NULL, options.bodies[n], options.radii[r],
+                            options.iterations[i], options.broadphases[b], kicked);
+                    }
+                }
+            }
+        }
+    }
+
+    if (threaded) {
+        thread_pool_cleanup(&pool);
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include "../minunit.h"
+#include "core/aabb_tree.h"
+#include "core/components.h"
+#include "core/ecs.h"
+#include "core/physics.h"
+#include <math.h>
+#include <stdlib.h>
+
+int tests_run = 0;
+
+#define LEAF_COUNT 500
+
+static Aabb boxes[LEAF_COUNT];
+static uint32_t proxies[LEAF_COUNT];
+static int alive[LEAF_COUNT];
+static uint32_t found[LEAF_COUNT];
+
+static Aabb random_box(void) {
+    // Spread far beyond any grid: the tree has no bounds
+    float x = (float)(rand() % 20000) - 10000.0f;
+    float y = (float)(rand() % 20000) - 10000.0f;
+    float half = 1.0f + (float)(rand() % 200) / 10.0f;
+    return (Aabb){x - half, y - half, x + half, y + half};
+}
+
+static int contains(const uint32_t* users, size_t count, uint32_t user) {
+    for (size_t i = 0; i < count; i++) {
+        if (users[i] == user) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Every live box overlapping the query must be reported; fattening may add
+// near misses, but never a removed leaf
+static int query_matches(const AabbTree* tree, Aabb query) {
+    size_t count = aabb_tree_query(tree, query, found, LEAF_COUNT);
+    for (size_t i = 0; i < count; i++) {
+        if (!alive[found[i]]) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < LEAF_COUNT; i++) {
+        if (alive[i] && aabb_overlaps(boxes[i], query) && !contains(found, count, i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static char* test_insert_and_query() {
+    srand(3);
+    AabbTree tree = {0};  // ZII
+    aabb_tree_init(&tree, AABB_TREE_DEFAULT_MARGIN);
+    for (uint32_t i = 0; i < LEAF_COUNT; i++) {
+        boxes[i] = random_box();
+        proxies[i] = aabb_tree_insert(&tree, boxes[i], i);
+        alive[i] = 1;
+        mu_assert("Insert should hand out a proxy", proxies[i] != AABB_TREE_NULL);
+    }
+    mu_assert("Every leaf should be counted", tree.leaf_count == LEAF_COUNT);
+    mu_assert("Tree should stay balanced", aabb_tree_height(&tree) <= 2 * (int)ceil(log2(LEAF_COUNT)));
+
+    for (int q = 0; q < 100; q++) {
+        Aabb query = random_box();
+        query.max_x += 500.0f;
+        query.max_y += 500.0f;
+        mu_assert("Query should match brute force", query_matches(&tree, query));
+    }
+
+    aabb_tree_cleanup(&tree);
+    return 0;
+}
+
+static char* test_move_and_remove() {
+    srand(5);
+    AabbTree tree = {0};  // ZII
+    aabb_tree_init(&tree, AABB_TREE_DEFAULT_MARGIN);
+    for (uint32_t i = 0; i < LEAF_COUNT; i++) {
+        boxes[i] = random_box();
+        proxies[i] = aabb_tree_insert(&tree, boxes[i], i);
+        alive[i] = 1;
+    }
+
+    // Small moves stay inside the fattened box
+    Aabb nudged = boxes[0];
+    nudged.min_x += 0.5f;
+    nudged.max_x += 0.5f;
+    mu_assert("Small move should not reinsert", !aabb_tree_move(&tree, proxies[0], nudged));
+    boxes[0] = nudged;
+
+    for (int round = 0; round < 20; round++) {
+        for (uint32_t i = 0; i < LEAF_COUNT; i++) {
+            if (!alive[i]) {
+                continue;
+            }
+            if (rand() % 10 == 0) {
+                aabb_tree_remove(&tree, proxies[i]);
+                alive[i] = 0;
+            } else {
+                boxes[i] = random_box();
+                aabb_tree_move(&tree, proxies[i], boxes[i]);
+            }
+        }
+        mu_assert("Query after moves should match brute force", query_matches(&tree, random_box()));
+    }
+
+    size_t live = 0;
+    for (uint32_t i = 0; i < LEAF_COUNT; i++) {
+        live += alive[i];
+    }
+    mu_assert("Removed leaves should not be counted", tree.leaf_count == live);
+    mu_assert("Tree should stay balanced after churn",
+              aabb_tree_height(&tree) <= 2 * (int)ceil(log2(LEAF_COUNT)));
+
+    aabb_tree_cleanup(&tree);
+    return 0;
+}
+
+#define REGION_MISSES 12
+
+// Near misses inside the leaves' margin must not take the result slots
+static char* test_region_cap_counts_real_hits() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.broadphase = PHYSICS_BROADPHASE_TREE;
+    world.gravity = (Vec3){0};
+
+    // Misses end 0.25 short of the box, inside their fattened leaves, and
+    // outnumber the hits so they fill the first slots of any capped query
+    Entity misses[REGION_MISSES];
+    for (int i = 0; i < REGION_MISSES; i++) {
+        misses[i] = physics_create_circle(&world, (Vec3){-2.25f, -22.0f + i * 4.0f, 0.0f}, 1.0f, 1.0f);
+    }
+    Entity hits[2];
+    hits[0] = physics_create_circle(&world, (Vec3){2.0f, -2.0f, 0.0f}, 1.0f, 1.0f);
+    hits[1] = physics_create_circle(&world, (Vec3){2.0f, 2.0f, 0.0f}, 1.0f, 1.0f);
+    physics_world_step(&world, 1.0f / 60.0f);
+
+    Aabb region = {-1.0f, -30.0f, 10.0f, 30.0f};
+    uint32_t candidates[REGION_MISSES + 2];
+    mu_assert("Fattened leaves should make the misses candidates",
+              aabb_tree_query(&world.body_tree, region, candidates, REGION_MISSES + 2) == REGION_MISSES + 2);
+
+    Entity out[2];
+    size_t count = physics_query_region(&world, region, out, 2);
+    mu_assert("A small cap should still fill with real hits", count == 2);
+    mu_assert("Only overlapping bodies should be reported",
+              (out[0] == hits[0] && out[1] == hits[1]) || (out[0] == hits[1] && out[1] == hits[0]));
+    for (int i = 0; i < REGION_MISSES; i++) {
+        mu_assert("Near misses should be refined away", out[0] != misses[i] && out[1] != misses[i]);
+    }
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    arena_scratch_thread_cleanup();
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_insert_and_query);
+    mu_run_test(test_move_and_remove);
+    mu_run_test(test_region_cap_counts_real_hits);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
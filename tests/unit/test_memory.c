@@ -0,0 +1,392 @@
+#include "../minunit.h"
+#include "core/memory.h"
+#include "core/thread_pool.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+int tests_run = 0;
+
+static char* test_growth_keeps_pointers() {
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 1024);
+    char* first = (char*)arena_alloc(&arena, 900);
+    mu_assert("First allocation should fit the first block", first == arena.memory);
+    memset(first, 0xAB, 900);
+
+    // Past the first block: a chunk is chained on, the first block stays
+    char* second = (char*)arena_alloc(&arena, 4000);
+    mu_assert("Growth should chain a chunk", second != NULL && arena.chunk != NULL);
+    mu_assert("Growth should not move earlier allocations", first[0] == (char)0xAB && first[899] == (char)0xAB);
+    memset(second, 0xCD, 4000);
+    char* third = (char*)arena_alloc_aligned(&arena, 64, 64);
+    mu_assert("Alignment should hold in chunks", ((uintptr_t)third & 63) == 0);
+
+    ArenaStats stats = {0};  // ZII
+    arena_get_stats(&arena, &stats);
+    mu_assert("Stats should count every block", stats.arena_count >= 2 && stats.total_size >= 1024 + 4000);
+
+    // Reset reuses the chunk rather than allocating another
+    size_t total = stats.total_size;
+    arena_reset(&arena);
+    mu_assert("Reset should return to the first block", arena.memory == first && arena.used == 0);
+    arena_alloc(&arena, 900);
+    mu_assert("The chunk should be reused", arena_alloc(&arena, 4000) == second);
+    ArenaStats after = {0};  // ZII
+    arena_get_stats(&arena, &after);
+    mu_assert("Reuse should not add memory", after.total_size == total);
+
+    arena_cleanup(&arena);
+    return 0;
+}
+
+static char* test_reset_to_mark_across_chunks() {
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 256);
+    arena_alloc(&arena, 100);
+    ArenaMark mark = arena_mark(&arena);
+    char* kept = (char*)arena_alloc(&arena, 16);
+
+    for (int i = 0; i < 20; i++) {
+        mu_assert("Allocations should keep succeeding", arena_alloc(&arena, 200) != NULL);
+    }
+    mu_assert("Allocations should have spilled into chunks", arena.chunk != NULL);
+
+    arena_reset_to_mark(&arena, mark);
+    mu_assert("Mark should restore the first block", arena.chunk == NULL && arena.used == 100);
+    mu_assert("Allocation after the mark should reuse its memory", arena_alloc(&arena, 16) == kept);
+
+    size_t used = arena.used;
+    ArenaScope scope = arena_scope_begin(&arena);
+    for (int i = 0; i < 20; i++) {
+        arena_alloc(&arena, 200);
+    }
+    arena_scope_end(scope);
+    mu_assert("Scope should unwind across chunks", arena.chunk == NULL && arena.used == used);
+
+    arena_cleanup(&arena);
+    return 0;
+}
+
+static char* test_buffer_arena_does_not_grow() {
+    static char buffer[256];
+    Arena arena = {0};  // ZII
+    arena_init_with_buffer(&arena, buffer, sizeof(buffer));
+    mu_assert("Buffer arena should allocate from the buffer", arena_alloc(&arena, 200) == buffer);
+    mu_assert("Buffer arena should not chain chunks", arena_alloc(&arena, 200) == NULL);
+    arena_cleanup(&arena);
+    return 0;
+}
+
+static char* test_trim_last_allocation() {
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 1024);
+    char* data = (char*)arena_alloc(&arena, 512);
+    mu_assert("Trim should shrink the last allocation", arena_trim_last(&arena, data, 100));
+    mu_assert("Trim should hand the tail back", arena.used == (size_t)(data - arena.memory) + 100);
+    mu_assert("Trim should not grow an allocation", !arena_trim_last(&arena, data, 200));
+
+    // Only the last allocation: trimming an earlier one would free later ones
+    char* later = (char*)arena_alloc(&arena, 64);
+    size_t used = arena.used;
+    mu_assert("Trim should refuse an earlier allocation", !arena_trim_last(&arena, data, 50));
+    mu_assert("A refused trim should change nothing", arena.used == used);
+    mu_assert("Trim should take the new last allocation", arena_trim_last(&arena, later, 32));
+    ArenaMark mark = arena_mark(&arena);
+    arena_reset_to_mark(&arena, mark);
+    mu_assert("Marks should forget the last allocation", !arena_trim_last(&arena, later, 16));
+
+    // Once the arena has moved on to a chunk the old block is out of reach
+    arena_alloc(&arena, 2000);
+    mu_assert("Trim should refuse blocks behind the current one", !arena_trim_last(&arena, data, 50));
+
+    arena_cleanup(&arena);
+    return 0;
+}
+
+static char* test_virtual_arena_grows_in_place() {
+    Arena arena = {0};  // ZII
+    mu_assert("Virtual arena should initialize",
+              arena_init_virtual(&arena, 64 * 1024 * 1024, 1024, ARENA_VIRTUAL_HUGE_PAGES | ARENA_VIRTUAL_PREFAULT));
+    char* first = (char*)arena_alloc(&arena, 1000);
+    memset(first, 0x5A, 1000);
+    size_t committed = arena.size;
+
+    // Well past the first commit: still the same block, nothing chained
+    char* big = (char*)arena_alloc(&arena, 3 * ARENA_VIRTUAL_COMMIT_STEP);
+    mu_assert("Growth should succeed", big != NULL);
+    memset(big, 0x11, 3 * ARENA_VIRTUAL_COMMIT_STEP);
+    if (arena.reserved) {
+        mu_assert("Growth should commit in place", arena.chunk == NULL && arena.memory == first &&
+                                                       arena.size > committed);
+    }
+    mu_assert("Growth should not touch earlier allocations", first[0] == 0x5A && first[999] == 0x5A);
+
+    arena_reset(&arena);
+    mu_assert("Reset should start over in the same block", arena_alloc(&arena, 16) == first);
+    arena_cleanup(&arena);
+    mu_assert("Cleanup should release the range", arena.memory == NULL && arena.reserved == 0);
+    return 0;
+}
+
+static char* test_scratch_frame_lifetimes() {
+    arena_scratch_next_frame();
+    int* built = (int*)arena_alloc(arena_scratch(), 64 * sizeof(int));
+    built[0] = 7;
+
+    // Scopes unwind within the frame
+    ArenaScope scope = arena_scratch_begin();
+    mu_assert("Scope should take this frame's arena", scope.arena == arena_scratch());
+    arena_alloc(scope.arena, 1024);
+    arena_scope_end(scope);
+
+    arena_scratch_next_frame();
+    mu_assert("Last frame's memory should stay intact",
+              arena_scratch_last_frame()->base_memory <= (char*)built && built[0] == 7);
+    mu_assert("This frame should start empty", arena_scratch()->used == 0);
+
+    // Two frames later the memory is handed out again
+    arena_scratch_next_frame();
+    int* reused = (int*)arena_alloc(arena_scratch(), 64 * sizeof(int));
+    mu_assert("Memory should be reused after two frames", reused == built);
+
+    // Skipping frames leaves nothing from before
+    arena_scratch_next_frame();
+    arena_scratch_next_frame();
+    arena_scratch_next_frame();
+    mu_assert("Stale frames should be reset", arena_scratch_last_frame()->used == 0);
+    return 0;
+}
+
+#define SCRATCH_TASKS 64
+
+typedef struct {
+    Arena* arenas[SCRATCH_TASKS];
+    uint32_t workers[SCRATCH_TASKS];
+} ScratchJob;
+
+static void scratch_task(void* context, size_t task_index, uint32_t worker_index) {
+    ScratchJob* job = (ScratchJob*)context;
+    ArenaScope scope = arena_scratch_begin();
+    int* values = (int*)arena_alloc(scope.arena, 256 * sizeof(int));
+    for (int i = 0; i < 256; i++) {
+        values[i] = (int)task_index;
+    }
+    job->arenas[task_index] = values[255] == (int)task_index ? scope.arena : NULL;
+    job->workers[task_index] = worker_index;
+    arena_scope_end(scope);
+}
+
+static char* test_scratch_is_per_thread() {
+    ThreadPool pool = {0};  // ZII
+    thread_pool_init(&pool, 3);
+    ScratchJob job = {0};  // ZII
+    thread_pool_run(&pool, SCRATCH_TASKS, scratch_task, &job);
+    for (int a = 0; a < SCRATCH_TASKS; a++) {
+        mu_assert("Every task should get scratch", job.arenas[a] != NULL);
+        for (int b = 0; b < SCRATCH_TASKS; b++) {
+            mu_assert("Threads should never share a scratch arena",
+                      (job.workers[a] == job.workers[b]) == (job.arenas[a] == job.arenas[b]));
+        }
+    }
+    thread_pool_cleanup(&pool);
+    arena_scratch_thread_cleanup();
+    return 0;
+}
+
+typedef struct {
+    float x, y, vx, vy;
+    int id;
+} Projectile;
+
+static char* test_object_pool_recycles() {
+    ObjectPool pool = {0};  // ZII
+    mu_assert("Pool should initialize", OBJECT_POOL_INIT(&pool, Projectile, 16, false));
+    Projectile* projectiles[40];
+    for (int i = 0; i < 40; i++) {
+        projectiles[i] = OBJECT_POOL_NEW(&pool, Projectile);
+        mu_assert("Allocation should succeed", projectiles[i] != NULL);
+        projectiles[i]->id = i;
+    }
+    mu_assert("40 objects should take three slabs", pool.slab_count == 3);
+    mu_assert("Objects should keep their contents", projectiles[5]->id == 5 && projectiles[39]->id == 39);
+
+    // Freed objects come back before any new slab
+    for (int i = 0; i < 10; i++) {
+        object_pool_free(&pool, projectiles[i]);
+    }
+    for (int i = 0; i < 10; i++) {
+        Projectile* reused = OBJECT_POOL_NEW(&pool, Projectile);
+        mu_assert("Free list should hand back freed objects", reused == projectiles[9 - i]);
+    }
+
+    ArenaStats stats = {0};  // ZII
+    object_pool_get_stats(&pool, &stats);
+    mu_assert("Stats should count live objects", stats.used_bytes == 40 * pool.object_size);
+    mu_assert("Stats should count slabs", stats.arena_count == 3 && stats.total_size == 48 * pool.object_size);
+    mu_assert("Counters should track churn", pool.alloc_count == 50 && pool.free_count == 10 && pool.peak_count == 40);
+
+    // Free-all keeps the slabs for the next wave
+    object_pool_free_all(&pool);
+    mu_assert("Free-all should drop every object", pool.live_count == 0);
+    for (int i = 0; i < 48; i++) {
+        mu_assert("Allocation after free-all should succeed", OBJECT_POOL_NEW(&pool, Projectile) != NULL);
+    }
+    mu_assert("Free-all should reuse the slabs", pool.slab_count == 3);
+
+    object_pool_cleanup(&pool);
+    return 0;
+}
+
+#define POOL_TASKS 64
+#define POOL_TASK_OBJECTS 100
+
+static void pool_task(void* context, size_t task_index, uint32_t worker_index) {
+    (void)worker_index;
+    ObjectPool* pool = (ObjectPool*)context;
+    Projectile* mine[POOL_TASK_OBJECTS];
+    for (int i = 0; i < POOL_TASK_OBJECTS; i++) {
+        mine[i] = OBJECT_POOL_NEW(pool, Projectile);
+        mine[i]->id = (int)task_index;
+    }
+    for (int i = 0; i < POOL_TASK_OBJECTS; i++) {
+        // Another thread writing the same object would show up here
+        mine[i]->id = mine[i]->id == (int)task_index ? -1 : -2;
+    }
+    for (int i = 0; i < POOL_TASK_OBJECTS; i++) {
+        if (mine[i]->id == -1) {
+            object_pool_free(pool, mine[i]);
+        }
+    }
+}
+
+static char* test_object_pool_thread_caches() {
+    ThreadPool threads = {0};  // ZII
+    thread_pool_init(&threads, 3);
+    ObjectPool pool = {0};  // ZII
+    OBJECT_POOL_INIT(&pool, Projectile, 64, true);
+    thread_pool_run(&threads, POOL_TASKS, pool_task, &pool);
+    mu_assert("Every object should be allocated once", pool.alloc_count == POOL_TASKS * POOL_TASK_OBJECTS);
+    mu_assert("Every object should come back", pool.live_count == 0 && pool.free_count == pool.alloc_count);
+    mu_assert("Caches should keep the pool small", pool.slab_count * pool.objects_per_slab <
+                                                       POOL_TASKS * POOL_TASK_OBJECTS);
+    object_pool_cleanup(&pool);
+    thread_pool_cleanup(&threads);
+    return 0;
+}
+
+static char* test_tag_telemetry() {
+    MemoryTagStats before = {0};  // ZII
+    memory_tag_get_stats(MEMORY_TAG_GAME, &before);
+
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 1024);
+    arena_set_tag(&arena, MEMORY_TAG_GAME);
+    arena_alloc(&arena, 100);
+    ArenaScope scope = arena_scope_begin(&arena);
+    arena_alloc(&arena, 300);
+    arena_alloc(&arena, 2000);  // Chains a chunk
+
+    MemoryTagStats during = {0};  // ZII
+    memory_tag_get_stats(MEMORY_TAG_GAME, &during);
+    mu_assert("Live bytes should be charged to the tag", during.live_bytes - before.live_bytes == 2400);
+    mu_assert("Allocations should be counted", during.alloc_count - before.alloc_count == 3);
+    mu_assert("Peak should cover live bytes", during.peak_bytes >= during.live_bytes);
+
+    arena_scope_end(scope);
+    MemoryTagStats after = {0};  // ZII
+    memory_tag_get_stats(MEMORY_TAG_GAME, &after);
+    mu_assert("Unwinding should release the scope's bytes", after.live_bytes - before.live_bytes == 100);
+    mu_assert("Unwinding should keep the peak", after.peak_bytes == during.peak_bytes);
+
+    ArenaStats stats = {0};  // ZII
+    arena_get_stats(&arena, &stats);
+    mu_assert("Arena should keep its own high-water mark", stats.peak_bytes == 2400 && stats.alloc_count == 3);
+
+    // Object pools charge per object until it is freed
+    ObjectPool pool = {0};  // ZII
+    OBJECT_POOL_INIT(&pool, Projectile, 16, false);
+    object_pool_set_tag(&pool, MEMORY_TAG_GAME);
+    Projectile* projectile = OBJECT_POOL_NEW(&pool, Projectile);
+    memory_tag_get_stats(MEMORY_TAG_GAME, &after);
+    mu_assert("Pool objects should be charged", after.live_bytes - before.live_bytes == 100 + pool.object_size);
+    object_pool_free(&pool, projectile);
+    object_pool_cleanup(&pool);
+
+    // Counts for a frame show up once it closes
+    memory_telemetry_next_frame();
+    arena_alloc(&arena, 8);
+    arena_alloc(&arena, 8);
+    memory_telemetry_next_frame();
+    MemoryTagStats frame = {0};  // ZII
+    memory_tag_get_stats(MEMORY_TAG_GAME, &frame);
+    mu_assert("Frame counters should cover the last frame", frame.frame_allocs == 2 && frame.frame_bytes == 16);
+
+    arena_cleanup(&arena);
+    memory_tag_get_stats(MEMORY_TAG_GAME, &after);
+    mu_assert("Cleanup should release everything", after.live_bytes == before.live_bytes);
+    return 0;
+}
+
+static char* test_telemetry_callsites_and_dump() {
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 1024);
+    arena_set_tag(&arena, MEMORY_TAG_GAME);
+    memory_track_callsite(__FILE__, __LINE__);
+    arena_alloc(&arena, 64);  // Noted explicitly, as the debug macros do
+
+    MemoryCallsite sites[MEMORY_MAX_CALLSITES];
+    size_t count = memory_telemetry_callsites(sites, MEMORY_MAX_CALLSITES);
+    bool found = false;
+    for (size_t i = 0; i < count; i++) {
+        found |= strcmp(sites[i].file, __FILE__) == 0 && sites[i].tag == MEMORY_TAG_GAME && sites[i].alloc_bytes >= 64;
+    }
+    mu_assert("The call site should be recorded", found);
+
+    // A failed allocation's site must not be charged with the next one
+    memory_track_callsite("failed_site.c", 1);
+    mu_assert("Size 0 should fail", arena_alloc(&arena, 0) == NULL);
+    memory_track_callsite("failed_site.c", 2);
+    ObjectPool empty = {0};  // ZII, never initialized
+    mu_assert("An uninitialized pool should fail", object_pool_alloc(&empty) == NULL);
+    arena_alloc(&arena, 32);  // Untracked
+    count = memory_telemetry_callsites(sites, MEMORY_MAX_CALLSITES);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert("Failed allocations should not attribute later ones", strcmp(sites[i].file, "failed_site.c") != 0);
+    }
+
+    const char* path = "/tmp/test_memory_telemetry.txt";
+    mu_assert("Dump should succeed", memory_telemetry_dump(path));
+    FILE* file = fopen(path, "r");
+    mu_assert("Dump should write the file", file != NULL);
+    char text[8192] = {0};
+    fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    remove(path);
+    mu_assert("Dump should list the tags", strstr(text, "physics") && strstr(text, "game"));
+    mu_assert("Dump should list call sites", strstr(text, "test_memory.c"));
+
+    arena_cleanup(&arena);
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_growth_keeps_pointers);
+    mu_run_test(test_reset_to_mark_across_chunks);
+    mu_run_test(test_buffer_arena_does_not_grow);
+    mu_run_test(test_trim_last_allocation);
+    mu_run_test(test_virtual_arena_grows_in_place);
+    mu_run_test(test_scratch_frame_lifetimes);
+    mu_run_test(test_scratch_is_per_thread);
+    mu_run_test(test_object_pool_recycles);
+    mu_run_test(test_object_pool_thread_caches);
+    mu_run_test(test_tag_telemetry);
+    mu_run_test(test_telemetry_callsites_and_dump);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
@@ -0,0 +1,112 @@
+#include "../minunit.h"
+#include "core/physics.h"
+#include "core/physics_bodies.h"
+#include <string.h>
+
+int tests_run = 0;
+
+// 17 rows: the first 16 go through the SIMD path (4 or 8 lanes), the last
+// one through the scalar tail, so row 0 and row 16 must always agree
+#define ROWS 17
+#define TAIL (ROWS - 1)
+
+typedef struct {
+    float x, old_x, ax;
+    int32_t sleeping, sleep_timer;
+} BodyCase;
+
+static void fill(PhysicsBodies* bodies, const BodyCase* c) {
+    for (size_t i = 0; i < ROWS; i++) {
+        bodies->x[i] = c->x;
+        bodies->y[i] = 2.0f;
+        bodies->old_x[i] = c->old_x;
+        bodies->old_y[i] = 2.0f;
+        bodies->ax[i] = c->ax;
+        bodies->ay[i] = 0.0f;
+        bodies->vx[i] = bodies->vy[i] = 0.0f;
+        bodies->radius[i] = 5.0f;
+        bodies->inv_mass[i] = 1.0f;
+        bodies->sleeping[i] = c->sleeping;
+        bodies->sleep_timer[i] = c->sleep_timer;
+    }
+}
+
+static int rows_match(const PhysicsBodies* b, size_t i, size_t j) {
+    return b->x[i] == b->x[j] && b->y[i] == b->y[j] &&
+           b->old_x[i] == b->old_x[j] && b->old_y[i] == b->old_y[j] &&
+           b->vx[i] == b->vx[j] && b->vy[i] == b->vy[j] &&
+           b->ax[i] == b->ax[j] && b->ay[i] == b->ay[j] &&
+           b->sleeping[i] == b->sleeping[j] &&
+           b->sleep_timer[i] == b->sleep_timer[j];
+}
+
+static char* test_integrate_matches_scalar() {
+    PhysicsBodies bodies = {0};  // ZII
+    mu_assert("Store should allocate", physics_bodies_reserve(&bodies, ROWS));
+    bodies.count = ROWS;
+    mu_assert("Arrays should be aligned",
+              ((uintptr_t)bodies.x % PHYSICS_BODY_ALIGNMENT) == 0 &&
+              ((uintptr_t)bodies.sleep_timer % PHYSICS_BODY_ALIGNMENT) == 0);
+
+    PhysicsIntegrateParams params = {0.0f, -200.0f, PHYSICS_DEFAULT_DAMPING, 1.0f / 60.0f, 0};
+    BodyCase cases[] = {
+        {1.0f, 0.5f, 0.0f, 0, 3},                                  // Awake, fast
+        {1.0f, 0.995f, 0.0f, 0, 3},                                // Awake, slow
+        {1.0f, 0.995f, 0.0f, 0, PHYSICS_SLEEP_TIME_THRESHOLD - 1}, // Falls asleep
+        {1.0f, 0.995f, 0.0f, 1, PHYSICS_SLEEP_TIME_THRESHOLD},     // Stays asleep
+        {1.0f, 1.0f, 50.0f, 1, PHYSICS_SLEEP_TIME_THRESHOLD},      // Woken by force
+        {1.0f, 0.5f, 0.0f, 1, PHYSICS_SLEEP_TIME_THRESHOLD},       // Woken by speed
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        fill(&bodies, &cases[c]);
+        physics_bodies_integrate(&bodies, 0, ROWS, &params);
+        mu_assert("SIMD lanes should match the scalar tail", rows_match(&bodies, 0, TAIL));
+    }
+
+    // Spot-check the transitions themselves
+    fill(&bodies, &cases[2]);
+    physics_bodies_integrate(&bodies, 0, ROWS, &params);
+    mu_assert("Slow body at the limit should fall asleep",
+              bodies.sleeping[0] == 1 && bodies.x[0] == 1.0f && bodies.vx[0] == 0.0f);
+    fill(&bodies, &cases[4]);
+    physics_bodies_integrate(&bodies, 0, ROWS, &params);
+    mu_assert("Pushed sleeper should wake and move",
+              bodies.sleeping[0] == 0 && bodies.sleep_timer[0] == 0 && bodies.old_x[0] == 1.0f);
+
+    physics_bodies_cleanup(&bodies);
+    return 0;
+}
+
+static char* test_constrain_matches_scalar() {
+    PhysicsBodies bodies = {0};  // ZII
+    physics_bodies_reserve(&bodies, ROWS);
+    bodies.count = ROWS;
+
+    BodyCase inside = {10.0f, 10.0f, 0.0f, 0, 0};
+    BodyCase outside = {120.0f, 120.0f, 0.0f, 0, 0};
+
+    fill(&bodies, &inside);
+    physics_bodies_constrain(&bodies, 0, ROWS, 0.0f, 0.0f, 100.0f);
+    mu_assert("Inside body should not move", bodies.x[0] == 10.0f && rows_match(&bodies, 0, TAIL));
+
+    fill(&bodies, &outside);
+    physics_bodies_constrain(&bodies, 0, ROWS, 0.0f, 0.0f, 100.0f);
+    mu_assert("Outside body should be pulled in", bodies.x[0] < 100.0f);
+    mu_assert("SIMD lanes should match the scalar tail", rows_match(&bodies, 0, TAIL));
+
+    physics_bodies_cleanup(&bodies);
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_integrate_matches_scalar);
+    mu_run_test(test_constrain_matches_scalar);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
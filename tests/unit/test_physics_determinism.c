@@ -0,0 +1,239 @@
+#include "../minunit.h"
+#include "core/components.h"
+#include "core/memory.h"
+#include "core/physics.h"
+#include "core/thread_pool.h"
+#include <math.h>
+
+int tests_run = 0;
+
+#define BODY_COUNT 400
+#define STEP_COUNT 120
+
+// A pile with some bodies stacked exactly on top of each other; returns the
+// state hash after every step in hashes
+static void run_pile(ThreadPool* pool, PhysicsBroadphase broadphase, uint64_t seed, uint64_t* hashes) {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ecs_set_thread_pool(&ecs, pool);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.broadphase = broadphase;
+    world.deterministic = true;
+    physics_set_seed(&world, seed);
+
+    for (int i = 0; i < BODY_COUNT; i++) {
+        // Every fifth body shares the previous one's centre
+        int slot = i - (i % 5 == 4);
+        Vec3 position = {(float)(slot % 20) * 6.0f - 60.0f, (float)(slot / 20) * 6.0f - 40.0f, 0.0f};
+        physics_create_circle(&world, position, 2.0f + (float)(slot % 3) * 0.5f, 1.0f);
+    }
+    for (int step = 0; step < STEP_COUNT; step++) {
+        physics_world_step(&world, 1.0f / 60.0f);
+        hashes[step] = world.state_hash;
+    }
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+}
+
+static char* test_replay_matches_across_threads() {
+    static uint64_t serial[STEP_COUNT], threaded[STEP_COUNT];
+    ThreadPool pool = {0};  // ZII
+    thread_pool_init(&pool, 4);
+
+    PhysicsBroadphase broadphases[] = {PHYSICS_BROADPHASE_GRID, PHYSICS_BROADPHASE_SWEEP,
+                                       PHYSICS_BROADPHASE_TREE};
+    for (int b = 0; b < 3; b++) {
+        run_pile(NULL, broadphases[b], 42, serial);
+        run_pile(&pool, broadphases[b], 42, threaded);
+        for (int step = 0; step < STEP_COUNT; step++) {
+            mu_assert("Replays should hash the same every step", serial[step] == threaded[step]);
+        }
+    }
+    mu_assert("Stepping should change the hash", serial[0] != serial[STEP_COUNT - 1]);
+
+    thread_pool_cleanup(&pool);
+    return 0;
+}
+
+static char* test_seed_picks_coincident_directions() {
+    static uint64_t first[STEP_COUNT], second[STEP_COUNT];
+    run_pile(NULL, PHYSICS_BROADPHASE_GRID, 1, first);
+    run_pile(NULL, PHYSICS_BROADPHASE_GRID, 2, second);
+    mu_assert("Coincident bodies should split differently with another seed",
+              first[STEP_COUNT - 1] != second[STEP_COUNT - 1]);
+
+    // Two bodies on one spot must still be pushed apart
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.gravity = (Vec3){0};
+    Entity a = physics_create_circle(&world, (Vec3){0.0f, 0.0f, 0.0f}, 2.0f, 1.0f);
+    Entity b = physics_create_circle(&world, (Vec3){0.0f, 0.0f, 0.0f}, 2.0f, 1.0f);
+    physics_world_step(&world, 1.0f / 60.0f);
+    Transform* ta = (Transform*)ecs_get_component(&ecs, a, transform_type);
+    Transform* tb = (Transform*)ecs_get_component(&ecs, b, transform_type);
+    float dx = ta->position.x - tb->position.x;
+    float dy = ta->position.y - tb->position.y;
+    mu_assert("Coincident bodies should separate", sqrtf(dx * dx + dy * dy) > 1.0f);
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_snapshot_restore_replays_exactly() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.deterministic = true;
+    Entity entities[BODY_COUNT];
+    for (int i = 0; i < BODY_COUNT; i++) {
+        Vec3 position = {(float)(i % 20) * 6.0f - 60.0f, (float)(i / 20) * 6.0f - 40.0f, 0.0f};
+        entities[i] = physics_create_circle(&world, position, 2.5f, 1.0f);
+    }
+    for (int step = 0; step < 30; step++) {
+        physics_world_step(&world, 1.0f / 60.0f);
+    }
+
+    MemoryTagStats before = {0};  // ZII
+    memory_tag_get_stats(MEMORY_TAG_GAME, &before);
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 4 * 1024 * 1024);
+    arena_set_tag(&arena, MEMORY_TAG_GAME);
+    PhysicsSnapshot snapshots[6];
+    uint64_t hashes[6];
+    mu_assert("Full snapshot should fit", physics_snapshot(&world, NULL, &arena, &snapshots[0]));
+    hashes[0] = world.state_hash;
+    for (int i = 1; i < 6; i++) {
+        physics_world_step(&world, 1.0f / 60.0f);
+        mu_assert("Delta snapshot should fit", physics_snapshot(&world, &snapshots[i - 1], &arena, &snapshots[i]));
+        hashes[i] = world.state_hash;
+    }
+    mu_assert("Deltas should be smaller than a full snapshot",
+              snapshots[5].data_size < snapshots[0].data_size);
+
+    // Trimmed deltas are charged at their encoded size, not the worst case
+    size_t snapshot_bytes = 0;
+    for (int i = 0; i < 6; i++) {
+        snapshot_bytes += snapshots[i].data_size;
+    }
+    MemoryTagStats charged = {0};  // ZII
+    memory_tag_get_stats(MEMORY_TAG_GAME, &charged);
+    mu_assert("Telemetry should count what the snapshots hold",
+              charged.live_bytes - before.live_bytes == snapshot_bytes && arena.tracked == snapshot_bytes);
+
+    uint64_t later[20];
+    for (int step = 0; step < 20; step++) {
+        physics_world_step(&world, 1.0f / 60.0f);
+        later[step] = world.state_hash;
+    }
+
+    // Restoring out of order replays each delta chain from the full snapshot
+    int order[] = {3, 5, 1, 0, 2};
+    for (int i = 0; i < 5; i++) {
+        mu_assert("Restore should succeed", physics_restore(&world, &snapshots[order[i]]));
+        mu_assert("Restored state should hash as it did", world.state_hash == hashes[order[i]]);
+    }
+
+    // Re-simulating from the last snapshot matches the original run
+    mu_assert("Restore should succeed", physics_restore(&world, &snapshots[5]));
+    for (int step = 0; step < 20; step++) {
+        physics_world_step(&world, 1.0f / 60.0f);
+        mu_assert("Re-simulation should match the original run", world.state_hash == later[step]);
+    }
+
+    mu_assert("Deterministic steps should never fall back", !world.determinism_lost);
+
+    ecs_destroy_entity(&ecs, entities[7]);
+    mu_assert("Restore should refuse a different body set", !physics_restore(&world, &snapshots[0]));
+
+    arena_cleanup(&arena);
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+// A pile that settles and falls asleep, wakes when a dropped body lands on
+// it, settles again and then has a sleeper kicked by game code. With resync
+// set every step regathers every row instead of reading back only what may
+// have changed.
+#define SETTLE_STEPS 540
+#define SETTLE_DROP_STEP 300
+#define SETTLE_KICK_STEP 500
+
+static void run_settling_pile(PhysicsBroadphase broadphase, bool resync, uint64_t* hashes, size_t* awake) {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    physics_set_boundary(&world, (Vec3){0}, 60.0f);
+    world.broadphase = broadphase;
+    world.deterministic = true;
+
+    Entity pile[120];
+    for (int i = 0; i < 120; i++) {
+        Vec3 position = {(float)(i % 12) * 8.0f - 44.0f, (float)(i / 12) * 8.0f - 50.0f, 0.0f};
+        pile[i] = physics_create_circle(&world, position, 3.5f, 1.0f);
+    }
+    for (int step = 0; step < SETTLE_STEPS; step++) {
+        if (step == SETTLE_DROP_STEP) {
+            physics_create_circle(&world, (Vec3){0.0f, 40.0f, 0.0f}, 4.0f, 2.0f);
+        }
+        if (step == SETTLE_KICK_STEP) {
+            VerletBody* kicked = (VerletBody*)ecs_get_component_mut(&ecs, pile[5], world.verlet_type);
+            kicked->acceleration = (Vec3){0.0f, 3000.0f, 0.0f};
+        }
+        if (resync) {
+            world.synced = false;
+        }
+        physics_world_step(&world, 1.0f / 60.0f);
+        ecs_advance_tick(&ecs);
+        hashes[step] = world.state_hash;
+        awake[step] = world.awake_count;
+    }
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+}
+
+static char* test_incremental_steps_match_full_resync() {
+    static uint64_t incremental[SETTLE_STEPS], full[SETTLE_STEPS];
+    static size_t awake[SETTLE_STEPS], full_awake[SETTLE_STEPS];
+    PhysicsBroadphase broadphases[] = {PHYSICS_BROADPHASE_GRID, PHYSICS_BROADPHASE_SWEEP,
+                                       PHYSICS_BROADPHASE_TREE};
+    for (int b = 0; b < 3; b++) {
+        run_settling_pile(broadphases[b], false, incremental, awake);
+        run_settling_pile(broadphases[b], true, full, full_awake);
+        mu_assert("Pile should fall asleep", awake[SETTLE_DROP_STEP - 1] == 0);
+        mu_assert("Dropped body should wake the pile", awake[SETTLE_DROP_STEP + 60] > 1);
+        mu_assert("Pile should fall asleep again", awake[SETTLE_KICK_STEP - 1] == 0);
+        mu_assert("Kicked sleeper should wake its island", awake[SETTLE_KICK_STEP] > 0);
+        for (int step = 0; step < SETTLE_STEPS; step++) {
+            mu_assert("Incremental steps should hash as full resyncs", incremental[step] == full[step]);
+            mu_assert("Incremental steps should wake as full resyncs", awake[step] == full_awake[step]);
+        }
+    }
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_replay_matches_across_threads);
+    mu_run_test(test_seed_picks_coincident_directions);
+    mu_run_test(test_snapshot_restore_replays_exactly);
+    mu_run_test(test_incremental_steps_match_full_resync);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
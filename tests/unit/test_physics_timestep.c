@@ -0,0 +1,100 @@
+#include "../minunit.h"
+#include "core/components.h"
+#include "core/physics.h"
+#include <math.h>
+#include <string.h>
+
+int tests_run = 0;
+
+static char* test_accumulator_substeps() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    physics_set_fixed_timestep(&world, 0.01f, 3);
+    physics_create_circle(&world, (Vec3){0.0f, 0.0f, 0.0f}, 1.0f, 1.0f);
+
+    mu_assert("Less than one step should only accumulate", physics_world_update(&world, 0.004f) == 0);
+    mu_assert("Alpha should track the accumulator", fabsf(world.interpolation_alpha - 0.4f) < 1e-4f);
+
+    mu_assert("Accumulated time should produce whole steps", physics_world_update(&world, 0.017f) == 2);
+    mu_assert("Remainder should carry over", fabsf(world.accumulator - 0.001f) < 1e-4f);
+
+    mu_assert("A long frame should be capped", physics_world_update(&world, 1.0f) == 3);
+    mu_assert("Capped time should be dropped", world.accumulator < world.fixed_timestep);
+
+    physics_set_fixed_timestep(&world, 0.0f, 0);
+    mu_assert("Variable mode should step once", physics_world_update(&world, 0.004f) == 1);
+    mu_assert("Variable mode should not interpolate", world.interpolation_alpha == 1.0f);
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_interpolated_position() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.gravity = (Vec3){0};
+    physics_set_fixed_timestep(&world, 0.01f, 4);
+
+    Entity entity = physics_create_circle(&world, (Vec3){0.0f, 0.0f, 0.0f}, 1.0f, 1.0f);
+    VerletBody* verlet = (VerletBody*)ecs_get_component(&ecs, entity, world.verlet_type);
+    verlet->old_position = (Vec3){-0.5f, 0.0f, 0.0f};  // Moving right, 0.5 per step
+
+    physics_world_update(&world, 0.025f);  // Two steps, half a step left over
+    Transform* transform = (Transform*)ecs_get_component(&ecs, entity, transform_type);
+    Vec3 blended = physics_interpolated_position(&world, entity);
+    float expected = verlet->old_position.x + (transform->position.x - verlet->old_position.x) * 0.5f;
+    mu_assert("Body should have moved", transform->position.x > verlet->old_position.x);
+    mu_assert("Blend should sit between the last two steps", fabsf(blended.x - expected) < 1e-4f);
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_phase_profile() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    for (int i = 0; i < 200; i++) {
+        physics_create_circle(&world, (Vec3){(float)(i % 20) * 3.0f, (float)(i / 20) * 3.0f, 0.0f}, 2.0f, 1.0f);
+    }
+
+    physics_world_step(&world, 1.0f / 60.0f);
+    for (int phase = 0; phase < PHYSICS_PHASE_COUNT; phase++) {
+        mu_assert("Phases should not be timed unless profiling", world.phase_seconds[phase] == 0.0);
+    }
+
+    world.profile = true;
+    physics_world_step(&world, 1.0f / 60.0f);
+    mu_assert("Narrowphase should be timed", world.phase_seconds[PHYSICS_PHASE_NARROWPHASE] > 0.0);
+    for (int phase = 0; phase < PHYSICS_PHASE_COUNT; phase++) {
+        mu_assert("Phase times should not be negative", world.phase_seconds[phase] >= 0.0);
+    }
+    mu_assert("Phases should have names", strcmp(physics_phase_name(PHYSICS_PHASE_ISLANDS), "islands") == 0);
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_accumulator_substeps);
+    mu_run_test(test_interpolated_position);
+    mu_run_test(test_phase_profile);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
@@ -0,0 +1,372 @@
+#include "../minunit.h"
+#include "core/memory.h"
+#include "core/physics.h"
+#include "core/thread_pool.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+int tests_run = 0;
+
+#define BODY_COUNT 300
+
+static float xs[BODY_COUNT];
+static float ys[BODY_COUNT];
+static float radii[BODY_COUNT];
+static int32_t asleep[BODY_COUNT];
+static uint32_t found[BODY_COUNT];
+
+static void scatter_bodies(void) {
+    srand(7);
+    for (size_t i = 0; i < BODY_COUNT; i++) {
+        // Some bodies deliberately land outside the grid
+        xs[i] = (float)(rand() % 260) - 130.0f;
+        ys[i] = (float)(rand() % 260) - 130.0f;
+        radii[i] = 2.0f + (float)(rand() % 60) / 10.0f;
+        asleep[i] = (i % 10) == 0;
+    }
+}
+
+static int overlaps(size_t a, size_t b) {
+    float dx = xs[a] - xs[b];
+    float dy = ys[a] - ys[b];
+    float r = radii[a] + radii[b];
+    return dx * dx + dy * dy < r * r;
+}
+
+static int contains(const uint32_t* rows, size_t count, uint32_t row) {
+    for (size_t i = 0; i < count; i++) {
+        if (rows[i] == row) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static char* test_build_sorts_rows_by_cell() {
+    scatter_bodies();
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 64 * 1024);
+    SpatialGrid grid = {0};  // ZII
+    spatial_grid_init(&grid, &arena, (Vec3){-110.0f, -110.0f, 0.0f}, 220.0f, 220.0f, 20.0f);
+
+    mu_assert("Build should succeed", spatial_grid_build(&grid, &arena, xs, ys, radii, asleep, BODY_COUNT));
+
+    size_t cells = (size_t)grid.grid_width * grid.grid_height;
+    size_t awake = 0;
+    for (size_t i = 0; i < BODY_COUNT; i++) {
+        awake += !asleep[i];
+    }
+    mu_assert("Every awake row should be in exactly one cell", grid.cell_start[cells] == awake);
+    mu_assert("Sleeping rows should be left out", grid.body_cell[0] == SPATIAL_GRID_NO_CELL);
+
+    for (size_t c = 0; c < cells; c++) {
+        for (uint32_t k = grid.cell_start[c]; k < grid.cell_start[c + 1]; k++) {
+            mu_assert("Rows should sit in their own cell", grid.body_cell[grid.cell_entities[k]] == c);
+            if (k > grid.cell_start[c]) {
+                mu_assert("Rows within a cell should stay in order",
+                          grid.cell_entities[k - 1] < grid.cell_entities[k]);
+            }
+        }
+    }
+
+    spatial_grid_cleanup(&grid);
+    arena_cleanup(&arena);
+    return 0;
+}
+
+static char* test_query_matches_brute_force() {
+    scatter_bodies();
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 1024);  // Small on purpose: the build has to grow it
+    SpatialGrid grid = {0};  // ZII
+    spatial_grid_init(&grid, &arena, (Vec3){-110.0f, -110.0f, 0.0f}, 220.0f, 220.0f, 20.0f);
+    mu_assert("Build should grow the arena", spatial_grid_build(&grid, &arena, xs, ys, radii, asleep, BODY_COUNT));
+
+    for (size_t a = 0; a < BODY_COUNT; a++) {
+        size_t count = spatial_grid_query(&grid, xs[a], ys[a], radii[a], found, BODY_COUNT);
+        mu_assert("Query results should fit", count <= BODY_COUNT);
+        for (size_t b = 0; b < BODY_COUNT; b++) {
+            if (b != a && !asleep[b] && overlaps(a, b)) {
+                mu_assert("Query should return every overlapping awake row",
+                          contains(found, count, (uint32_t)b));
+            }
+        }
+    }
+
+    spatial_grid_cleanup(&grid);
+    arena_cleanup(&arena);
+    return 0;
+}
+
+// Packs overlapping circles into a small area and runs collision passes,
+// returning the final positions in xs/ys. Every tenth body is a boulder
+// when mixed is set.
+static void solve_pile(ThreadPool* pool, PhysicsSolverMode mode, PhysicsBroadphase broadphase, int mixed) {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ecs_set_thread_pool(&ecs, pool);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.collision_solver = mode;
+    world.broadphase = broadphase;
+
+    Entity entities[BODY_COUNT];
+    srand(11);
+    for (size_t i = 0; i < BODY_COUNT; i++) {
+        Vec3 position = {(float)(rand() % 160) - 80.0f, (float)(rand() % 160) - 80.0f, 0.0f};
+        radii[i] = mixed && i % 10 == 0 ? 24.0f : 4.0f;
+        entities[i] = physics_create_circle(&world, position, radii[i], 1.0f + (float)(i % 3));
+    }
+    for (int pass = 0; pass < 4; pass++) {
+        physics_solve_collisions(&world);
+    }
+    for (size_t i = 0; i < BODY_COUNT; i++) {
+        Transform* t = (Transform*)ecs_get_component(&ecs, entities[i], transform_type);
+        xs[i] = t->position.x;
+        ys[i] = t->position.y;
+    }
+    if (broadphase == PHYSICS_BROADPHASE_SWEEP) {
+        for (size_t i = 1; i < world.sweep.count; i++) {
+            if (world.sweep.min_x[i - 1] > world.sweep.min_x[i]) {
+                xs[0] = NAN;  // Unsorted: fails the caller's overlap check
+            }
+        }
+    }
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+}
+
+static float total_overlap(void) {
+    float total = 0.0f;
+    for (size_t a = 0; a < BODY_COUNT; a++) {
+        for (size_t b = a + 1; b < BODY_COUNT; b++) {
+            float dx = xs[a] - xs[b];
+            float dy = ys[a] - ys[b];
+            float distance = sqrtf(dx * dx + dy * dy);
+            if (distance < radii[a] + radii[b]) {
+                total += radii[a] + radii[b] - distance;
+            }
+        }
+    }
+    return total;
+}
+
+static char* test_colored_solver_ignores_thread_count() {
+    static float serial_x[BODY_COUNT], serial_y[BODY_COUNT];
+
+    solve_pile(NULL, PHYSICS_SOLVER_COLORED, PHYSICS_BROADPHASE_GRID, 0);
+    memcpy(serial_x, xs, sizeof(xs));
+    memcpy(serial_y, ys, sizeof(ys));
+
+    ThreadPool pool = {0};  // ZII
+    thread_pool_init(&pool, 4);
+    solve_pile(&pool, PHYSICS_SOLVER_COLORED, PHYSICS_BROADPHASE_GRID, 0);
+    thread_pool_cleanup(&pool);
+    mu_assert("Coloured solve should match across thread counts",
+              memcmp(serial_x, xs, sizeof(xs)) == 0 && memcmp(serial_y, ys, sizeof(ys)) == 0);
+
+    float colored_overlap = total_overlap();
+    solve_pile(NULL, PHYSICS_SOLVER_SERIAL, PHYSICS_BROADPHASE_GRID, 0);
+    float serial_overlap = total_overlap();
+    mu_assert("Coloured solve should separate bodies as well as the serial one",
+              colored_overlap < serial_overlap * 1.5f + 1.0f);
+    return 0;
+}
+
+static char* test_sweep_and_tree_match_grid_with_boulders() {
+    solve_pile(NULL, PHYSICS_SOLVER_SERIAL, PHYSICS_BROADPHASE_GRID, 1);
+    float grid_overlap = total_overlap();
+    solve_pile(NULL, PHYSICS_SOLVER_SERIAL, PHYSICS_BROADPHASE_SWEEP, 1);
+    float sweep_overlap = total_overlap();
+    mu_assert("Sweep order should stay sorted", !isnan(xs[0]));
+    mu_assert("Sweep should separate bodies as well as the grid",
+              sweep_overlap < grid_overlap * 1.5f + 1.0f);
+    solve_pile(NULL, PHYSICS_SOLVER_SERIAL, PHYSICS_BROADPHASE_TREE, 1);
+    mu_assert("Tree should separate bodies as well as the grid",
+              total_overlap() < grid_overlap * 1.5f + 1.0f);
+    return 0;
+}
+
+static char* test_tree_follows_bodies_and_regions() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.broadphase = PHYSICS_BROADPHASE_TREE;
+    world.gravity = (Vec3){0};
+
+    Entity entities[10];
+    for (int i = 0; i < 10; i++) {
+        entities[i] = physics_create_circle(&world, (Vec3){-45.0f + i * 10.0f, 0.0f, 0.0f}, 2.0f, 1.0f);
+    }
+    physics_world_step(&world, 1.0f / 60.0f);
+    mu_assert("Every body should have a leaf", world.body_tree.leaf_count == 10);
+
+    ecs_destroy_entity(&ecs, entities[3]);
+    physics_world_step(&world, 1.0f / 60.0f);
+    mu_assert("Removed body's leaf should be dropped", world.body_tree.leaf_count == 9);
+
+    Entity hits[10];
+    size_t count = physics_query_region(&world, (Aabb){-30.0f, -1.0f, -6.0f, 1.0f}, hits, 10);
+    mu_assert("Region should hold the live bodies it covers", count == 2);
+    mu_assert("Region should report entities",
+              contains(hits, count, entities[2]) && contains(hits, count, entities[4]));
+
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static float edge_distance(const PhysicsBodies* bodies, size_t row, Vec3 point) {
+    float dx = bodies->x[row] - point.x;
+    float dy = bodies->y[row] - point.y;
+    return fmaxf(0.0f, sqrtf(dx * dx + dy * dy) - bodies->radius[row]);
+}
+
+// First hit along a unit ray by brute force, INFINITY for a miss
+static float ray_distance(const PhysicsBodies* bodies, Vec3 origin, Vec3 direction) {
+    float best = INFINITY;
+    for (size_t i = 0; i < bodies->count; i++) {
+        float fx = origin.x - bodies->x[i];
+        float fy = origin.y - bodies->y[i];
+        float b = fx * direction.x + fy * direction.y;
+        float c = fx * fx + fy * fy - bodies->radius[i] * bodies->radius[i];
+        float t = c <= 0.0f ? 0.0f : (b > 0.0f || b * b - c < 0.0f ? INFINITY : -b - sqrtf(b * b - c));
+        best = fminf(best, t);
+    }
+    return best;
+}
+
+static char* test_batched_queries_match_brute_force() {
+    ECS ecs = {0};  // ZII
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    PhysicsWorld world = {0};  // ZII
+    physics_world_init(&world, &ecs, transform_type);
+    world.gravity = (Vec3){0};
+
+    srand(13);
+    for (size_t i = 0; i < BODY_COUNT; i++) {
+        Vec3 position = {(float)(rand() % 180) - 90.0f, (float)(rand() % 180) - 90.0f, 0.0f};
+        physics_create_circle(&world, position, 1.0f + (float)(rand() % 40) / 10.0f, 1.0f);
+    }
+    physics_world_step(&world, 1.0f / 60.0f);
+    // A smaller boundary shrinks the grid, leaving many bodies outside it
+    physics_set_boundary(&world, (Vec3){0}, 40.0f);
+    const PhysicsBodies* bodies = &world.bodies;
+
+    Arena arena = {0};  // ZII
+    arena_init(&arena, 1024);  // Small, so results force it to grow
+    PhysicsCircleQuery circles[20];
+    Aabb boxes[20];
+    PhysicsNearestQuery nearest[20];
+    for (int q = 0; q < 20; q++) {
+        Vec3 point = {(float)(rand() % 200) - 100.0f, (float)(rand() % 200) - 100.0f, 0.0f};
+        circles[q] = (PhysicsCircleQuery){point, (float)(rand() % 30)};
+        boxes[q] = (Aabb){point.x, point.y, point.x + (float)(rand() % 50), point.y + (float)(rand() % 10)};
+        nearest[q] = (PhysicsNearestQuery){point, 5, q % 4 == 0 ? 10.0f : 0.0f};
+    }
+
+    PhysicsQueryResults results = {0};  // ZII
+    mu_assert("Circle batch should succeed", physics_query_circles(&world, circles, 20, &arena, &results));
+    for (int q = 0; q < 20; q++) {
+        size_t expected = 0;
+        for (size_t i = 0; i < bodies->count; i++) {
+            float dx = bodies->x[i] - circles[q].center.x;
+            float dy = bodies->y[i] - circles[q].center.y;
+            float reach = bodies->radius[i] + circles[q].radius;
+            if (dx * dx + dy * dy <= reach * reach) {
+                expected++;
+                mu_assert("Circle query should find every overlap",
+                          contains(results.entities + results.offsets[q],
+                                   results.offsets[q + 1] - results.offsets[q], bodies->entity[i]));
+            }
+        }
+        mu_assert("Circle query should find only overlaps", results.offsets[q + 1] - results.offsets[q] == expected);
+    }
+
+    mu_assert("Box batch should succeed", physics_query_boxes(&world, boxes, 20, &arena, &results));
+    for (int q = 0; q < 20; q++) {
+        Entity region[BODY_COUNT];
+        size_t expected = physics_query_region(&world, boxes[q], region, BODY_COUNT);
+        mu_assert("Box query should match a region scan", results.offsets[q + 1] - results.offsets[q] == expected);
+        for (size_t i = 0; i < expected; i++) {
+            mu_assert("Box query should find every overlap",
+                      contains(results.entities + results.offsets[q], expected, region[i]));
+        }
+    }
+
+    mu_assert("Nearest batch should succeed", physics_query_nearest(&world, nearest, 20, &arena, &results));
+    for (int q = 0; q < 20; q++) {
+        float limit = nearest[q].max_distance > 0.0f ? nearest[q].max_distance : INFINITY;
+        float sorted[BODY_COUNT];
+        size_t within = 0;
+        for (size_t i = 0; i < bodies->count; i++) {
+            float distance = edge_distance(bodies, i, nearest[q].point);
+            if (distance <= limit) {
+                size_t slot = within++;
+                while (slot > 0 && sorted[slot - 1] > distance) {
+                    sorted[slot] = sorted[slot - 1];
+                    slot--;
+                }
+                sorted[slot] = distance;
+            }
+        }
+        size_t count = results.offsets[q + 1] - results.offsets[q];
+        mu_assert("Nearest should return k bodies when there are k", count == (within < 5 ? within : 5));
+        for (size_t i = 0; i < count; i++) {
+            Entity entity = results.entities[results.offsets[q] + i];
+            size_t row = 0;
+            while (bodies->entity[row] != entity) {
+                row++;
+            }
+            mu_assert("Nearest should be ordered by distance",
+                      fabsf(edge_distance(bodies, row, nearest[q].point) - sorted[i]) < 1e-4f);
+        }
+    }
+
+    PhysicsRaycastQuery rays[40];
+    for (int q = 0; q < 40; q++) {
+        float angle = (float)q * 0.7f;
+        // Half the rays start outside the grid and boundary
+        float distance = q % 2 ? 150.0f : 10.0f;
+        rays[q] = (PhysicsRaycastQuery){{cosf(angle) * distance, sinf(angle) * distance, 0.0f},
+                                        {-cosf(angle + 0.2f), -sinf(angle + 0.2f), 0.0f},
+                                        q % 5 == 0 ? 30.0f : 0.0f};
+    }
+    PhysicsRayHit* hits = physics_raycast(&world, rays, 40, &arena);
+    mu_assert("Raycast batch should succeed", hits != NULL);
+    for (int q = 0; q < 40; q++) {
+        float expected = ray_distance(bodies, rays[q].origin, rays[q].direction);
+        if (rays[q].max_distance > 0.0f && expected > rays[q].max_distance) {
+            expected = INFINITY;
+        }
+        mu_assert("Raycast should hit when brute force does", hits[q].hit == !isinf(expected));
+        mu_assert("Raycast should find the first hit", !hits[q].hit || fabsf(hits[q].distance - expected) < 1e-3f);
+    }
+
+    arena_cleanup(&arena);
+    physics_world_cleanup(&world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_build_sorts_rows_by_cell);
+    mu_run_test(test_query_matches_brute_force);
+    mu_run_test(test_colored_solver_ignores_thread_count);
+    mu_run_test(test_sweep_and_tree_match_grid_with_boulders);
+    mu_run_test(test_tree_follows_bodies_and_regions);
+    mu_run_test(test_batched_queries_match_brute_force);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
@@ -0,0 +1,110 @@
+#include "../minunit.h"
+#include "core/thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int tests_run = 0;
+
+#define TASK_COUNT 1000
+
+typedef struct {
+    int hits[TASK_COUNT];
+    uint64_t partial[THREAD_POOL_MAX_THREADS + 1];
+} TaskData;
+
+static void count_task(void* context, size_t task_index, uint32_t worker_index) {
+    TaskData* data = (TaskData*)context;
+    data->hits[task_index]++;
+    data->partial[worker_index] += task_index;
+}
+
+static char* test_serial_fallback() {
+    ThreadPool pool = {0};  // ZII: uninitialized pool runs serially
+    TaskData* data = calloc(1, sizeof(TaskData));
+    
+    thread_pool_run(&pool, TASK_COUNT, count_task, data);
+    
+    mu_assert("ZII pool should report only the caller",
+              thread_pool_worker_count(&pool) == 1);
+    for (int i = 0; i < TASK_COUNT; i++) {
+        mu_assert("Every task should run exactly once", data->hits[i] == 1);
+    }
+    
+    free(data);
+    return 0;
+}
+
+static char* test_parallel_run() {
+    ThreadPool pool = {0};
+    mu_assert("Pool should initialize", thread_pool_init(&pool, 4));
+    mu_assert("Worker count should include the caller",
+              thread_pool_worker_count(&pool) == 5);
+    
+    TaskData* data = calloc(1, sizeof(TaskData));
+    for (int round = 0; round < 50; round++) {
+        thread_pool_run(&pool, TASK_COUNT, count_task, data);
+    }
+    
+    uint64_t total = 0;
+    for (uint32_t w = 0; w < thread_pool_worker_count(&pool); w++) {
+        total += data->partial[w];
+    }
+    for (int i = 0; i < TASK_COUNT; i++) {
+        mu_assert("Every task should run once per round", data->hits[i] == 50);
+    }
+    mu_assert("Per-worker partial sums should reduce to the full sum",
+              total == 50ull * (TASK_COUNT * (TASK_COUNT - 1) / 2));
+    
+    thread_pool_cleanup(&pool);
+    mu_assert("Cleanup should reset to ZII", !pool.initialized);
+    free(data);
+    return 0;
+}
+
+typedef struct {
+    ThreadPool* pool;
+    int inner_hits[8][8];
+} NestedData;
+
+static void inner_task(void* context, size_t task_index, uint32_t worker_index) {
+    (void)worker_index;
+    int* row = (int*)context;
+    row[task_index]++;
+}
+
+static void outer_task(void* context, size_t task_index, uint32_t worker_index) {
+    (void)worker_index;
+    NestedData* data = (NestedData*)context;
+    thread_pool_run(data->pool, 8, inner_task, data->inner_hits[task_index]);
+}
+
+static char* test_nested_run() {
+    ThreadPool pool = {0};
+    thread_pool_init(&pool, 2);
+    
+    NestedData data = {0};
+    data.pool = &pool;
+    thread_pool_run(&pool, 8, outer_task, &data);
+    
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 8; j++) {
+            mu_assert("Nested runs should complete serially", data.inner_hits[i][j] == 1);
+        }
+    }
+    
+    thread_pool_cleanup(&pool);
+    return 0;
+}
+
+static char* all_tests() {
+    mu_run_test(test_serial_fallback);
+    mu_run_test(test_parallel_run);
+    mu_run_test(test_nested_run);
+    return 0;
+}
+
+int main() {
+    mu_test_suite_start();
+    char* result = all_tests();
+    mu_test_suite_end(result);
+}
@@ -97,7 +97,7 @@ static char* test_renderable_creation() {
 }
 
 static char* test_ecs_component_integration() {
-    ECS ecs;
+    ECS ecs = {0};  // ZII pattern
     ecs_init(&ecs);
     
     ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
@@ -45,6 +45,38 @@ static char* test_entity_destroy() {
     return 0;
 }
 
+static char* test_entity_recycling() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    
+    ComponentType pos_type = ecs_register_component(&ecs, sizeof(float) * 3);
+    Entity first = ecs_create_entity(&ecs);
+    ecs_add_component(&ecs, first, pos_type);
+    ecs_destroy_entity(&ecs, first);
+    
+    Entity recycled = ecs_create_entity(&ecs);
+    mu_assert("Destroyed slot should be reused",
+              ecs_entity_index(recycled) == ecs_entity_index(first));
+    mu_assert("Reused slot should get a new generation",
+              ecs_entity_generation(recycled) == ecs_entity_generation(first) + 1);
+    mu_assert("Stale handle should be inactive", !ecs_entity_active(&ecs, first));
+    mu_assert("New handle should be active", ecs_entity_active(&ecs, recycled));
+    mu_assert("Stale handle should not see new components",
+              ecs_add_component(&ecs, recycled, pos_type) != NULL &&
+              !ecs_has_component(&ecs, first, pos_type));
+    
+    // Spawn/destroy churn must not exhaust the id space
+    for (int i = 0; i < ECS_DEFAULT_ENTITY_CAPACITY * 2; i++) {
+        Entity effect = ecs_create_entity(&ecs);
+        mu_assert("Churned entity should be created", effect != 0);
+        ecs_destroy_entity(&ecs, effect);
+    }
+    mu_assert("Live id range should stay compact", ecs.next_entity_id == 3);
+    
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
 static char* test_component_registration() {
     ECS ecs = {0};  // ZII pattern
     ecs_init(&ecs);
@@ -97,6 +129,129 @@ static char* test_component_operations() {
     return 0;
 }
 
+static char* test_component_storage_packed() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    
+    ComponentType pos_type = ecs_register_component(&ecs, sizeof(Position));
+    Entity entities[4];
+    for (int i = 0; i < 4; i++) {
+        entities[i] = ecs_create_entity(&ecs);
+        Position* pos = (Position*)ecs_add_component(&ecs, entities[i], pos_type);
+        pos->x = (float)i;
+    }
+    
+    mu_assert("Component count should track additions",
+              ecs_component_count(&ecs, pos_type) == 4);
+    mu_assert("Re-adding should not grow the array",
+              ecs_add_component(&ecs, entities[0], pos_type) != NULL &&
+              ecs_component_count(&ecs, pos_type) == 4);
+    
+    // Swap-remove: the last component moves into the removed slot
+    ecs_remove_component(&ecs, entities[1], pos_type);
+    mu_assert("Component count should drop after removal",
+              ecs_component_count(&ecs, pos_type) == 3);
+    mu_assert("Last entity should fill the hole",
+              ecs_component_entity_at(&ecs, pos_type, 1) == entities[3]);
+    
+    Position* moved = (Position*)ecs_get_component(&ecs, entities[3], pos_type);
+    mu_assert("Moved component should keep its data", moved && moved->x == 3.0f);
+    mu_assert("Dense access should match lookup",
+              ecs_component_at(&ecs, pos_type, 1) == (void*)moved);
+    
+    ecs_destroy_entity(&ecs, entities[0]);
+    mu_assert("Destroying an entity should release its components",
+              ecs_component_count(&ecs, pos_type) == 2);
+    
+    Entity fresh = ecs_create_entity(&ecs);
+    Position* fresh_pos = (Position*)ecs_add_component(&ecs, fresh, pos_type);
+    mu_assert("Reused slot should be zero-initialized",
+              fresh_pos->x == 0.0f && fresh_pos->y == 0.0f && fresh_pos->z == 0.0f);
+    
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_storage_growth() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init_with_capacity(&ecs, 16);
+    
+    ComponentType pos_type = ecs_register_component(&ecs, sizeof(Position));
+    Entity first = ecs_create_entity(&ecs);
+    Position* first_pos = (Position*)ecs_add_component(&ecs, first, pos_type);
+    first_pos->x = 42.0f;
+    
+    // Grow well past the hint and the old fixed 8192 limit
+    const int count = 100000;
+    for (int i = 1; i < count; i++) {
+        Entity entity = ecs_create_entity(&ecs);
+        mu_assert("Entity creation should grow storage", entity != 0);
+        Position* pos = (Position*)ecs_add_component(&ecs, entity, pos_type);
+        mu_assert("Component add should grow storage", pos != NULL);
+        pos->x = (float)i;
+    }
+    
+    mu_assert("All components should be stored",
+              ecs_component_count(&ecs, pos_type) == (size_t)count);
+    mu_assert("Growth should not move existing components",
+              ecs_get_component(&ecs, first, pos_type) == (void*)first_pos &&
+              first_pos->x == 42.0f);
+    mu_assert("Reserving components should succeed",
+              ecs_reserve_components(&ecs, pos_type, count * 2));
+    
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_archetype_queries() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    
+    ComponentType pos_type = ecs_register_component(&ecs, sizeof(Position));
+    ComponentType vel_type = ecs_register_component(&ecs, sizeof(Position));
+    ComponentMask pos_mask = 1ULL << pos_type;
+    ComponentMask both_mask = pos_mask | (1ULL << vel_type);
+    
+    Entity moving = ecs_create_entity(&ecs);
+    Entity still = ecs_create_entity(&ecs);
+    Entity bare = ecs_create_entity(&ecs);
+    (void)bare;
+    ecs_add_component(&ecs, moving, pos_type);
+    ecs_add_component(&ecs, moving, vel_type);
+    ecs_add_component(&ecs, still, pos_type);
+    
+    mu_assert("Query should match supersets of its mask",
+              ecs_query_count(&ecs, pos_mask) == 2);
+    mu_assert("Query should only see entities with all components",
+              ecs_query_count(&ecs, both_mask) == 1);
+    mu_assert("Empty mask should match every live entity",
+              ecs_query_count(&ecs, 0) == 3);
+    
+    EcsQueryIter iter = ecs_query_iter(&ecs, both_mask);
+    Entity found = 0;
+    mu_assert("Iterator should yield the matching entity",
+              ecs_query_next(&iter, &found) && found == moving);
+    mu_assert("Iterator should stop after the last match",
+              !ecs_query_next(&iter, &found));
+    
+    // Cached query picks up entities moving between archetypes
+    ecs_add_component(&ecs, still, vel_type);
+    mu_assert("Added component should move entity into query",
+              ecs_query_count(&ecs, both_mask) == 2);
+    ecs_remove_component(&ecs, moving, vel_type);
+    ecs_destroy_entity(&ecs, still);
+    mu_assert("Removed and destroyed entities should leave the query",
+              ecs_query_count(&ecs, both_mask) == 0);
+    
+    Entity out[4];
+    size_t count = ecs_get_entities_with_components(&ecs, pos_mask, out, 4);
+    mu_assert("Entity list should come from the query",
+              count == 1 && out[0] == moving);
+    
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
 static void test_system_func(float delta_time) {
     (void)delta_time;
 }
@@ -110,6 +265,7 @@ static char* test_system_registration() {
     
     mu_assert("ECS should have 1 system", ecs.system_count == 1);
     mu_assert("System should be active", ecs.systems[0].active);
+    mu_assert("System without access sets should be exclusive", ecs.systems[0].exclusive);
     mu_assert("System should have correct required components", 
               ecs.systems[0].required_components == required);
     
@@ -117,13 +273,315 @@ static char* test_system_registration() {
     return 0;
 }
 
+static int g_sequence = 0;
+static int g_write_pos_order = 0;
+static int g_write_vel_order = 0;
+static int g_read_pos_order = 0;
+
+static int next_sequence(void) {
+    return __atomic_add_fetch(&g_sequence, 1, __ATOMIC_SEQ_CST);
+}
+static void write_pos_system(float delta_time) { (void)delta_time; g_write_pos_order = next_sequence(); }
+static void write_vel_system(float delta_time) { (void)delta_time; g_write_vel_order = next_sequence(); }
+static void read_pos_system(float delta_time) { (void)delta_time; g_read_pos_order = next_sequence(); }
+
+static char* test_parallel_system_schedule() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    ThreadPool pool = {0};
+    thread_pool_init(&pool, 2);
+    ecs_set_thread_pool(&ecs, &pool);
+    
+    ComponentMask pos = 1ULL << 0;
+    ComponentMask vel = 1ULL << 1;
+    ecs_register_system_with_access(&ecs, write_pos_system, 0, pos);
+    ecs_register_system_with_access(&ecs, write_vel_system, pos, vel);
+    ecs_register_system_with_access(&ecs, read_pos_system, pos, 0);
+    
+    mu_assert("Declared systems should not be exclusive", !ecs.systems[0].exclusive);
+    
+    for (int frame = 0; frame < 20; frame++) {
+        g_sequence = 0;
+        ecs_update_systems(&ecs, 0.016f);
+        mu_assert("All systems should run each frame", g_sequence == 3);
+        mu_assert("Reader of pos should run after its writer",
+                  g_read_pos_order > g_write_pos_order);
+        mu_assert("Pos/vel writer should run after pos writer",
+                  g_write_vel_order > g_write_pos_order);
+    }
+    
+    thread_pool_cleanup(&pool);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+typedef struct { int value; } TestValue;
+typedef struct { long sum; size_t rows; } ChunkSum;
+
+static void sum_chunk(const EcsChunk *chunk, void *user_data, void *chunk_context) {
+    ComponentType type = *(ComponentType *)user_data;
+    ChunkSum *partial = (ChunkSum *)chunk_context;
+    TestValue *values = (TestValue *)chunk->components[type];
+    for (size_t i = 0; i < chunk->count; i++) {
+        partial->sum += values[i].value;
+    }
+    partial->rows += chunk->count;
+}
+
+static char* test_group_chunks() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    ThreadPool pool = {0};
+    thread_pool_init(&pool, 3);
+    ecs_set_thread_pool(&ecs, &pool);
+    
+    ComponentType value_type = ecs_register_component(&ecs, sizeof(TestValue));
+    ComponentType tag_type = ecs_register_component(&ecs, sizeof(int));
+    
+    // Half the entities exist before the group, half join afterwards
+    Entity entities[1000];
+    for (int i = 0; i < 1000; i++) {
+        if (i == 500) {
+            mu_assert("Group should be created",
+                      ecs_group(&ecs, (1ULL << value_type) | (1ULL << tag_type)) != NULL);
+        }
+        entities[i] = ecs_create_entity(&ecs);
+        ((TestValue *)ecs_add_component(&ecs, entities[i], value_type))->value = i;
+        if (i % 4 != 0) {
+            ecs_add_component(&ecs, entities[i], tag_type);
+        }
+    }
+    
+    EcsGroup *group = ecs_group(&ecs, (1ULL << value_type) | (1ULL << tag_type));
+    mu_assert("Overlapping group should be rejected",
+              ecs_group(&ecs, 1ULL << value_type) == NULL);
+    mu_assert("Group should hold only complete entities", group->count == 750);
+    
+    // Dropping a member and destroying another keeps the prefix packed
+    ecs_remove_component(&ecs, entities[1], tag_type);
+    ecs_destroy_entity(&ecs, entities[2]);
+    mu_assert("Group should shrink on remove and destroy", group->count == 748);
+    mu_assert("Removed member keeps its data",
+              ((TestValue *)ecs_get_component(&ecs, entities[1], value_type))->value == 1);
+    
+    long expected = 0;
+    for (int i = 3; i < 1000; i++) {
+        if (i % 4 != 0) {
+            expected += i;
+        }
+    }
+    
+    size_t chunk_count = ecs_group_chunk_count(group);
+    mu_assert("Chunks should cover the group in pages", chunk_count == 3);
+    
+    ChunkSum partials[3] = {0};
+    ecs_group_parallel_for(&ecs, group, sum_chunk, &value_type, partials, sizeof(ChunkSum));
+    long total = 0;
+    size_t rows = 0;
+    for (size_t i = 0; i < chunk_count; i++) {
+        total += partials[i].sum;
+        rows += partials[i].rows;
+    }
+    mu_assert("Chunks should visit every member once", rows == 748);
+    mu_assert("Per-chunk partial sums should add up", total == expected);
+    
+    // Rows line up across owned arrays
+    EcsChunk chunk;
+    mu_assert("Last chunk should exist", ecs_group_chunk(&ecs, group, 2, &chunk));
+    TestValue *values = (TestValue *)chunk.components[value_type];
+    for (size_t i = 0; i < chunk.count; i++) {
+        mu_assert("Chunk rows should match their entity",
+                  ecs_get_component(&ecs, chunk.entities[i], value_type) == &values[i]);
+        mu_assert("Chunk rows should match in other owned arrays",
+                  ecs_get_component(&ecs, chunk.entities[i], tag_type) ==
+                  (int *)chunk.components[tag_type] + i);
+    }
+    
+    thread_pool_cleanup(&pool);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static ECS *g_spawn_ecs = NULL;
+static ComponentType g_spawn_type = 0;
+
+static void spawn_system(float delta_time) {
+    (void)delta_time;
+    Entity entity = ecs_defer_create_entity(g_spawn_ecs);
+    ((TestValue *)ecs_defer_add_component(g_spawn_ecs, entity, g_spawn_type))->value = 7;
+}
+
+static char* test_deferred_commands() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    ComponentType value_type = ecs_register_component(&ecs, sizeof(TestValue));
+    ComponentType tag_type = ecs_register_component(&ecs, sizeof(int));
+    
+    Entity doomed = ecs_create_entity(&ecs);
+    Entity tagged = ecs_create_entity(&ecs);
+    ecs_add_component(&ecs, tagged, tag_type);
+    
+    Entity pending = ecs_defer_create_entity(&ecs);
+    mu_assert("Deferred handle should be marked", ecs_entity_deferred(pending));
+    ((TestValue *)ecs_defer_add_component(&ecs, pending, value_type))->value = 42;
+    *(int *)ecs_defer_add_component(&ecs, pending, tag_type) = 3;
+    ecs_defer_destroy_entity(&ecs, doomed);
+    ecs_defer_remove_component(&ecs, tagged, tag_type);
+    
+    mu_assert("Nothing should change before the flush",
+              ecs_entity_active(&ecs, doomed) &&
+              ecs_has_component(&ecs, tagged, tag_type) &&
+              ecs_query_count(&ecs, 1ULL << value_type) == 0);
+    
+    ecs_flush_commands(&ecs);
+    
+    mu_assert("Deferred destroy should apply", !ecs_entity_active(&ecs, doomed));
+    mu_assert("Deferred remove should apply", !ecs_has_component(&ecs, tagged, tag_type));
+    
+    Entity created;
+    mu_assert("Deferred entity should exist with both components",
+              ecs_get_entities_with_components(&ecs, (1ULL << value_type) | (1ULL << tag_type),
+                                               &created, 1) == 1);
+    mu_assert("Staged values should be copied",
+              ((TestValue *)ecs_get_component(&ecs, created, value_type))->value == 42 &&
+              *(int *)ecs_get_component(&ecs, created, tag_type) == 3);
+    
+    // Systems running concurrently record into per-thread buffers
+    ThreadPool pool = {0};
+    thread_pool_init(&pool, 3);
+    ecs_set_thread_pool(&ecs, &pool);
+    g_spawn_ecs = &ecs;
+    g_spawn_type = value_type;
+    for (int i = 0; i < 4; i++) {
+        ecs_register_system_with_access(&ecs, spawn_system, 0, 0);
+    }
+    ecs_update_systems(&ecs, 0.016f);
+    mu_assert("Update should flush every system's commands",
+              ecs_query_count(&ecs, 1ULL << value_type) == 5);
+    
+    thread_pool_cleanup(&pool);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_change_ticks() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    ComponentType value_type = ecs_register_component(&ecs, sizeof(TestValue));
+    
+    Entity entities[10];
+    for (int i = 0; i < 10; i++) {
+        entities[i] = ecs_create_entity(&ecs);
+        ecs_add_component(&ecs, entities[i], value_type);
+    }
+    
+    ecs_advance_tick(&ecs);
+    uint32_t since = ecs_change_tick(&ecs);
+    Entity found[16];
+    EcsQueryIter iter = ecs_query_iter_changed(&ecs, 0, value_type, since);
+    mu_assert("Nothing should be changed after the add tick",
+              !ecs_query_next(&iter, &found[0]));
+    
+    // Reads don't count; mutable access and late adds do
+    ecs_get_component(&ecs, entities[1], value_type);
+    ((TestValue *)ecs_get_component_mut(&ecs, entities[3], value_type))->value = 1;
+    ecs_mark_changed(&ecs, entities[5], value_type);
+    Entity late = ecs_create_entity(&ecs);
+    ecs_add_component(&ecs, late, value_type);
+    
+    // Swap-removes must carry stamps with the moved component
+    ecs_destroy_entity(&ecs, entities[0]);
+    
+    size_t changed = 0;
+    iter = ecs_query_iter_changed(&ecs, 0, value_type, since);
+    while (ecs_query_next(&iter, &found[changed])) {
+        changed++;
+    }
+    mu_assert("Changed filter should see mutable writes and adds", changed == 3);
+    
+    size_t added = 0;
+    iter = ecs_query_iter_added(&ecs, 0, value_type, since);
+    while (ecs_query_next(&iter, &found[added])) {
+        added++;
+    }
+    mu_assert("Added filter should see only the late entity", added == 1 && found[0] == late);
+    
+    iter = ecs_query_iter_changed(&ecs, 0, value_type, 0);
+    size_t all = 0;
+    while (ecs_query_next(&iter, &found[0])) {
+        all++;
+    }
+    mu_assert("Since 0 should match everything", all == 10);
+    
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_chunk_stamps_and_group_version() {
+    ECS ecs = {0};  // ZII pattern
+    ecs_init(&ecs);
+    ComponentType value_type = ecs_register_component(&ecs, sizeof(TestValue));
+    ComponentType tag_type = ecs_register_component(&ecs, sizeof(int));
+    EcsGroup *group = ecs_group(&ecs, (1ULL << value_type) | (1ULL << tag_type));
+    
+    Entity entities[600];
+    for (int i = 0; i < 600; i++) {
+        entities[i] = ecs_create_entity(&ecs);
+        ecs_add_component(&ecs, entities[i], value_type);
+        ecs_add_component(&ecs, entities[i], tag_type);
+    }
+    uint32_t version = group->version;
+    
+    ecs_advance_tick(&ecs);
+    uint32_t since = ecs_change_tick(&ecs);
+    EcsChunk chunk;
+    for (size_t c = 0; c < 3; c++) {
+        ecs_group_chunk(&ecs, group, c, &chunk);
+        mu_assert("No chunk should be changed after the add tick",
+                  !ecs_chunk_changed_since(&chunk, value_type, since));
+    }
+    
+    // Reads don't count; mutable access and chunk kernel stamps do
+    ecs_get_component(&ecs, entities[10], value_type);
+    ecs_get_component_mut(&ecs, entities[300], value_type);
+    ecs_group_chunk(&ecs, group, 2, &chunk);
+    ecs_chunk_mark_changed(&chunk, value_type, 0);
+    ecs_group_chunk(&ecs, group, 0, &chunk);
+    mu_assert("A read should leave its chunk alone", !ecs_chunk_changed_since(&chunk, value_type, since));
+    ecs_group_chunk(&ecs, group, 1, &chunk);
+    mu_assert("A mutable access should stamp its chunk", ecs_chunk_changed_since(&chunk, value_type, since));
+    mu_assert("Stamps should be per component type", !ecs_chunk_changed_since(&chunk, tag_type, since));
+    ecs_group_chunk(&ecs, group, 2, &chunk);
+    mu_assert("A kernel stamp should mark its chunk", ecs_chunk_changed_since(&chunk, value_type, since));
+    mu_assert("Writes should leave the group version alone", group->version == version);
+    
+    // Leaving swaps the last member (stamped) into the first chunk
+    ecs_get_component_mut(&ecs, entities[599], tag_type);
+    ecs_destroy_entity(&ecs, entities[0]);
+    mu_assert("Leaving should bump the group version", group->version != version);
+    ecs_group_chunk(&ecs, group, 0, &chunk);
+    mu_assert("A moved stamp should mark its new chunk", ecs_chunk_changed_since(&chunk, tag_type, since));
+    
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
 static char* all_tests() {
     mu_run_test(test_ecs_init);
     mu_run_test(test_entity_creation);
     mu_run_test(test_entity_destroy);
+    mu_run_test(test_entity_recycling);
     mu_run_test(test_component_registration);
     mu_run_test(test_component_operations);
+    mu_run_test(test_component_storage_packed);
+    mu_run_test(test_storage_growth);
+    mu_run_test(test_archetype_queries);
     mu_run_test(test_system_registration);
+    mu_run_test(test_parallel_system_schedule);
+    mu_run_test(test_group_chunks);
+    mu_run_test(test_deferred_commands);
+    mu_run_test(test_change_ticks);
+    mu_run_test(test_chunk_stamps_and_group_version);
     return 0;
 }
 
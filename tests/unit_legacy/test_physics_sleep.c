@@ -175,6 +175,136 @@ static char* test_sleeping_objects_skip_integration() {
     return 0;
 }
 
+// Test that touching bodies sleep and wake as one island
+static char* test_island_sleeps_and_wakes_together() {
+    ECS ecs = {0};
+    PhysicsWorld physics_world = {0};
+    
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    physics_world_init(&physics_world, &ecs, transform_type);
+    
+    // A short stack resting on the bottom of the boundary
+    Entity stack[3];
+    for (int i = 0; i < 3; i++) {
+        stack[i] = physics_create_circle(&physics_world, (Vec3){0, -95.0f + i * 9.5f, 0}, 5.0f, 1.0f);
+    }
+    
+    float delta_time = 1.0f/60.0f;
+    int asleep = 0;
+    for (int step = 0; step < 600 && !asleep; step++) {
+        physics_world_step(&physics_world, delta_time);
+        int sleeping = 0;
+        for (int i = 0; i < 3; i++) {
+            VerletBody* verlet = (VerletBody*)ecs_get_component(&ecs, stack[i], physics_world.verlet_type);
+            sleeping += verlet->is_sleeping;
+        }
+        mu_assert("Stack should never be partly asleep", sleeping == 0 || sleeping == 3);
+        asleep = sleeping == 3;
+    }
+    mu_assert("Stack should settle and sleep", asleep);
+    
+    VerletBody* bottom = (VerletBody*)ecs_get_component(&ecs, stack[0], physics_world.verlet_type);
+    VerletBody* top = (VerletBody*)ecs_get_component(&ecs, stack[2], physics_world.verlet_type);
+    mu_assert("Stack should share one island", bottom->island != 0 && bottom->island == top->island);
+    
+    // Waking one body (as the demo's mouse drag does) wakes the whole island;
+    // changes to sleepers are stamped so the next step reads them back
+    ecs_advance_tick(&ecs);
+    bottom = (VerletBody*)ecs_get_component_mut(&ecs, stack[0], physics_world.verlet_type);
+    bottom->is_sleeping = false;
+    bottom->sleep_timer = 0;
+    physics_world_step(&physics_world, delta_time);
+    for (int i = 0; i < 3; i++) {
+        VerletBody* verlet = (VerletBody*)ecs_get_component(&ecs, stack[i], physics_world.verlet_type);
+        mu_assert("Whole island should wake", !verlet->is_sleeping && verlet->island == 0);
+    }
+    
+    physics_world_cleanup(&physics_world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+static char* test_contact_cache_keeps_resting_pairs() {
+    ECS ecs = {0};
+    PhysicsWorld physics_world = {0};
+    
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    physics_world_init(&physics_world, &ecs, transform_type);
+    
+    // Two bodies just touching, resting on the bottom of the boundary
+    Entity bottom = physics_create_circle(&physics_world, (Vec3){0, -95.0f, 0}, 5.0f, 1.0f);
+    Entity top = physics_create_circle(&physics_world, (Vec3){0, -85.01f, 0}, 5.0f, 1.0f);
+    
+    float delta_time = 1.0f/60.0f;
+    for (int step = 0; step < 10; step++) {
+        physics_world_step(&physics_world, delta_time);
+    }
+    
+    const PhysicsContactCache* cache = &physics_world.contact_cache[physics_world.contact_cache_read];
+    uint64_t key = bottom < top ? ((uint64_t)bottom << 32) | top : ((uint64_t)top << 32) | bottom;
+    const PhysicsContactEntry* found = NULL;
+    for (size_t i = 0; i < cache->capacity; i++) {
+        if (cache->entries[i].key == key) {
+            found = &cache->entries[i];
+        }
+    }
+    mu_assert("Resting pair should be the only cached contact", cache->count == 1 && found != NULL);
+    float up = bottom < top ? 1.0f : -1.0f;
+    mu_assert("Cached normal should point from the lower entity", found->normal_y * up > 0.9f);
+    
+    physics_world_cleanup(&physics_world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
+// Sleepers stay out of the step: only kicked bodies are stepped and written back
+static char* test_sleepers_stay_out_of_the_step() {
+    ECS ecs = {0};
+    PhysicsWorld physics_world = {0};
+    
+    ecs_init(&ecs);
+    ComponentType transform_type = ecs_register_component(&ecs, sizeof(Transform));
+    physics_world_init(&physics_world, &ecs, transform_type);
+    physics_world.gravity = (Vec3){0};
+    
+    // A sparse lattice: every body falls asleep on its own
+    Entity bodies[400];
+    for (int i = 0; i < 400; i++) {
+        Vec3 position = {(float)(i % 20) * 7.0f - 66.5f, (float)(i / 20) * 7.0f - 66.5f, 0};
+        bodies[i] = physics_create_circle(&physics_world, position, 2.0f, 1.0f);
+    }
+    float delta_time = 1.0f/60.0f;
+    for (int step = 0; step < 40; step++) {
+        physics_world_step(&physics_world, delta_time);
+        ecs_advance_tick(&ecs);
+    }
+    mu_assert("Lattice should fall asleep", physics_world.awake_count == 0);
+    
+    uint32_t since = ecs_change_tick(&ecs);
+    ComponentMask mask = 1ULL << transform_type;
+    for (int kick = 0; kick < 20; kick++) {
+        VerletBody* verlet = (VerletBody*)ecs_get_component_mut(&ecs, bodies[kick * 19], physics_world.verlet_type);
+        verlet->acceleration = (Vec3){kick % 2 ? 400.0f : -400.0f, 0, 0};
+        physics_world_step(&physics_world, delta_time);
+        ecs_advance_tick(&ecs);
+        mu_assert("Only kicked bodies should be awake", physics_world.awake_count == (size_t)kick + 1);
+    }
+    
+    size_t moved = 0;
+    EcsQueryIter iter = ecs_query_iter_changed(&ecs, mask, transform_type, since);
+    Entity entity;
+    while (ecs_query_next(&iter, &entity)) {
+        moved++;
+    }
+    mu_assert("Only kicked bodies should be written back as moved", moved == 20);
+    
+    physics_world_cleanup(&physics_world);
+    ecs_cleanup(&ecs);
+    return 0;
+}
+
 static char* all_tests() {
     mu_test_suite_start();
     
@@ -183,6 +313,9 @@ static char* all_tests() {
     mu_run_test(test_wake_up_from_collision);
     mu_run_test(test_velocity_threshold);
     mu_run_test(test_sleeping_objects_skip_integration);
+    mu_run_test(test_island_sleeps_and_wakes_together);
+    mu_run_test(test_contact_cache_keeps_resting_pairs);
+    mu_run_test(test_sleepers_stay_out_of_the_step);
     
     return 0;
 }